@@ -6,7 +6,9 @@
  */
 
 #include "btree.h"
-#include "filescan.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
+#include "node_search.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -14,918 +16,5313 @@
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
-#include "exceptions/end_of_file_exception.h"
 #include "exceptions/file_exists_exception.h"
 #include <typeinfo>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <exception>
 
 //#define DEBUG
 
 namespace badgerdb
 {
 
+// Arithmetic on the keys of packed leaves: how far a key is above another, which can overflow the key type but not
+// 64 unsigned bits, and the key some distance above another.
+template <class K, bool PACKABLE = KeyTraits<K>::PACKABLE>
+struct KeyDelta
+{
+    static std::uint64_t distance(const K low, const K high)
+    {
+        return (std::uint64_t)high - (std::uint64_t)low;
+    }
+
+    static K add(const K base, const std::uint16_t delta)
+    {
+        return base + delta;
+    }
+
+    static void decode(const std::uint16_t *deltas, const int count, const K base, K *out)
+    {
+        NodeSearch::decode16(deltas, count, base, out);
+    }
+};
+
+// Keys that do not pack are never close enough to each other, and no leaf of theirs is packed.
+template <class K>
+struct KeyDelta<K, false>
+{
+    static std::uint64_t distance(const K low, const K high)
+    {
+        return UINT64_MAX;
+    }
+
+    static K add(const K base, const std::uint16_t delta)
+    {
+        return base;
+    }
+
+    static void decode(const std::uint16_t *deltas, const int count, const K base, K *out)
+    {
+    }
+};
+
+// Copies of keys to and from the normalized form the nodes store them in.
+template <class K, class S = typename KeyTraits<K>::Stored>
+struct StoredKeys
+{
+    static void load(const S *stored, const int count, K *out)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = KeyTraits<K>::denormalize(stored[i]);
+        }
+    }
+
+    static void store(const K *keys, const int count, S *out)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = KeyTraits<K>::normalize(keys[i]);
+        }
+    }
+};
+
+// Keys stored as they are are copied whole.
+template <class K>
+struct StoredKeys<K, K>
+{
+    static void load(const K *stored, const int count, K *out)
+    {
+        memcpy(out, stored, count * sizeof(K));
+    }
+
+    static void store(const K *keys, const int count, K *out)
+    {
+        memcpy(out, keys, count * sizeof(K));
+    }
+};
+
+// The entries of a leaf, in whichever of its two layouts it is. The layout is read once, when the view is made, so
+// that an optimistic reader racing a writer that repacks the leaf stays within the page until its reads are validated.
+template <class K>
+class LeafView
+{
+public:
+    explicit LeafView(void *page)
+        : leaf((LeafNode<K> *)page), packedLeaf((PackedLeafNode<K> *)page),
+          packed(KeyTraits<K>::PACKABLE && ((LeafNode<K> *)page)->packed != 0), base(((LeafNode<K> *)page)->keyBase)
+    {
+    }
+
+    // Number of slots.
+    int capacity() const
+    {
+        return packed ? PackedLeafNode<K>::CAPACITY : LeafNode<K>::CAPACITY;
+    }
+
+    // Position of the first key >= key.
+    int lowerBound(const K key) const
+    {
+        if (!packed)
+        {
+            return NodeSearch::lowerBound(leaf->keyArray, LeafNode<K>::CAPACITY, KeyTraits<K>::normalize(key));
+        }
+        if (key <= base)
+        {
+            return 0;
+        }
+        std::uint64_t delta = KeyDelta<K>::distance(base, key);
+        return NodeSearch::lowerBound16(packedLeaf->deltaArray, PackedLeafNode<K>::CAPACITY,
+                                        (std::uint16_t)std::min(delta, (std::uint64_t)0xFFFF));
+    }
+
+    // Position of the first key > key.
+    int upperBound(const K key) const
+    {
+        if (!packed)
+        {
+            return NodeSearch::upperBound(leaf->keyArray, LeafNode<K>::CAPACITY, KeyTraits<K>::normalize(key));
+        }
+        if (key < base)
+        {
+            return 0;
+        }
+        std::uint64_t delta = KeyDelta<K>::distance(base, key);
+        if (delta > (std::uint64_t)PACKED_MAX_DELTA)
+        {
+            return size();
+        }
+        return NodeSearch::upperBound16(packedLeaf->deltaArray, PackedLeafNode<K>::CAPACITY, (std::uint16_t)delta);
+    }
+
+    // Number of slots used.
+    int size() const
+    {
+        return packed ? NodeSearch::lowerBound16(packedLeaf->deltaArray, PackedLeafNode<K>::CAPACITY, 0xFFFF)
+                      : NodeSearch::lowerBound(leaf->keyArray, LeafNode<K>::CAPACITY,
+                                               KeyTraits<K>::normalize(KeyTraits<K>::max()));
+    }
+
+    K key(const int i) const
+    {
+        return packed ? KeyDelta<K>::add(base, packedLeaf->deltaArray[i])
+                      : KeyTraits<K>::denormalize(leaf->keyArray[i]);
+    }
+
+    // Copy count keys from position begin on.
+    void keys(const int begin, const int count, K *out) const
+    {
+        if (packed)
+        {
+            KeyDelta<K>::decode(&packedLeaf->deltaArray[begin], count, base, out);
+        }
+        else
+        {
+            StoredKeys<K>::load(&leaf->keyArray[begin], count, out);
+        }
+    }
+
+    RecordId *rids() const
+    {
+        return packed ? packedLeaf->ridArray : leaf->ridArray;
+    }
+
+    // Whether the key can be stored in the leaf's layout.
+    bool holds(const K key) const
+    {
+        return !packed || (key >= base && KeyDelta<K>::distance(base, key) <= (std::uint64_t)PACKED_MAX_DELTA);
+    }
+
+    void set(const int i, const K key, const RecordId rid)
+    {
+        if (packed)
+        {
+            packedLeaf->deltaArray[i] = (std::uint16_t)KeyDelta<K>::distance(base, key);
+            packedLeaf->ridArray[i] = rid;
+        }
+        else
+        {
+            leaf->keyArray[i] = KeyTraits<K>::normalize(key);
+            leaf->ridArray[i] = rid;
+        }
+    }
+
+    // Remove the entry at a position, moving those after it down.
+    void remove(const int pos)
+    {
+        if (packed)
+        {
+            memmove(&packedLeaf->deltaArray[pos], &packedLeaf->deltaArray[pos + 1],
+                    (PackedLeafNode<K>::CAPACITY - 1 - pos) * sizeof(std::uint16_t));
+            memmove(&packedLeaf->ridArray[pos], &packedLeaf->ridArray[pos + 1],
+                    (PackedLeafNode<K>::CAPACITY - 1 - pos) * sizeof(RecordId));
+            packedLeaf->deltaArray[PackedLeafNode<K>::CAPACITY - 1] = 0xFFFF;
+        }
+        else
+        {
+            memmove(&leaf->keyArray[pos], &leaf->keyArray[pos + 1],
+                    (LeafNode<K>::CAPACITY - 1 - pos) * sizeof(leaf->keyArray[0]));
+            memmove(&leaf->ridArray[pos], &leaf->ridArray[pos + 1], (LeafNode<K>::CAPACITY - 1 - pos) * sizeof(RecordId));
+            leaf->keyArray[LeafNode<K>::CAPACITY - 1] = KeyTraits<K>::normalize(KeyTraits<K>::max());
+        }
+    }
+
+private:
+    LeafNode<K> *leaf;
+    PackedLeafNode<K> *packedLeaf;
+    const bool packed;
+    const K base;
+};
+
+// Write count entries into a leaf, padding the remaining key slots. The leaf is packed if pack is set and the keys
+// fit, and plain otherwise. postingEntries is the number of entries their posting lists hold beyond one each.
+template <class K>
+static void fillLeaf(LeafNode<K> *leaf, const K *keys, const RecordId *rids, const int count,
+                     const int postingEntries, const bool pack)
+{
+    if (pack && count > 0 && count <= PackedLeafNode<K>::CAPACITY && KeyDelta<K>::distance(keys[0], keys[count - 1]) <= (std::uint64_t)PACKED_MAX_DELTA)
+    {
+        PackedLeafNode<K> *packedLeaf = (PackedLeafNode<K> *)leaf;
+        packedLeaf->packed = 1;
+        packedLeaf->keyBase = keys[0];
+        for (int i = 0; i < count; i++)
+        {
+            packedLeaf->deltaArray[i] = (std::uint16_t)KeyDelta<K>::distance(keys[0], keys[i]);
+        }
+        for (int i = count; i < PackedLeafNode<K>::CAPACITY; i++)
+        {
+            packedLeaf->deltaArray[i] = 0xFFFF;
+        }
+        memcpy(packedLeaf->ridArray, rids, count * sizeof(RecordId));
+    }
+    else
+    {
+        leaf->packed = 0;
+        leaf->keyBase = K();
+        StoredKeys<K>::store(keys, count, leaf->keyArray);
+        memcpy(leaf->ridArray, rids, count * sizeof(RecordId));
+        for (int i = count; i < LeafNode<K>::CAPACITY; i++)
+        {
+            leaf->keyArray[i] = KeyTraits<K>::normalize(KeyTraits<K>::max());
+        }
+    }
+    leaf->postingEntries = postingEntries;
+}
+
+// Number of the entries from begin on, out of total, that one leaf can hold: PackedLeafNode<K>::CAPACITY if they are packed and
+// their keys allow it, as many as are within PACKED_MAX_DELTA of the first if that is more than a plain leaf holds,
+// and LeafNode<K>::CAPACITY otherwise.
+template <class K>
+static int leafCapacity(const K *keys, const int begin, const int total, const bool pack)
+{
+    if (!pack)
+    {
+        return LeafNode<K>::CAPACITY;
+    }
+    int limit = std::min(total, begin + PackedLeafNode<K>::CAPACITY);
+    K top = (KeyDelta<K>::distance(keys[begin], KeyTraits<K>::max()) < (std::uint64_t)PACKED_MAX_DELTA)
+                ? KeyTraits<K>::max()
+                : KeyDelta<K>::add(keys[begin], PACKED_MAX_DELTA);
+    int packedEnd = (int)(std::upper_bound(keys + begin, keys + limit, top) - keys);
+    if (packedEnd == limit)
+    {
+        return PackedLeafNode<K>::CAPACITY;
+    }
+    return std::max(LeafNode<K>::CAPACITY, packedEnd - begin);
+}
+
+// Whether the entries from 0 up to total can be split into two leaves at a position: between two keys,
+// with each part fitting its leaf.
+template <class K>
+static bool splitFits(const K *keys, const int total, const int at, const bool pack)
+{
+    return at >= 1 && at < total && keys[at - 1] != keys[at] && at <= leafCapacity(keys, 0, total, pack) &&
+           total - at <= leafCapacity(keys, at, total, pack);
+}
+
+// Position nearest to the middle at which the entries from 0 up to total split into two leaves, as splitFits has it.
+// -1 if there is none.
+template <class K>
+static int evenSplit(const K *keys, const int total, const bool pack)
+{
+    for (int d = 0; total / 2 - d >= 1 || total / 2 + d < total; d++)
+    {
+        if (splitFits(keys, total, total / 2 - d, pack))
+        {
+            return total / 2 - d;
+        }
+        if (splitFits(keys, total, total / 2 + d, pack))
+        {
+            return total / 2 + d;
+        }
+    }
+    return -1;
+}
+
+// Position nearest to the target, from lo up to hi, at which a leaf can end: one where the key changes,
+// since equal keys never span two leaves. -1 if there is none. keys[lo - 1] and keys[hi] must exist.
+template <class K>
+static int keyBoundary(const K *keys, const int lo, const int target, const int hi)
+{
+    for (int d = 0; target - d >= lo || target + d <= hi; d++)
+    {
+        if (target - d >= lo && keys[target - d - 1] != keys[target - d])
+        {
+            return target - d;
+        }
+        if (target + d <= hi && keys[target + d - 1] != keys[target + d])
+        {
+            return target + d;
+        }
+    }
+    return -1;
+}
+
+// Whether the rid of a leaf entry stands for a posting list rather than a record.
+static bool isPosting(const RecordId &rid)
+{
+    return rid.slot_number == POSTING_SLOT;
+}
+
+// Whether a record id comes before another in the order of the index: on page number first, slot number next.
+static bool ridLess(const RecordId &r1, const RecordId &r2)
+{
+    if (r1.page_number != r2.page_number)
+    {
+        return r1.page_number < r2.page_number;
+    }
+    return r1.slot_number < r2.slot_number;
+}
+
+// A record id as a single number, in the same order.
+static std::uint64_t ridValue(const RecordId &rid)
+{
+    return ((std::uint64_t)rid.page_number << 16) | rid.slot_number;
+}
+
+// Number of the record ids, from the first, that fit on a posting page. The first one is stored whole and every
+// later one as its difference from the one before, seven bits to a byte, with the top bit set on all bytes but the last.
+static int postingFit(const RecordId *rids, const int count)
+{
+    int bytes = 0;
+    std::uint64_t prev = 0;
+    for (int i = 0; i < count; i++)
+    {
+        std::uint64_t delta = ridValue(rids[i]) - prev;
+        prev = ridValue(rids[i]);
+        int length = 1;
+        while (delta >= 0x80)
+        {
+            delta >>= 7;
+            length++;
+        }
+        if (bytes + length > POSTINGDATASIZE)
+        {
+            return i;
+        }
+        bytes += length;
+    }
+    return count;
+}
+
+// Write count record ids, in order, to a posting page. They must fit. The links and the fields kept
+// on the first page are left alone.
+static void encodePosting(PostingNode *node, const RecordId *rids, const int count)
+{
+    int size = 0;
+    std::uint64_t prev = 0;
+    for (int i = 0; i < count; i++)
+    {
+        std::uint64_t delta = ridValue(rids[i]) - prev;
+        prev = ridValue(rids[i]);
+        while (delta >= 0x80)
+        {
+            node->data[size++] = (unsigned char)(delta | 0x80);
+            delta >>= 7;
+        }
+        node->data[size++] = (unsigned char)delta;
+    }
+    node->count = count;
+    node->size = size;
+    if (count > 0)
+    {
+        node->firstRid = rids[0];
+        node->lastRid = rids[count - 1];
+    }
+}
+
+// Append the record ids of a posting page. The page may be read while a writer changes it,
+// so nothing is read past the data whatever its size says.
+static void decodePosting(const PostingNode *node, std::vector<RecordId> &rids)
+{
+    int size = std::min(std::max(node->size, 0), POSTINGDATASIZE);
+    std::uint64_t value = 0;
+    int pos = 0;
+    while (pos < size)
+    {
+        std::uint64_t delta = 0;
+        for (int shift = 0; pos < size && shift < 64; shift += 7)
+        {
+            unsigned char byte = node->data[pos++];
+            delta |= (std::uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        value += delta;
+        RecordId rid;
+        rid.page_number = (PageId)(value >> 16);
+        rid.slot_number = (SlotId)(value & 0xFFFF);
+        rids.push_back(rid);
+    }
+}
+
+// The keys of a non-leaf node, stored whole and normalized in slots padded with KeyTraits<K>::max().
+template <class K>
+class NonLeafView
+{
+public:
+    explicit NonLeafView(const void *page)
+        : node((NonLeafNode<K> *)page)
+    {
+    }
+
+    // Number of keys.
+    int size() const
+    {
+        return NodeSearch::lowerBound(node->keyArray, NonLeafNode<K>::CAPACITY,
+                                      KeyTraits<K>::normalize(KeyTraits<K>::max()));
+    }
+
+    // Position of the first key >= key.
+    int lowerBound(const K key) const
+    {
+        return NodeSearch::lowerBound(node->keyArray, NonLeafNode<K>::CAPACITY, KeyTraits<K>::normalize(key));
+    }
+
+    // Position of the first key > key.
+    int upperBound(const K key) const
+    {
+        return NodeSearch::upperBound(node->keyArray, NonLeafNode<K>::CAPACITY, KeyTraits<K>::normalize(key));
+    }
+
+    K key(const int i) const
+    {
+        return KeyTraits<K>::denormalize(node->keyArray[i]);
+    }
+
+    // Copy count keys from position begin on.
+    void keys(const int begin, const int count, K *out) const
+    {
+        StoredKeys<K>::load(&node->keyArray[begin], count, out);
+    }
+
+    // Whether the key can replace the one at a position.
+    bool holds(const int i, const K key) const
+    {
+        return true;
+    }
+
+    void set(const int i, const K key)
+    {
+        node->keyArray[i] = KeyTraits<K>::normalize(key);
+    }
+
+    // Write count keys, padding the remaining slots. They must fit.
+    void fill(const K *keys, const int count)
+    {
+        StoredKeys<K>::store(keys, count, node->keyArray);
+        for (int i = count; i < NonLeafNode<K>::CAPACITY; i++)
+        {
+            node->keyArray[i] = KeyTraits<K>::normalize(KeyTraits<K>::max());
+        }
+    }
+
+    // Remove the key at a position, moving those after it down.
+    void remove(const int i)
+    {
+        memmove(&node->keyArray[i], &node->keyArray[i + 1],
+                (NonLeafNode<K>::CAPACITY - 1 - i) * sizeof(node->keyArray[0]));
+        node->keyArray[NonLeafNode<K>::CAPACITY - 1] = KeyTraits<K>::normalize(KeyTraits<K>::max());
+    }
+
+    // Whether count keys fit one node.
+    static bool fits(const K *keys, const int count)
+    {
+        return count <= NonLeafNode<K>::CAPACITY;
+    }
+
+    // Number of the keys from begin on, out of total, that one node can hold: NonLeafNode<K>::CAPACITY if all of them fit.
+    static int capacity(const K *keys, const int begin, const int total)
+    {
+        return NonLeafNode<K>::CAPACITY;
+    }
+
+private:
+    NonLeafNode<K> *node;
+};
+
+const int NonLeafNode<StringKey>::SUFFIXSIZE;
+const int NonLeafNode<StringKey>::CAPACITY;
+const int NonLeafNode<StringKey>::KEYSPACE;
+const int NonLeafNode<StringKey>::MIN;
+
+// The keys of a non-leaf node with STRING keys: a prefix they share and as many bytes of each after it. The count and
+// the lengths are read once, when the view is made, and kept within the node, so that an optimistic reader racing a
+// writer that refills the node stays within the page until its reads are validated.
+template <>
+class NonLeafView<StringKey>
+{
+public:
+    explicit NonLeafView(const void *page)
+        : node((NonLeafNode<StringKey> *)page)
+    {
+        prefixLength = std::min(std::max(node->prefixLength, 0), STRINGSIZE);
+        suffixLength = std::min(std::max(node->suffixLength, 0), STRINGSIZE - prefixLength);
+        int most = (suffixLength == 0) ? NonLeafNode<StringKey>::CAPACITY
+                                       : std::min(NonLeafNode<StringKey>::CAPACITY, NonLeafNode<StringKey>::KEYSPACE / suffixLength);
+        count = std::min(std::max(node->keyCount, 0), most);
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    int lowerBound(const StringKey &key) const
+    {
+        return search(key, false);
+    }
+
+    int upperBound(const StringKey &key) const
+    {
+        return search(key, true);
+    }
+
+    StringKey key(const int i) const
+    {
+        StringKey key;
+        memcpy(key.bytes, node->prefix, prefixLength);
+        memcpy(key.bytes + prefixLength, node->suffixes + i * suffixLength, suffixLength);
+        memset(key.bytes + prefixLength + suffixLength, 0, STRINGSIZE - prefixLength - suffixLength);
+        return key;
+    }
+
+    void keys(const int begin, const int count, StringKey *out) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = key(begin + i);
+        }
+    }
+
+    bool holds(const int i, const StringKey &key) const
+    {
+        std::vector<StringKey> all(count);
+        keys(0, count, all.data());
+        all[i] = key;
+        return fits(all.data(), count);
+    }
+
+    // Refills the node: the key may change the prefix and the suffix length. It must fit, as holds has it.
+    void set(const int i, const StringKey &key)
+    {
+        std::vector<StringKey> all(count);
+        keys(0, count, all.data());
+        all[i] = key;
+        fill(all.data(), count);
+    }
+
+    void fill(const StringKey *keys, const int count)
+    {
+        prefixLength = (count > 0) ? commonLength(keys[0], keys[count - 1]) : 0;
+        suffixLength = 0;
+        for (int i = 0; i < count; i++)
+        {
+            suffixLength = std::max(suffixLength, significantLength(keys[i]) - prefixLength);
+        }
+        this->count = count;
+        node->keyCount = count;
+        node->prefixLength = prefixLength;
+        node->suffixLength = suffixLength;
+        memset(node->prefix, 0, STRINGSIZE);
+        if (count > 0)
+        {
+            memcpy(node->prefix, keys[0].bytes, prefixLength);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            memcpy(node->suffixes + i * suffixLength, keys[i].bytes + prefixLength, suffixLength);
+        }
+        memset(node->suffixes + count * suffixLength, 0, NonLeafNode<StringKey>::KEYSPACE - count * suffixLength);
+    }
+
+    void remove(const int i)
+    {
+        std::vector<StringKey> all(count);
+        keys(0, count, all.data());
+        all.erase(all.begin() + i);
+        fill(all.data(), count - 1);
+    }
+
+    // The keys are sorted, so they share the prefix of the first and the last.
+    static bool fits(const StringKey *keys, const int count)
+    {
+        if (count > NonLeafNode<StringKey>::CAPACITY)
+        {
+            return false;
+        }
+        int significant = 0;
+        for (int i = 0; i < count; i++)
+        {
+            significant = std::max(significant, significantLength(keys[i]));
+        }
+        int prefix = (count > 0) ? commonLength(keys[0], keys[count - 1]) : 0;
+        return count * std::max(significant - prefix, 0) <= NonLeafNode<StringKey>::KEYSPACE;
+    }
+
+    static int capacity(const StringKey *keys, const int begin, const int total)
+    {
+        int significant = 0;
+        for (int n = 1; begin + n <= total && n <= NonLeafNode<StringKey>::CAPACITY; n++)
+        {
+            significant = std::max(significant, significantLength(keys[begin + n - 1]));
+            int prefix = commonLength(keys[begin], keys[begin + n - 1]);
+            if (n * std::max(significant - prefix, 0) > NonLeafNode<StringKey>::KEYSPACE)
+            {
+                return n - 1;
+            }
+        }
+        return NonLeafNode<StringKey>::CAPACITY;
+    }
+
+private:
+    // Position of the first key above the given one, or at or above it unless past is set. A key that goes on
+    // after the bytes stored for the node's keys is above every one of them it equals up to there.
+    int search(const StringKey &key, const bool past) const
+    {
+        int c = memcmp(key.bytes, node->prefix, prefixLength);
+        if (c != 0)
+        {
+            return (c < 0) ? 0 : count;
+        }
+        const unsigned char *probe = key.bytes + prefixLength;
+        bool longer = false;
+        for (int i = prefixLength + suffixLength; i < STRINGSIZE; i++)
+        {
+            longer = longer || key.bytes[i] != 0;
+        }
+        bool belowOnTie = longer || past;
+        int lo = 0;
+        int hi = count;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            int d = memcmp(node->suffixes + mid * suffixLength, probe, suffixLength);
+            if (d < 0 || (d == 0 && belowOnTie))
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // Number of leading bytes two keys share.
+    static int commonLength(const StringKey &k1, const StringKey &k2)
+    {
+        int i = 0;
+        while (i < STRINGSIZE && k1.bytes[i] == k2.bytes[i])
+        {
+            i++;
+        }
+        return i;
+    }
+
+    // Number of bytes of a key up to its last one that is not zero.
+    static int significantLength(const StringKey &key)
+    {
+        int i = STRINGSIZE;
+        while (i > 0 && key.bytes[i - 1] == 0)
+        {
+            i--;
+        }
+        return i;
+    }
+
+    NonLeafNode<StringKey> *node;
+    int prefixLength;
+    int suffixLength;
+    int count;
+};
+
+// Write childCount children, their counts and the childCount - 1 keys separating them into a non-leaf node,
+// padding the remaining slots with the padding key, Page::INVALID_NUMBER and 0. The level, high key and right link
+// are left alone.
+// The keys must fit, as NonLeafView<K>::fits has it.
+template <class K>
+static void fillNonLeaf(NonLeafNode<K> *node, const K *keys, const PageId *children, const int *counts,
+                        const int childCount)
+{
+    memcpy(node->pageNoArray, children, childCount * sizeof(PageId));
+    memcpy(node->countArray, counts, childCount * sizeof(int));
+    NonLeafView<K>(node).fill(keys, childCount - 1);
+    for (int i = childCount; i < NonLeafNode<K>::CAPACITY + 1; i++)
+    {
+        node->pageNoArray[i] = Page::INVALID_NUMBER;
+        node->countArray[i] = 0;
+    }
+}
+
+// Remove the child at the index, its count and the key on its left from a non-leaf node.
+template <class K>
+static void removeChild(NonLeafNode<K> *node, const int index)
+{
+    NonLeafView<K>(node).remove(index - 1);
+    memmove(&node->pageNoArray[index], &node->pageNoArray[index + 1], (NonLeafNode<K>::CAPACITY - index) * sizeof(PageId));
+    memmove(&node->countArray[index], &node->countArray[index + 1], (NonLeafNode<K>::CAPACITY - index) * sizeof(int));
+    node->pageNoArray[NonLeafNode<K>::CAPACITY] = Page::INVALID_NUMBER;
+    node->countArray[NonLeafNode<K>::CAPACITY] = 0;
+}
+
+// Ends of the parts that total + 1 children, separated by total keys, are spread over when they overflow a non-leaf
+// node: as few parts as can hold them, each but the last followed by the key that moves up to the parent. They are
+// spread evenly if every part then fits, and fill the parts in turn otherwise or if append is set, as the last leaf
+// does, leaving the last part two children at least, as an even split would.
+template <class K>
+static std::vector<size_t> nonLeafParts(const K *keys, const size_t total, const bool append)
+{
+    std::vector<size_t> ends;
+    size_t begin = 0;
+    int capacity;
+    while (total - begin > (size_t)(capacity = NonLeafView<K>::capacity(keys, (int)begin, (int)total)))
+    {
+        begin = std::min(begin + capacity + 1, total - 1);
+        ends.push_back(begin);
+    }
+    ends.push_back(total + 1);
+    if (append)
+    {
+        return ends;
+    }
+
+    size_t nodes = ends.size();
+    std::vector<size_t> even(nodes);
+    begin = 0;
+    for (size_t n = 0; n < nodes; n++)
+    {
+        even[n] = (total + 1) * (n + 1) / nodes;
+        if (!NonLeafView<K>::fits(keys + begin, (int)(even[n] - begin - 1)))
+        {
+            return ends;
+        }
+        begin = even[n];
+    }
+    return even;
+}
+
+// Position of a child among the children of a non-leaf node, -1 if it is not one of them.
+template <class K>
+static int childIndex(const NonLeafNode<K> *node, const PageId pageNo)
+{
+    int children = NonLeafView<K>(node).size() + 1;
+    for (int i = 0; i < children; i++)
+    {
+        if (node->pageNoArray[i] == pageNo)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Number of entries under a node: those on a leaf, posting lists included, or the sum of the counts
+// of a non-leaf node's children.
+template <class K>
+static int subtreeCount(Page *page, const bool leaf)
+{
+    if (leaf)
+    {
+        return LeafView<K>(page).size() + ((LeafNode<K> *)page)->postingEntries;
+    }
+    NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+    int children = NonLeafView<K>(node).size() + 1;
+    int count = 0;
+    for (int i = 0; i < children; i++)
+    {
+        count += node->countArray[i];
+    }
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::BTree -- Constructor
+// -----------------------------------------------------------------------------
+
+template <class K>
+BTree<K>::BTree(const std::string &relationName,
+                std::string &outIndexName,
+                BufMgr *bufMgrIn,
+                const std::vector<KeyAttribute> &attributes,
+                const double fillFactor,
+                const bool compressLeaves,
+                const bool redistributeLeaves,
+                const int buildThreads)
+{
+    const Datatype attrType = KeyTraits<K>::TYPE;
+    const int attrByteOffset = attributes[0].offset;
+
+    //set values of the private variables
+    this->bufMgr = bufMgrIn;
+    this->attributeType = attrType;
+    this->attrByteOffset = attrByteOffset;
+    this->attributes = attributes;
+    this->relationName = relationName;
+    this->relationFile = NULL;
+    this->structureEpoch = 0;
+    this->appendLeafNum = Page::INVALID_NUMBER;
+    this->appendEpoch = 0;
+    for (int i = 0; i < NODE_CACHE_CHUNKS; i++)
+    {
+        nodeCache[i] = NULL;
+    }
+    this->cachedNodes = 0;
+    this->readAheadLimit = std::min(MAX_READ_AHEAD, (int)(bufMgrIn->getNumBufs() * READ_AHEAD_POOL_PERCENT / 100));
+
+    std ::ostringstream idxStr;
+    idxStr << relationName;
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        idxStr << '.' << attributes[i].offset;
+    }
+    std ::string indexName = idxStr.str(); // indexName is the name of the index file
+
+    try
+    {
+        // try to open an existing file
+        file = new BlobFile(indexName, false);
+        headerPageNum = file->getFirstPageNo();
+        Page *metaPage;
+        this->readNode(headerPageNum, metaPage);
+        IndexMetaInfo *inf = (IndexMetaInfo *)metaPage;
+
+        bool sameAttributes = attrType != COMPOSITE || inf->attrCount == (int)attributes.size();
+        for (int i = 0; sameAttributes && attrType == COMPOSITE && i < inf->attrCount; i++)
+        {
+            sameAttributes = inf->attributes[i].offset == attributes[i].offset &&
+                             inf->attributes[i].type == attributes[i].type;
+        }
+        if (strcmp(inf->relationName, relationName.c_str()) != 0 ||
+            (inf->attrByteOffset != attrByteOffset) ||
+            (inf->attrType != attrType) || !sameAttributes)
+        {
+            this->unpinNode(headerPageNum, false);
+            // the destructor does not run for a tree that failed to open, so close the file here
+            bufMgr->flushFile(file);
+            delete file;
+            file = nullptr;
+            throw BadIndexInfoException(indexName);
+        }
+
+        rootPageNum = inf->rootPageNo;
+        freePageNum = inf->freePageNo;
+        this->compressLeaves = KeyTraits<K>::PACKABLE && inf->compressLeaves;
+        this->redistributeLeaves = inf->redistributeLeaves;
+        this->unpinNode(headerPageNum, false);
+    }
+    catch (FileNotFoundException fileNotFoundException)
+    {
+        // extract the (key, rid) pair of every tuple in the base relation, in the order of the index. A relation
+        // with an unindexable key is refused before there is an index file.
+        std::vector<RIDKeyPair<K> > entries;
+        this->extractEntries(relationName, buildThreads, entries);
+
+        file = new BlobFile(indexName, true);
+
+        //create a new meta page
+        Page *metaPage;
+        bufMgr->allocPage(file, headerPageNum, metaPage);
+
+        IndexMetaInfo *inf = (IndexMetaInfo *)metaPage;
+
+        //set up other attributes
+        strncpy(inf->relationName, relationName.c_str(), 20);
+        inf->attrByteOffset = attrByteOffset;
+        inf->attrType = attrType;
+        inf->attrCount = (int)attributes.size();
+        std::copy(attributes.begin(), attributes.end(), inf->attributes);
+        inf->freePageNo = Page::INVALID_NUMBER;
+        inf->compressLeaves = KeyTraits<K>::PACKABLE && compressLeaves;
+        inf->redistributeLeaves = redistributeLeaves;
+        freePageNum = Page::INVALID_NUMBER;
+        this->compressLeaves = inf->compressLeaves;
+        this->redistributeLeaves = redistributeLeaves;
+        this->unpinNode(headerPageNum, true);
+
+        // write the leaves and the non-leaf levels, then record the root on the meta page
+        this->bulkLoad(entries, fillFactor);
+        bufMgr->flushFile(file);
+    }
+
+    this->cacheNonLeafLevels();
+    outIndexName = indexName;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::extractEntries
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::extractEntries(const std::string &relationName, const int buildThreads,
+                                    std::vector<RIDKeyPair<K> > &entries)
+{
+    PageFile relation(relationName, false);
+
+    // the pages of the relation, in the order of a FileScan, read off their headers
+    std::vector<PageId> pages;
+    for (FileIterator it = relation.begin(); it != relation.end(); ++it)
+    {
+        pages.push_back(it.page_number());
+    }
+
+    int threads = (buildThreads > 0) ? buildThreads : (int)std::thread::hardware_concurrency();
+    threads = std::max(1, std::min(threads, (int)(pages.size() / BUILD_MIN_PAGES)));
+
+    // run job(0) .. job(count - 1), each on a thread of its own but the first, which runs on this one
+    auto parallel = [](const int count, const std::function<void(int)> &job) {
+        std::vector<std::thread> workers;
+        for (int t = 1; t < count; t++)
+        {
+            workers.push_back(std::thread(job, t));
+        }
+        job(0);
+        for (size_t t = 0; t < workers.size(); t++)
+        {
+            workers[t].join();
+        }
+    };
+
+    // every thread sorts the pairs of its share of the pages into a run. The buffer manager serializes the reads.
+    std::vector<std::vector<RIDKeyPair<K> > > runs(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    parallel(threads, [&](const int t) {
+        try
+        {
+            size_t end = pages.size() * (t + 1) / threads;
+            for (size_t p = pages.size() * t / threads; p < end; p++)
+            {
+                Page *page;
+                bufMgr->readPage(&relation, pages[p], page);
+                bool indexable = true;
+                for (PageIterator it = page->begin(); it != page->end(); ++it)
+                {
+                    std::string recordStr = *it;
+                    RIDKeyPair<K> entry;
+                    entry.set(it.getCurrentRecord(), this->recordKey(recordStr.c_str(), recordStr.size()));
+                    indexable = indexable && !KeyTraits<K>::unindexable(entry.key);
+                    runs[t].push_back(entry);
+                }
+                bufMgr->unPinPage(&relation, pages[p], false);
+
+                // checked before the sort, which NaN keys would leave in no particular order
+                if (!indexable)
+                {
+                    throw BadIndexInfoException("the key that pads the nodes, or NaN, cannot be indexed");
+                }
+            }
+            std::sort(runs[t].begin(), runs[t].end());
+        }
+        catch (...)
+        {
+            errors[t] = std::current_exception();
+        }
+    });
+    bufMgr->flushFile(&relation);
+    for (int t = 0; t < threads; t++)
+    {
+        if (errors[t])
+        {
+            std::rethrow_exception(errors[t]);
+        }
+    }
+
+    // the runs end to end, and where each one starts
+    std::vector<size_t> starts(1, 0);
+    for (int t = 0; t < threads; t++)
+    {
+        starts.push_back(starts.back() + runs[t].size());
+    }
+    entries.clear();
+    entries.reserve(starts.back());
+    for (int t = 0; t < threads; t++)
+    {
+        entries.insert(entries.end(), runs[t].begin(), runs[t].end());
+        std::vector<RIDKeyPair<K> >().swap(runs[t]);
+    }
+
+    // merge neighbouring runs into the other buffer until one run is left, a pair of runs per thread
+    std::vector<RIDKeyPair<K> > merged(threads > 1 ? entries.size() : 0);
+    while (starts.size() > 2)
+    {
+        int pairs = (int)starts.size() / 2;
+        parallel(pairs, [&](const int i) {
+            size_t first = starts[2 * i];
+            size_t middle = starts[std::min(2 * i + 1, (int)starts.size() - 1)];
+            size_t last = starts[std::min(2 * i + 2, (int)starts.size() - 1)];
+            std::merge(entries.begin() + first, entries.begin() + middle, entries.begin() + middle,
+                       entries.begin() + last, merged.begin() + first);
+        });
+        std::vector<size_t> mergedStarts;
+        for (size_t i = 0; i < starts.size(); i += 2)
+        {
+            mergedStarts.push_back(starts[i]);
+        }
+        if (mergedStarts.back() != starts.back())
+        {
+            mergedStarts.push_back(starts.back());
+        }
+        starts.swap(mergedStarts);
+        entries.swap(merged);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::bulkLoad
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::bulkLoad(const std::vector<RIDKeyPair<K> > &entries, const double fillFactor)
+{
+    double fill = std::min(fillFactor, 1.0);
+
+    // the slots of the leaves, with the keys reaching LeafNode<K>::POSTING_MIN entries moved to posting lists
+    std::vector<K> keys(entries.size());
+    std::vector<RecordId> rids(entries.size());
+    std::vector<int> sizes(entries.size(), 1);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        keys[i] = entries[i].key;
+        rids[i] = entries[i].rid;
+    }
+    this->foldPostings(keys, rids, sizes);
+    int total = (int)keys.size();
+
+    // smallest key, page number and number of entries of every leaf, in order
+    std::vector<PageKeyPair<K> > children;
+    std::vector<int> childCounts;
+
+    Page *prevLeafPage = NULL;
+    PageId prevLeafPageId = 0;
+    int next = 0;
+
+    // an empty relation still gets one (empty) leaf
+    do
+    {
+        Page *leafPage;
+        PageId leafPageId;
+        bufMgr->allocPage(file, leafPageId, leafPage);
+        LeafNode<K> *leaf = (LeafNode<K> *)leafPage;
+
+        // the leaf ends between two keys, as near to its fill, at least one entry, as they allow. Runs of equal
+        // keys are shorter than half a leaf, so there is such a place unless the rest is a single run, which fits.
+        int capacity = (next < total) ? leafCapacity(&keys[0], next, total, compressLeaves) : LeafNode<K>::CAPACITY;
+        int end = next + std::max(1, (int)(capacity * fill));
+        if (end < total)
+        {
+            end = keyBoundary(&keys[0], next + 1, end, std::min(next + capacity, total - 1));
+        }
+        if (end < 0 || end > total)
+        {
+            end = total;
+        }
+        int count = end - next;
+        int leafEntries = 0;
+        for (int i = next; i < end; i++)
+        {
+            leafEntries += sizes[i];
+        }
+        fillLeaf(leaf, keys.data() + next, rids.data() + next, count, leafEntries - count, compressLeaves);
+        next = end;
+        leaf->rightSibPageNo = Page::INVALID_NUMBER;
+        leaf->leftSibPageNo = prevLeafPageId;
+        leaf->highKey = KeyTraits<K>::max();
+
+        // the separator of a leaf after the first only has to be above the keys of the one before
+        PageKeyPair<K> child;
+        child.set(leafPageId, (count == 0)                ? KeyTraits<K>::max()
+                              : (prevLeafPage == NULL) ? keys[next - count]
+                                                       : KeyTraits<K>::separator(keys[next - count - 1], keys[next - count]));
+        children.push_back(child);
+        childCounts.push_back(leafEntries);
+
+        // the previous leaf can be written out once it knows its right sibling, whose first key is its high key
+        if (prevLeafPage != NULL)
+        {
+            ((LeafNode<K> *)prevLeafPage)->rightSibPageNo = leafPageId;
+            ((LeafNode<K> *)prevLeafPage)->highKey = child.key;
+            this->unpinNode(prevLeafPageId, true);
+        }
+        prevLeafPage = leafPage;
+        prevLeafPageId = leafPageId;
+    } while (next < total);
+
+    this->unpinNode(prevLeafPageId, true);
+
+    // build the non-leaf levels until everything hangs off a single root.
+    // the root is always a non-leaf node, even when there is only one leaf.
+    int level = 1;
+    do
+    {
+        std::vector<PageKeyPair<K> > parents;
+        std::vector<int> parentCounts;
+        this->bulkLoadNonLeafLevel(children, childCounts, level, fillFactor, parents, parentCounts);
+        children.swap(parents);
+        childCounts.swap(parentCounts);
+        level++;
+    } while (children.size() > 1);
+
+    std::lock_guard<std::mutex> guard(metaMutex);
+    rootPageNum = children[0].pageNo;
+    this->updateMetaPage();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::bulkLoadNonLeafLevel
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::bulkLoadNonLeafLevel(const std::vector<PageKeyPair<K> > &children,
+                                          const std::vector<int> &childCounts, const int level,
+                                          const double fillFactor, std::vector<PageKeyPair<K> > &parents,
+                                          std::vector<int> &parentCounts)
+{
+    // the keys separating the children in their parents
+    std::vector<K> keys(children.size());
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        keys[i] = children[i].key;
+    }
+
+    Page *prevNodePage = NULL;
+    PageId prevNodePageId = 0;
+    size_t next = 0;
+    while (next < children.size())
+    {
+        // number of children in the node: those its keys leave room for times the fill factor, at least two so that
+        // every level shrinks. A level that fits in one node becomes the root, whatever the fill factor
+        int room = NonLeafView<K>::capacity(&keys[0], (int)next + 1, (int)children.size()) + 1;
+        int nodeFill = std::min(std::max((int)(room * fillFactor), 2), room);
+        if (next == 0 && (int)children.size() <= room)
+        {
+            nodeFill = room;
+        }
+
+        Page *nodePage;
+        PageId nodePageId;
+        bufMgr->allocPage(file, nodePageId, nodePage);
+        NonLeafNode<K> *node = (NonLeafNode<K> *)nodePage;
+        node->level = level;
+        node->highKey = KeyTraits<K>::max();
+        node->rightSibPageNo = Page::INVALID_NUMBER;
+
+        // the previous node can be written out once it knows its right neighbour, whose smallest key is its high key
+        if (prevNodePage != NULL)
+        {
+            ((NonLeafNode<K> *)prevNodePage)->rightSibPageNo = nodePageId;
+            ((NonLeafNode<K> *)prevNodePage)->highKey = children[next].key;
+            this->unpinNode(prevNodePageId, true);
+        }
+
+        PageKeyPair<K> parent;
+        parent.set(nodePageId, children[next].key);
+
+        // the first child needs no separator, every later child is separated by its smallest key
+        int count = 0;
+        int entries = 0;
+        for (; count < nodeFill && next < children.size(); count++, next++)
+        {
+            node->pageNoArray[count] = children[next].pageNo;
+            node->countArray[count] = childCounts[next];
+            entries += childCounts[next];
+        }
+        NonLeafView<K>(node).fill(keys.data() + next - count + 1, count - 1);
+        for (int i = count; i < NonLeafNode<K>::CAPACITY + 1; i++)
+        {
+            node->pageNoArray[i] = Page::INVALID_NUMBER;
+            node->countArray[i] = 0;
+        }
+
+        prevNodePage = nodePage;
+        prevNodePageId = nodePageId;
+        parents.push_back(parent);
+        parentCounts.push_back(entries);
+    }
+
+    this->unpinNode(prevNodePageId, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::~BTree -- destructor
+// -----------------------------------------------------------------------------
+
+template <class K>
+BTree<K>::~BTree()
+{
+    // end the scan run through startScan, if any, so that its leaf is unpinned
+    scanCursor.release();
+
+    // the cached nodes give up their pins, so that the file can be flushed
+    for (int i = 0; i < NODE_CACHE_CHUNKS; i++)
+    {
+        std::atomic<Page *> *chunk = nodeCache[i];
+        if (chunk == NULL)
+        {
+            continue;
+        }
+        nodeCache[i] = NULL;
+        for (int j = 0; j < NODE_CACHE_CHUNK; j++)
+        {
+            if (chunk[j] != NULL)
+            {
+                bufMgr->unPinPage(file, (PageId)(i * NODE_CACHE_CHUNK + j), true);
+            }
+        }
+        delete[] chunk;
+    }
+    bufMgr->releaseFrames(cachedNodes);
+    cachedNodes = 0;
+    bufMgr->flushFile(file);
+    delete file;
+    file = nullptr;
+    if (relationFile != NULL)
+    {
+        bufMgr->flushFile(relationFile);
+        delete relationFile;
+        relationFile = NULL;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::insertEntry
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::insertEntry(const void *key, const RecordId rid)
+{
+    // a single entry is a sorted batch of one
+    RIDKeyPair<K> entry;
+    entry.set(rid, KeyTraits<K>::fromValue(key));
+    if (KeyTraits<K>::unindexable(entry.key))
+    {
+        throw BadIndexInfoException("the key that pads the nodes, or NaN, cannot be indexed");
+    }
+    this->insertSorted(&entry, 1);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::insertEntries
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::insertEntries(const std::vector<RIDKeyPair<K> > &entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (KeyTraits<K>::unindexable(entries[i].key))
+        {
+            throw BadIndexInfoException("the key that pads the nodes, or NaN, cannot be indexed");
+        }
+    }
+
+    // on key, and on rid among equal keys: the order of the index
+    std::vector<RIDKeyPair<K> > sorted(entries);
+    std::sort(sorted.begin(), sorted.end());
+
+    this->insertSorted(&sorted[0], sorted.size());
+}
+
+// -----------------------------------------------------------------------------
+// BTree::insertSorted
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::insertSorted(const RIDKeyPair<K> *entries, const size_t count)
+{
+    // non-leaf nodes from the root down to the level above the current leaf, all pinned
+    std::vector<PathNode<K> > path;
+    size_t next = 0;
+    __atomic_fetch_add(&writeStats.inserts, (long long)count, __ATOMIC_RELAXED);
+
+    // the non-leaf nodes stay as they are until the counts above each leaf are updated
+    countLatch.lockShared();
+    while (next < count)
+    {
+        K key = entries[next].key;
+
+        // climb back up to the lowest node whose key range holds the key
+        while (!path.empty() && key >= path.back().highKey)
+        {
+            this->unpinNode(path.back().pageNo, path.back().dirty);
+            path.pop_back();
+        }
+        // and descend from there to the leaf, unless the key goes at the end of the last leaf
+        PageId leafPageNo;
+        K leafHighKey;
+        Page *leafPage;
+        std::uint64_t leafVersion;
+        if (!(path.empty() && this->appendLeaf(key, path, leafPageNo, leafHighKey, leafPage, leafVersion)) &&
+            !this->descendPath(key, path, leafPageNo, leafHighKey, leafPage, leafVersion))
+        {
+            // another thread changed a node on the way down: start over from the root
+            this->releasePath(path);
+            continue;
+        }
+
+        // every following entry below the high key of the leaf goes to the leaf too
+        size_t end = next + 1;
+        while (end < count && entries[end].key < leafHighKey)
+        {
+            end++;
+        }
+
+        PageId rightSibPageNo;
+        Page *rightSibPage;
+        bool share;
+        if (!this->latchInsert(leafPage, leafVersion, &entries[next], end - next, rightSibPageNo, rightSibPage,
+                               share))
+        {
+            this->unpinNode(leafPageNo, false);
+            this->releasePath(path);
+            if (share)
+            {
+                // the leaf shares its entries with a sibling, which moves entries between the key ranges of children
+                countLatch.unlockShared();
+                countLatch.lock();
+                structureEpoch++;
+                size_t inserted = this->insertRedistributed(&entries[next], end - next);
+                countLatch.unlock();
+                if (inserted == 0)
+                {
+                    // a leaf on the way waits for its separator, which cannot be posted until the latch is released
+                    std::this_thread::yield();
+                }
+                next += inserted;
+                countLatch.lockShared();
+            }
+            continue;
+        }
+
+        std::vector<PageKeyPair<K> > newLeaves;
+        this->insertIntoLeaf(leafPageNo, leafPage, entries + next, end - next, newLeaves);
+
+        // the right sibling only gets a new left link if the leaf did split
+        if (rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            this->releaseNode(rightSibPageNo, rightSibPage, !newLeaves.empty());
+        }
+        this->releaseNode(leafPageNo, leafPage);
+        this->addToCounts(path, (int)(end - next));
+        if (newLeaves.empty() && leafHighKey == KeyTraits<K>::max())
+        {
+            this->recordAppendPath(path, leafPageNo);
+        }
+
+        // the new leaves are reachable through the right links already; their separators follow,
+        // and the key ranges recorded on the path are stale once they are in
+        if (!newLeaves.empty())
+        {
+            countLatch.unlockShared();
+            countLatch.lock();
+            structureEpoch++;
+            this->postSeparators(path, leafPageNo, newLeaves);
+            countLatch.unlock();
+            this->releasePath(path);
+            countLatch.lockShared();
+        }
+
+        next = end;
+    }
+    countLatch.unlockShared();
+
+    this->releasePath(path);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::appendLeaf
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::appendLeaf(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, K &leafHighKey,
+                          Page *&leafPage, std::uint64_t &leafVersion)
+{
+    // the non-leaf nodes neither split nor merge while countLatch is held shared, so a path recorded
+    // under the same epoch still leads to the key range of the last leaf
+    {
+        std::lock_guard<std::mutex> guard(appendMutex);
+        if (appendLeafNum == Page::INVALID_NUMBER || appendEpoch != structureEpoch)
+        {
+            return false;
+        }
+        path = appendPath;
+        leafPageNo = appendLeafNum;
+    }
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        this->readNode(path[i].pageNo, path[i].page);
+        path[i].version = bufMgr->pageLatch(path[i].page).readLock();
+    }
+
+    // the leaf may have split since; the leaves split off it are still counted for it
+    this->readNode(leafPageNo, leafPage);
+    leafVersion = bufMgr->pageLatch(leafPage).readLock();
+    if (!this->moveRight(key, true, false, leafPageNo, leafPage, leafVersion))
+    {
+        this->unpinNode(leafPageNo, false);
+        this->releasePath(path);
+        return false;
+    }
+
+    // a key after the last one on the leaf is in its key range, from the bottom as well
+    LeafView<K> view(leafPage);
+    int size = view.size();
+    bool after = size > 0 && key > view.key(size - 1);
+    leafHighKey = ((LeafNode<K> *)leafPage)->highKey;
+    if (!after || !bufMgr->pageLatch(leafPage).validate(leafVersion))
+    {
+        this->unpinNode(leafPageNo, false);
+        this->releasePath(path);
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::recordAppendPath
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::recordAppendPath(const std::vector<PathNode<K> > &path, const PageId leafPageNo)
+{
+    std::lock_guard<std::mutex> guard(appendMutex);
+    if (appendLeafNum == leafPageNo && appendEpoch == structureEpoch)
+    {
+        return;
+    }
+    appendPath = path;
+    for (size_t i = 0; i < appendPath.size(); i++)
+    {
+        appendPath[i].page = NULL;
+        appendPath[i].dirty = false;
+        appendPath[i].locked = false;
+    }
+    appendLeafNum = leafPageNo;
+    appendEpoch = structureEpoch;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::addToCounts
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::addToCounts(std::vector<PathNode<K> > &path, const int delta)
+{
+    // other writers add to the same counts at the same time, without latching the nodes:
+    // the additions are atomic, and leave the versions readers validate against alone
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        NonLeafNode<K> *node = (NonLeafNode<K> *)path[i].page;
+        __atomic_fetch_add(&node->countArray[path[i].index], delta, __ATOMIC_RELAXED);
+        path[i].dirty = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::moveRight
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::moveRight(const K key, const bool leaf, const bool leftmost, PageId &pageNo, Page *&page,
+                         std::uint64_t &version)
+{
+    while (true)
+    {
+        K highKey = leaf ? ((LeafNode<K> *)page)->highKey : ((NonLeafNode<K> *)page)->highKey;
+        PageId rightPageNo = leaf ? ((LeafNode<K> *)page)->rightSibPageNo : ((NonLeafNode<K> *)page)->rightSibPageNo;
+        bool right = leftmost ? key > highKey : key >= highKey;
+
+        VersionLatch &latch = bufMgr->pageLatch(page);
+        if (!latch.validate(version))
+        {
+            return false;
+        }
+        if (!right || rightPageNo == Page::INVALID_NUMBER)
+        {
+            return true;
+        }
+
+        // the node split after its parent was read: its upper keys are on the right.
+        // the node must still link to its neighbour once the neighbour's version is known.
+        Page *rightPage;
+        this->readNode(rightPageNo, rightPage);
+        std::uint64_t rightVersion = bufMgr->pageLatch(rightPage).readLock();
+        bool valid = latch.validate(version);
+        this->unpinNode(pageNo, false);
+        pageNo = rightPageNo;
+        page = rightPage;
+        version = rightVersion;
+        if (!valid)
+        {
+            return false;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::descendPath
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::descendPath(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, K &leafHighKey,
+                           Page *&leafPage, std::uint64_t &leafVersion)
+{
+    if (path.empty())
+    {
+        PathNode<K> root;
+        root.pageNo = rootPageNum;
+        this->readNode(root.pageNo, root.page);
+        root.version = bufMgr->pageLatch(root.page).readLock();
+        root.highKey = KeyTraits<K>::max();
+        root.index = 0;
+        root.dirty = false;
+        root.locked = false;
+        path.push_back(root);
+
+        // the root may have been replaced between reading its page number and its version
+        if (rootPageNum != root.pageNo)
+        {
+            return false;
+        }
+    }
+
+    while (true)
+    {
+        // the node may have split since it was reached
+        PathNode<K> &parent = path.back();
+        if (!this->moveRight(key, false, false, parent.pageNo, parent.page, parent.version))
+        {
+            return false;
+        }
+        NonLeafNode<K> *node = (NonLeafNode<K> *)parent.page;
+        parent.highKey = node->highKey;
+        // the child to recurse on is the one after the last key <= the key, i.e. the number of keys <= the key
+        parent.index = NonLeafView<K>(node).upperBound(key);
+
+        PageId childPageNo = node->pageNoArray[parent.index];
+        bool childIsLeaf = node->level == 1;
+
+        // everything read from the parent has to be consistent before the child is followed,
+        // and the parent must still point at the child once the child's version is known
+        VersionLatch &parentLatch = bufMgr->pageLatch(parent.page);
+        if (!parentLatch.validate(parent.version))
+        {
+            return false;
+        }
+        Page *child;
+        this->readNode(childPageNo, child);
+        std::uint64_t childVersion = bufMgr->pageLatch(child).readLock();
+        if (!parentLatch.validate(parent.version))
+        {
+            this->unpinNode(childPageNo, false);
+            return false;
+        }
+
+        if (childIsLeaf)
+        {
+            if (!this->moveRight(key, true, false, childPageNo, child, childVersion))
+            {
+                this->unpinNode(childPageNo, false);
+                return false;
+            }
+            leafPageNo = childPageNo;
+            leafHighKey = ((LeafNode<K> *)child)->highKey;
+            leafPage = child;
+            leafVersion = childVersion;
+            return true;
+        }
+
+        PathNode<K> childNode;
+        childNode.pageNo = childPageNo;
+        childNode.page = child;
+        childNode.version = childVersion;
+        childNode.highKey = KeyTraits<K>::max();
+        childNode.index = 0;
+        childNode.dirty = false;
+        childNode.locked = false;
+        path.push_back(childNode);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::lockPath
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::lockPath(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, Page *&leafPage)
+{
+    PathNode<K> root;
+    while (true)
+    {
+        root.pageNo = rootPageNum;
+        this->readNode(root.pageNo, root.page);
+        bufMgr->pageLatch(root.page).lock();
+
+        // the root is only replaced with its latch held, so once latched it stays the root
+        if (rootPageNum == root.pageNo)
+        {
+            break;
+        }
+        bufMgr->pageLatch(root.page).unlock();
+        this->unpinNode(root.pageNo, false);
+    }
+    root.highKey = ((NonLeafNode<K> *)root.page)->highKey;
+    root.index = 0;
+    root.dirty = false;
+    root.locked = true;
+    path.push_back(root);
+
+    // a node whose high key is at or below the key split and is waiting for its separator
+    bool posting = key >= root.highKey;
+    while (!posting)
+    {
+        PathNode<K> &parent = path.back();
+        NonLeafNode<K> *node = (NonLeafNode<K> *)parent.page;
+        // the child to recurse on is the one after the last key <= the key, i.e. the number of keys <= the key
+        parent.index = NonLeafView<K>(node).upperBound(key);
+
+        PageId childPageNo = node->pageNoArray[parent.index];
+        bool childIsLeaf = node->level == 1;
+
+        Page *child;
+        this->readNode(childPageNo, child);
+        bufMgr->pageLatch(child).lock();
+
+        K childHighKey = childIsLeaf ? ((LeafNode<K> *)child)->highKey : ((NonLeafNode<K> *)child)->highKey;
+        if (key >= childHighKey)
+        {
+            bufMgr->pageLatch(child).unlock();
+            this->unpinNode(childPageNo, false);
+            posting = true;
+            break;
+        }
+
+        if (childIsLeaf)
+        {
+            leafPageNo = childPageNo;
+            leafPage = child;
+            return true;
+        }
+
+        PathNode<K> childNode;
+        childNode.pageNo = childPageNo;
+        childNode.page = child;
+        childNode.highKey = childHighKey;
+        childNode.index = 0;
+        childNode.dirty = false;
+        childNode.locked = true;
+        path.push_back(childNode);
+    }
+
+    // the insert that split the node has to post the separator first
+    this->releasePath(path);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::latchInsert
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::latchInsert(Page *leafPage, const std::uint64_t leafVersion, const RIDKeyPair<K> *entries,
+                           const size_t count, PageId &rightSibPageNo, Page *&rightSibPage, bool &share)
+{
+    rightSibPageNo = Page::INVALID_NUMBER;
+    share = false;
+
+    // latched at the version it was read at, the leaf is known not to have changed since
+    VersionLatch &leafLatch = bufMgr->pageLatch(leafPage);
+    if (!leafLatch.tryUpgrade(leafVersion))
+    {
+        return false;
+    }
+
+    // the leaf does not split if the entries fit plain, or packed along with its own
+    LeafNode<K> *leaf = (LeafNode<K> *)leafPage;
+    LeafView<K> view(leaf);
+    int size = view.size();
+    size_t total = size + count;
+    if (total <= (size_t)LeafNode<K>::CAPACITY || leaf->rightSibPageNo == Page::INVALID_NUMBER)
+    {
+        return true;
+    }
+    if (compressLeaves && total <= (size_t)PackedLeafNode<K>::CAPACITY)
+    {
+        K low = (size > 0) ? std::min(view.key(0), entries[0].key) : entries[0].key;
+        K high = (size > 0) ? std::max(view.key(size - 1), entries[count - 1].key) : entries[count - 1].key;
+        if (KeyDelta<K>::distance(low, high) <= (std::uint64_t)PACKED_MAX_DELTA)
+        {
+            return true;
+        }
+    }
+
+    // the leaf would split: it shares its entries with a sibling instead, with every other writer kept out
+    if (redistributeLeaves)
+    {
+        leafLatch.unlock();
+        share = true;
+        return false;
+    }
+
+    // the leaf splits: its right sibling gets a new left link
+    this->readNode(leaf->rightSibPageNo, rightSibPage);
+    if (!bufMgr->pageLatch(rightSibPage).tryLock())
+    {
+        this->unpinNode(leaf->rightSibPageNo, false);
+        leafLatch.unlock();
+        return false;
+    }
+    rightSibPageNo = leaf->rightSibPageNo;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::insertRedistributed
+// -----------------------------------------------------------------------------
+
+template <class K>
+size_t BTree<K>::insertRedistributed(const RIDKeyPair<K> *entries, size_t count)
+{
+    std::vector<PathNode<K> > path;
+    PageId leafPageNo;
+    Page *leafPage;
+    if (!this->lockPath(entries[0].key, path, leafPageNo, leafPage))
+    {
+        return 0;
+    }
+
+    // the leaf may have split since the entries were picked for it
+    K highKey = ((LeafNode<K> *)leafPage)->highKey;
+    while (entries[count - 1].key >= highKey)
+    {
+        count--;
+    }
+
+    // the right sibling is preferred, and two leaves are only split into three if neither sibling has room
+    std::vector<PageId> splitPageNos;
+    std::vector<std::vector<PageKeyPair<K> > > newLeaves;
+    int index = path.back().index;
+    int size = NonLeafView<K>(path.back().page).size();
+    bool shared = false;
+    for (int parts = 2; parts <= 3 && !shared; parts++)
+    {
+        shared = (index < size && this->shareLeaves(path, index + 1, leafPageNo, leafPage, entries, count, parts,
+                                                    splitPageNos, newLeaves)) ||
+                 (index > 0 && this->shareLeaves(path, index, leafPageNo, leafPage, entries, count, parts,
+                                                 splitPageNos, newLeaves));
+    }
+    if (!shared)
+    {
+        // the leaf splits on its own, and its right sibling gets a new left link
+        PageId rightSibPageNo = ((LeafNode<K> *)leafPage)->rightSibPageNo;
+        Page *rightSibPage;
+        if (rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            this->readNode(rightSibPageNo, rightSibPage);
+            bufMgr->pageLatch(rightSibPage).lock();
+        }
+        splitPageNos.push_back(leafPageNo);
+        newLeaves.resize(1);
+        this->insertIntoLeaf(leafPageNo, leafPage, entries, count, newLeaves[0]);
+        if (rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            this->releaseNode(rightSibPageNo, rightSibPage, !newLeaves[0].empty());
+        }
+        this->releaseNode(leafPageNo, leafPage);
+        this->addToCounts(path, (int)count);
+    }
+
+    // the path is valid again once unlatched, and leads to the parent of every leaf split
+    this->unlockPath(path);
+    for (size_t i = 0; i < splitPageNos.size(); i++)
+    {
+        if (!newLeaves[i].empty())
+        {
+            this->postSeparators(path, splitPageNos[i], newLeaves[i]);
+        }
+    }
+    this->releasePath(path);
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::shareLeaves
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::shareLeaves(std::vector<PathNode<K> > &path, const int rightIndex, const PageId leafPageNo,
+                           Page *leafPage, const RIDKeyPair<K> *entries, const size_t count, const int parts,
+                           std::vector<PageId> &splitPageNos, std::vector<std::vector<PageKeyPair<K> > > &newLeaves)
+{
+    PathNode<K> &parentInfo = path.back();
+    NonLeafNode<K> *parent = (NonLeafNode<K> *)parentInfo.page;
+    PageId leftPageNo = parent->pageNoArray[rightIndex - 1];
+    PageId rightPageNo = parent->pageNoArray[rightIndex];
+    PageId siblingPageNo = (leftPageNo == leafPageNo) ? rightPageNo : leftPageNo;
+    Page *siblingPage;
+    this->readNode(siblingPageNo, siblingPage);
+    bufMgr->pageLatch(siblingPage).lock();
+    Page *leftPage = (leftPageNo == leafPageNo) ? leafPage : siblingPage;
+    Page *rightPage = (leftPageNo == leafPageNo) ? siblingPage : leafPage;
+    LeafNode<K> *left = (LeafNode<K> *)leftPage;
+    LeafNode<K> *right = (LeafNode<K> *)rightPage;
+
+    // the keys of both leaves, in order, and the new keys among them
+    LeafView<K> leftView(left);
+    LeafView<K> rightView(right);
+    int leftSize = leftView.size();
+    int rightSize = rightView.size();
+    int total = leftSize + rightSize;
+    std::vector<K> keys(total);
+    leftView.keys(0, leftSize, keys.data());
+    rightView.keys(0, rightSize, keys.data() + leftSize);
+    std::vector<K> allKeys(total + count);
+    for (size_t j = 0; j < count; j++)
+    {
+        allKeys[total + j] = entries[j].key;
+    }
+    std::merge(keys.begin(), keys.end(), allKeys.begin() + total, allKeys.end(), allKeys.begin());
+
+    // the leaves meet where the keys change, each holding its share of the old and new entries together.
+    // a leaf split off the left one and still waiting for its separator sits between them, and they are left alone.
+    int all = (int)allKeys.size();
+    std::vector<int> cuts;
+    if (left->rightSibPageNo == rightPageNo && all >= parts)
+    {
+        if (parts == 2)
+        {
+            int cut = evenSplit(allKeys.data(), all, compressLeaves);
+            if (cut >= 0)
+            {
+                cuts.push_back(cut);
+            }
+        }
+        else
+        {
+            int begin = 0;
+            for (int n = 1; n < parts && begin >= 0; n++)
+            {
+                int lo = begin + 1;
+                int hi = std::min(begin + leafCapacity(allKeys.data(), begin, all, compressLeaves), all - 1);
+                int target = std::max(lo, std::min(hi, begin + (all - begin) / (parts - n + 1)));
+                begin = (lo <= hi) ? keyBoundary(allKeys.data(), lo, target, hi) : -1;
+                cuts.push_back(begin);
+            }
+            if (begin < 0 || all - begin > leafCapacity(allKeys.data(), begin, all, compressLeaves))
+            {
+                cuts.clear();
+            }
+        }
+    }
+
+    // the leaves get separators between the keys they meet at, and the parent the first in place of the old one,
+    // if its keys still fit
+    std::vector<K> separators;
+    for (size_t n = 0; n < cuts.size(); n++)
+    {
+        separators.push_back(KeyTraits<K>::separator(allKeys[cuts[n] - 1], allKeys[cuts[n]]));
+    }
+    if (!cuts.empty() && !NonLeafView<K>(parent).holds(rightIndex - 1, separators[0]))
+    {
+        cuts.clear();
+    }
+    if (cuts.empty())
+    {
+        bufMgr->pageLatch(siblingPage).unlock();
+        this->unpinNode(siblingPageNo, false);
+        return false;
+    }
+
+    // the entries of both leaves, with the number of entries each slot stands for
+    std::vector<RecordId> rids(total);
+    std::vector<int> sizes(total, 1);
+    memcpy(rids.data(), leftView.rids(), leftSize * sizeof(RecordId));
+    memcpy(rids.data() + leftSize, rightView.rids(), rightSize * sizeof(RecordId));
+    for (int k = 0; k < total; k++)
+    {
+        if (isPosting(rids[k]))
+        {
+            sizes[k] = (k < leftSize) ? this->leafEntries(left, k, k + 1) : this->leafEntries(right, k - leftSize,
+                                                                                             k - leftSize + 1);
+        }
+    }
+    int leftEntries = leftSize + left->postingEntries;
+    int rightEntries = rightSize + right->postingEntries;
+
+    // the third leaf goes in after the right one, and is counted for it until its separator is posted
+    std::vector<PageId> pageNos;
+    std::vector<Page *> pages;
+    pageNos.push_back(leftPageNo);
+    pages.push_back(leftPage);
+    pageNos.push_back(rightPageNo);
+    pages.push_back(rightPage);
+    if (parts == 3)
+    {
+        PageId newPageNo;
+        Page *newPage;
+        this->allocNode(newPageNo, newPage);
+        LeafNode<K> *newLeaf = (LeafNode<K> *)newPage;
+        newLeaf->rightSibPageNo = right->rightSibPageNo;
+        newLeaf->leftSibPageNo = rightPageNo;
+        newLeaf->highKey = right->highKey;
+        if (newLeaf->rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            Page *rightSibPage;
+            this->readNode(newLeaf->rightSibPageNo, rightSibPage);
+            bufMgr->pageLatch(rightSibPage).lock();
+            ((LeafNode<K> *)rightSibPage)->leftSibPageNo = newPageNo;
+            this->releaseNode(newLeaf->rightSibPageNo, rightSibPage);
+        }
+        right->rightSibPageNo = newPageNo;
+        right->highKey = separators[1];
+
+        PageKeyPair<K> separator;
+        separator.set(newPageNo, separators[1]);
+        splitPageNos.push_back(rightPageNo);
+        newLeaves.push_back(std::vector<PageKeyPair<K> >(1, separator));
+        pageNos.push_back(newPageNo);
+        pages.push_back(newPage);
+    }
+    left->highKey = separators[0];
+    NonLeafView<K>(parent).set(rightIndex - 1, separators[0]);
+    parentInfo.dirty = true;
+
+    // the old entries are refilled first, then the new ones merged into the leaf whose key range holds them
+    std::vector<int> partEntries(parts, 0);
+    int begin = 0;
+    size_t next = 0;
+    for (int n = 0; n < parts; n++)
+    {
+        int end = (n + 1 < parts) ? (int)(std::lower_bound(keys.begin(), keys.end(), allKeys[cuts[n]]) - keys.begin())
+                                  : total;
+        for (int k = begin; k < end; k++)
+        {
+            partEntries[n] += sizes[k];
+        }
+        fillLeaf((LeafNode<K> *)pages[n], keys.data() + begin, rids.data() + begin, end - begin,
+                 partEntries[n] - (end - begin), compressLeaves);
+        begin = end;
+    }
+    parent->countArray[rightIndex - 1] += partEntries[0] - leftEntries;
+    parent->countArray[rightIndex] += partEntries[1] + ((parts == 3) ? partEntries[2] : 0) - rightEntries;
+
+    for (int n = 0; n < parts; n++)
+    {
+        size_t end = next;
+        while (end < count && (n + 1 == parts || entries[end].key < allKeys[cuts[n]]))
+        {
+            end++;
+        }
+        if (end > next)
+        {
+            std::vector<PageKeyPair<K> > splitLeaves;
+            this->insertIntoLeaf(pageNos[n], pages[n], entries + next, end - next, splitLeaves);
+            if (!splitLeaves.empty())
+            {
+                splitPageNos.push_back(pageNos[n]);
+                newLeaves.push_back(splitLeaves);
+            }
+            parent->countArray[rightIndex - ((n == 0) ? 1 : 0)] += (int)(end - next);
+        }
+        next = end;
+    }
+    for (size_t i = 0; i + 1 < path.size(); i++)
+    {
+        ((NonLeafNode<K> *)path[i].page)->countArray[path[i].index] += (int)count;
+        path[i].dirty = true;
+    }
+
+    this->releaseNode(leftPageNo, leftPage);
+    this->releaseNode(rightPageNo, rightPage);
+    if (parts == 3)
+    {
+        this->unpinNode(pageNos[2], true);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::insertIntoLeaf
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::insertIntoLeaf(const PageId leafPageNo, Page *leafPage, const RIDKeyPair<K> *entries,
+                                    size_t count, std::vector<PageKeyPair<K> > &newLeaves)
+{
+    LeafNode<K> *leaf = (LeafNode<K> *)leafPage;
+    LeafView<K> view(leaf);
+    RecordId *leafRids = view.rids();
+    int size = view.size();
+
+    // entries whose key has a posting list on the leaf go to the list, the others to slots of their own
+    std::vector<RIDKeyPair<K> > slotEntries;
+    bool posted = false;
+    for (size_t j = 0; j < count;)
+    {
+        size_t runEnd = j + 1;
+        while (runEnd < count && entries[runEnd].key == entries[j].key)
+        {
+            runEnd++;
+        }
+        int i = view.lowerBound(entries[j].key);
+        if (i < size && view.key(i) == entries[j].key && isPosting(leafRids[i]))
+        {
+            if (!posted)
+            {
+                slotEntries.assign(entries, entries + j);
+                posted = true;
+            }
+            std::vector<RecordId> rids(runEnd - j);
+            for (size_t k = j; k < runEnd; k++)
+            {
+                rids[k - j] = entries[k].rid;
+            }
+            this->addToPosting(leafRids[i].page_number, &rids[0], (int)rids.size());
+            leaf->postingEntries += (int)rids.size();
+        }
+        else if (posted)
+        {
+            slotEntries.insert(slotEntries.end(), entries + j, entries + runEnd);
+        }
+        j = runEnd;
+    }
+    if (posted)
+    {
+        entries = slotEntries.data();
+        count = slotEntries.size();
+    }
+    if (count == 0)
+    {
+        return;
+    }
+
+    // a key reaching LeafNode<K>::POSTING_MIN entries moves to a posting list
+    bool fold = false;
+    for (size_t j = 0; j < count && !fold;)
+    {
+        size_t runEnd = j + 1;
+        while (runEnd < count && entries[runEnd].key == entries[j].key)
+        {
+            runEnd++;
+        }
+        int onLeaf = view.upperBound(entries[j].key) - view.lowerBound(entries[j].key);
+        fold = onLeaf + (int)(runEnd - j) >= LeafNode<K>::POSTING_MIN;
+        j = runEnd;
+    }
+
+    // the entries go in place if they fit the leaf's layout; a packed leaf also needs their keys near its base
+    size_t total = size + count;
+    bool inPlace = total <= (size_t)view.capacity() && !fold;
+    for (size_t j = 0; j < count && inPlace; j++)
+    {
+        inPlace = view.holds(entries[j].key);
+    }
+    if (inPlace)
+    {
+        // merge from the back, so that every entry already on the leaf moves at most once.
+        // equal keys are ordered on their rids, a new entry going after an equal one.
+        int i = size - 1;
+        int j = (int)count - 1;
+        for (int k = (int)total - 1; j >= 0; k--)
+        {
+            if (i >= 0 && (view.key(i) > entries[j].key ||
+                           (view.key(i) == entries[j].key && ridLess(entries[j].rid, leafRids[i]))))
+            {
+                view.set(k, view.key(i), leafRids[i]);
+                i--;
+            }
+            else
+            {
+                view.set(k, entries[j].key, entries[j].rid);
+                j--;
+            }
+        }
+        return;
+    }
+
+    // merge the entries with the leaf's entries, with the number of entries each slot stands for
+    std::vector<K> keys(total);
+    std::vector<RecordId> rids(total);
+    std::vector<int> sizes(total, 1);
+    std::vector<K> leafKeys(size);
+    view.keys(0, size, leafKeys.data());
+    int i = 0;
+    size_t j = 0;
+    for (size_t k = 0; k < total; k++)
+    {
+        if (j == count || (i < size && (leafKeys[i] < entries[j].key ||
+                                        (leafKeys[i] == entries[j].key && !ridLess(entries[j].rid, leafRids[i])))))
+        {
+            keys[k] = leafKeys[i];
+            rids[k] = leafRids[i];
+            if (isPosting(rids[k]))
+            {
+                sizes[k] = this->leafEntries(leaf, i, i + 1);
+            }
+            i++;
+        }
+        else
+        {
+            keys[k] = entries[j].key;
+            rids[k] = entries[j].rid;
+            j++;
+        }
+    }
+    if (fold)
+    {
+        this->foldPostings(keys, rids, sizes);
+        total = keys.size();
+    }
+
+    // the entries are spread evenly over the leaf and as few new leaves as can hold them, each ending
+    // between two keys. Runs of equal keys are shorter than half a leaf, so there is always such a place.
+    // Entries that all go after the leaf's own fill the leaves in turn instead, up to APPEND_SPLIT_FILL,
+    // or completely on the last leaf, since the keys coming next most likely go after them again.
+    bool append = size > 0 && entries[0].key > leafKeys[size - 1];
+    double appendFill = (leaf->rightSibPageNo == Page::INVALID_NUMBER) ? 1.0 : APPEND_SPLIT_FILL;
+    std::vector<int> ends;
+    int begin = 0;
+    int capacity;
+    while ((int)total - begin > (capacity = leafCapacity(&keys[0], begin, (int)total, compressLeaves)))
+    {
+        int parts = ((int)total - begin + capacity - 1) / capacity;
+        int target = append ? begin + std::max(1, (int)(capacity * appendFill)) : begin + ((int)total - begin) / parts;
+        begin = keyBoundary(&keys[0], begin + 1, target, begin + capacity);
+        ends.push_back(begin);
+    }
+    ends.push_back((int)total);
+
+    PageId rightSibPageNo = leaf->rightSibPageNo;
+    K highKey = leaf->highKey;
+
+    // the leaf being written and its page number. The original leaf is unpinned by the caller.
+    Page *page = leafPage;
+    PageId pageNo = Page::INVALID_NUMBER;
+    begin = 0;
+    for (size_t n = 0; n < ends.size(); n++)
+    {
+        int end = ends[n];
+
+        if (n > 0)
+        {
+            Page *newPage;
+            PageId newPageNo;
+            this->allocNode(newPageNo, newPage);
+
+            // the previous leaf can be written out once it knows its right sibling, and the separator between them as
+            // its high key
+            K separatorKey = KeyTraits<K>::separator(keys[begin - 1], keys[begin]);
+            ((LeafNode<K> *)page)->rightSibPageNo = newPageNo;
+            ((LeafNode<K> *)page)->highKey = separatorKey;
+            ((LeafNode<K> *)newPage)->leftSibPageNo = (pageNo != Page::INVALID_NUMBER) ? pageNo : leafPageNo;
+            if (pageNo != Page::INVALID_NUMBER)
+            {
+                this->unpinNode(pageNo, true);
+            }
+            page = newPage;
+            pageNo = newPageNo;
+
+            PageKeyPair<K> separator;
+            separator.set(newPageNo, separatorKey);
+            newLeaves.push_back(separator);
+        }
+
+        int partEntries = 0;
+        for (int k = begin; k < end; k++)
+        {
+            partEntries += sizes[k];
+        }
+        fillLeaf((LeafNode<K> *)page, &keys[begin], &rids[begin], end - begin, partEntries - (end - begin),
+                 compressLeaves);
+        begin = end;
+    }
+
+    ((LeafNode<K> *)page)->rightSibPageNo = rightSibPageNo;
+    ((LeafNode<K> *)page)->highKey = highKey;
+    if (pageNo != Page::INVALID_NUMBER)
+    {
+        this->unpinNode(pageNo, true);
+    }
+
+    // the leaf after the new ones now has the last of them on its left
+    if (rightSibPageNo != Page::INVALID_NUMBER && pageNo != Page::INVALID_NUMBER)
+    {
+        Page *rightSibPage;
+        this->readNode(rightSibPageNo, rightSibPage);
+        ((LeafNode<K> *)rightSibPage)->leftSibPageNo = pageNo;
+        this->unpinNode(rightSibPageNo, true);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::foldPostings
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::foldPostings(std::vector<K> &keys, std::vector<RecordId> &rids, std::vector<int> &sizes)
+{
+    size_t out = 0;
+    for (size_t j = 0; j < keys.size();)
+    {
+        size_t runEnd = j + 1;
+        while (runEnd < keys.size() && keys[runEnd] == keys[j])
+        {
+            runEnd++;
+        }
+
+        if (runEnd - j >= (size_t)LeafNode<K>::POSTING_MIN)
+        {
+            // the run is in rid order already, and keeps it on the posting pages
+            RecordId head;
+            head.page_number = this->writePosting(&rids[j], (int)(runEnd - j));
+            head.slot_number = POSTING_SLOT;
+            keys[out] = keys[j];
+            rids[out] = head;
+            sizes[out] = (int)(runEnd - j);
+            out++;
+        }
+        else
+        {
+            for (size_t k = j; k < runEnd; k++, out++)
+            {
+                keys[out] = keys[k];
+                rids[out] = rids[k];
+                sizes[out] = sizes[k];
+            }
+        }
+        j = runEnd;
+    }
+    keys.resize(out);
+    rids.resize(out);
+    sizes.resize(out);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::writePosting
+// -----------------------------------------------------------------------------
+
+template <class K>
+PageId BTree<K>::writePosting(const RecordId *rids, const int count)
+{
+    // the pages are not reachable before the leaf is, so they are written without their latches
+    PageId headPageNo = Page::INVALID_NUMBER;
+    Page *headPage = NULL;
+    PageId prevPageNo = Page::INVALID_NUMBER;
+    Page *prevPage = NULL;
+    int begin = 0;
+    while (begin < count)
+    {
+        int end = begin + postingFit(rids + begin, count - begin);
+        PageId pageNo;
+        Page *page;
+        this->allocNode(pageNo, page);
+        PostingNode *node = (PostingNode *)page;
+        encodePosting(node, rids + begin, end - begin);
+        node->nextPageNo = Page::INVALID_NUMBER;
+        node->prevPageNo = prevPageNo;
+        node->lastPageNo = Page::INVALID_NUMBER;
+        node->total = 0;
+
+        if (prevPage != NULL)
+        {
+            ((PostingNode *)prevPage)->nextPageNo = pageNo;
+            if (prevPage != headPage)
+            {
+                this->unpinNode(prevPageNo, true);
+            }
+        }
+        if (headPage == NULL)
+        {
+            headPage = page;
+            headPageNo = pageNo;
+        }
+        prevPage = page;
+        prevPageNo = pageNo;
+        begin = end;
+    }
+
+    ((PostingNode *)headPage)->total = count;
+    ((PostingNode *)headPage)->lastPageNo = prevPageNo;
+    if (prevPage != headPage)
+    {
+        this->unpinNode(prevPageNo, true);
+    }
+    this->unpinNode(headPageNo, true);
+    return headPageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::addToPosting
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::addToPosting(const PageId headPageNo, const RecordId *rids, const int count)
+{
+    Page *headPage;
+    this->readNode(headPageNo, headPage);
+    PostingNode *head = (PostingNode *)headPage;
+    PageId lastPageNo = head->lastPageNo;
+
+    // record ids from the first one of the last page on, as when a relation grows, go straight to the last page
+    PageId pageNo = headPageNo;
+    if (lastPageNo != headPageNo)
+    {
+        Page *lastPage;
+        this->readNode(lastPageNo, lastPage);
+        if (!ridLess(rids[0], ((PostingNode *)lastPage)->firstRid))
+        {
+            pageNo = lastPageNo;
+        }
+        this->unpinNode(lastPageNo, false);
+    }
+
+    int begin = 0;
+    while (begin < count)
+    {
+        Page *page;
+        this->readNode(pageNo, page);
+        PostingNode *node = (PostingNode *)page;
+        PageId nextPageNo = node->nextPageNo;
+
+        // the record ids up to the last one of the page go to it, and all of the rest to the last page
+        int end = begin;
+        while (end < count && (nextPageNo == Page::INVALID_NUMBER || !ridLess(node->lastRid, rids[end])))
+        {
+            end++;
+        }
+        if (end == begin)
+        {
+            this->unpinNode(pageNo, false);
+            pageNo = nextPageNo;
+            continue;
+        }
+
+        std::vector<RecordId> pageRids;
+        decodePosting(node, pageRids);
+        std::vector<RecordId> merged(pageRids.size() + (end - begin));
+        std::merge(pageRids.begin(), pageRids.end(), rids + begin, rids + end, merged.begin(), ridLess);
+        int fit = postingFit(&merged[0], (int)merged.size());
+
+        // the page keeps what fits, and the rest moves to new pages linked in after it. Those are written before
+        // they are linked, the page is changed before the one after it, and a reader going left from that one
+        // finds them by going right again from the page, so every reader sees each record id once.
+        PageId firstNewPageNo = nextPageNo;
+        PageId prevPageNo = pageNo;
+        Page *prevPage = NULL;
+        for (int k = fit; k < (int)merged.size();)
+        {
+            int kEnd = k + postingFit(&merged[k], (int)merged.size() - k);
+            PageId newPageNo;
+            Page *newPage;
+            this->allocNode(newPageNo, newPage);
+            PostingNode *newNode = (PostingNode *)newPage;
+            encodePosting(newNode, &merged[k], kEnd - k);
+            newNode->prevPageNo = prevPageNo;
+            newNode->nextPageNo = nextPageNo;
+            newNode->lastPageNo = Page::INVALID_NUMBER;
+            newNode->total = 0;
+            if (prevPage != NULL)
+            {
+                ((PostingNode *)prevPage)->nextPageNo = newPageNo;
+                this->unpinNode(prevPageNo, true);
+            }
+            else
+            {
+                firstNewPageNo = newPageNo;
+            }
+            prevPage = newPage;
+            prevPageNo = newPageNo;
+            k = kEnd;
+        }
+        if (prevPage != NULL)
+        {
+            this->unpinNode(prevPageNo, true);
+        }
+
+        VersionLatch &latch = bufMgr->pageLatch(page);
+        latch.lock();
+        encodePosting(node, &merged[0], fit);
+        node->nextPageNo = firstNewPageNo;
+        latch.unlock();
+        this->unpinNode(pageNo, true);
+
+        if (firstNewPageNo != nextPageNo)
+        {
+            if (nextPageNo != Page::INVALID_NUMBER)
+            {
+                Page *nextPage;
+                this->readNode(nextPageNo, nextPage);
+                bufMgr->pageLatch(nextPage).lock();
+                ((PostingNode *)nextPage)->prevPageNo = prevPageNo;
+                this->releaseNode(nextPageNo, nextPage);
+            }
+            else
+            {
+                lastPageNo = prevPageNo;
+            }
+        }
+
+        begin = end;
+        pageNo = nextPageNo;
+    }
+
+    VersionLatch &headLatch = bufMgr->pageLatch(headPage);
+    headLatch.lock();
+    head->total += count;
+    head->lastPageNo = lastPageNo;
+    this->releaseNode(headPageNo, headPage);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::removeFromPosting
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::removeFromPosting(PageId &headPageNo, const RecordId rid)
+{
+    int total;
+    RecordId firstRid;
+    PageId headPrevPageNo;
+    PageId lastPageNo;
+    this->readPostingHead(headPageNo, total, firstRid, headPrevPageNo, lastPageNo);
+
+    // the record id is on the first page whose last record id is not below it
+    PageId pageNo = headPageNo;
+    Page *page;
+    this->readNode(pageNo, page);
+    PostingNode *node = (PostingNode *)page;
+    while (ridLess(node->lastRid, rid) && node->nextPageNo != Page::INVALID_NUMBER)
+    {
+        PageId nextPageNo = node->nextPageNo;
+        this->unpinNode(pageNo, false);
+        pageNo = nextPageNo;
+        this->readNode(pageNo, page);
+        node = (PostingNode *)page;
+    }
+
+    std::vector<RecordId> rids;
+    decodePosting(node, rids);
+    std::vector<RecordId>::iterator it = std::lower_bound(rids.begin(), rids.end(), rid, ridLess);
+    if (it == rids.end() || *it != rid)
+    {
+        this->unpinNode(pageNo, false);
+        return false;
+    }
+    rids.erase(it);
+
+    bufMgr->pageLatch(page).lock();
+    PageId newHeadPageNo = headPageNo;
+    if (!rids.empty())
+    {
+        encodePosting(node, &rids[0], (int)rids.size());
+        this->releaseNode(pageNo, page);
+    }
+    else
+    {
+        // the page leaves the list: its neighbours are linked to each other
+        PageId prevPageNo = node->prevPageNo;
+        PageId nextPageNo = node->nextPageNo;
+        if (prevPageNo != Page::INVALID_NUMBER)
+        {
+            Page *prevPage;
+            this->readNode(prevPageNo, prevPage);
+            bufMgr->pageLatch(prevPage).lock();
+            ((PostingNode *)prevPage)->nextPageNo = nextPageNo;
+            this->releaseNode(prevPageNo, prevPage);
+        }
+        if (nextPageNo != Page::INVALID_NUMBER)
+        {
+            Page *nextPage;
+            this->readNode(nextPageNo, nextPage);
+            bufMgr->pageLatch(nextPage).lock();
+            ((PostingNode *)nextPage)->prevPageNo = prevPageNo;
+            this->releaseNode(nextPageNo, nextPage);
+        }
+        if (pageNo == headPageNo)
+        {
+            newHeadPageNo = nextPageNo;
+        }
+        if (pageNo == lastPageNo)
+        {
+            lastPageNo = prevPageNo;
+        }
+        this->freeNode(pageNo, page);
+    }
+
+    // the first page, which may be a new one, keeps the total and the last page
+    if (newHeadPageNo != Page::INVALID_NUMBER)
+    {
+        Page *headPage;
+        this->readNode(newHeadPageNo, headPage);
+        bufMgr->pageLatch(headPage).lock();
+        ((PostingNode *)headPage)->total = total - 1;
+        ((PostingNode *)headPage)->lastPageNo = lastPageNo;
+        this->releaseNode(newHeadPageNo, headPage);
+    }
+    headPageNo = newHeadPageNo;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::readPostingHead
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::readPostingHead(const PageId pageNo, int &total, RecordId &firstRid, PageId &prevPageNo,
+                                     PageId &lastPageNo)
+{
+    Page *page;
+    this->readNode(pageNo, page);
+    VersionLatch &latch = bufMgr->pageLatch(page);
+    PostingNode *node = (PostingNode *)page;
+    while (true)
+    {
+        std::uint64_t version = latch.readLock();
+        total = node->total;
+        firstRid = node->firstRid;
+        prevPageNo = node->prevPageNo;
+        lastPageNo = node->lastPageNo;
+        if (latch.validate(version))
+        {
+            break;
+        }
+    }
+    this->unpinNode(pageNo, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::readPostingList
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::readPostingList(const PageId headPageNo, Page *leafPage, const std::uint64_t leafVersion,
+                               std::vector<RecordId> &rids)
+{
+    // a delete may free a page of the list, and only changes it with the leaf's latch: every page is checked
+    // against the leaf before its link is followed
+    VersionLatch &leafLatch = bufMgr->pageLatch(leafPage);
+    PageId pageNo = headPageNo;
+    while (pageNo != Page::INVALID_NUMBER)
+    {
+        Page *page;
+        this->readNode(pageNo, page);
+        VersionLatch &latch = bufMgr->pageLatch(page);
+        PostingNode *node = (PostingNode *)page;
+        size_t size = rids.size();
+        PageId nextPageNo;
+        while (true)
+        {
+            std::uint64_t version = latch.readLock();
+            rids.resize(size);
+            decodePosting(node, rids);
+            nextPageNo = node->nextPageNo;
+            if (latch.validate(version))
+            {
+                break;
+            }
+        }
+        this->unpinNode(pageNo, false);
+        if (!leafLatch.validate(leafVersion))
+        {
+            return false;
+        }
+
+        // the next page of a long list is on its way while this one is decoded
+        if (nextPageNo != Page::INVALID_NUMBER)
+        {
+            bufMgr->prefetchPage(file, nextPageNo);
+        }
+        pageNo = nextPageNo;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::leafEntries
+// -----------------------------------------------------------------------------
+
+template <class K>
+int BTree<K>::leafEntries(const LeafNode<K> *leaf, const int begin, const int end)
+{
+    const RecordId *rids = LeafView<K>((LeafNode<K> *)leaf).rids();
+    int entries = 0;
+    for (int i = begin; i < end; i++)
+    {
+        if (isPosting(rids[i]))
+        {
+            int total;
+            RecordId firstRid;
+            PageId prevPageNo;
+            PageId lastPageNo;
+            this->readPostingHead(rids[i].page_number, total, firstRid, prevPageNo, lastPageNo);
+            entries += total;
+        }
+        else
+        {
+            entries++;
+        }
+    }
+    return entries;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::lockNode
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::lockNode(const K key, const int level, PageId &pageNo, Page *&page)
+{
+    while (true)
+    {
+        pageNo = rootPageNum;
+        this->readNode(pageNo, page);
+        std::uint64_t version = bufMgr->pageLatch(page).readLock();
+        bool valid = rootPageNum == pageNo;
+
+        while (valid)
+        {
+            NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+            VersionLatch &latch = bufMgr->pageLatch(page);
+
+            // only the root can be below the level, and it has to still be the root once latched
+            if (node->level < level)
+            {
+                if (latch.tryUpgrade(version))
+                {
+                    if (rootPageNum == pageNo)
+                    {
+                        return;
+                    }
+                    latch.unlock();
+                }
+                break;
+            }
+
+            if (!this->moveRight(key, false, true, pageNo, page, version))
+            {
+                break;
+            }
+            node = (NonLeafNode<K> *)page;
+            if (node->level == level)
+            {
+                if (bufMgr->pageLatch(page).tryUpgrade(version))
+                {
+                    return;
+                }
+                break;
+            }
+
+            // equal keys may span several children, and the node wanted may be under any of them
+            int index = NonLeafView<K>(node).lowerBound(key);
+            PageId childPageNo = node->pageNoArray[index];
+            VersionLatch &nodeLatch = bufMgr->pageLatch(page);
+            if (!nodeLatch.validate(version))
+            {
+                break;
+            }
+            Page *child;
+            this->readNode(childPageNo, child);
+            std::uint64_t childVersion = bufMgr->pageLatch(child).readLock();
+            valid = nodeLatch.validate(version);
+            this->unpinNode(pageNo, false);
+            pageNo = childPageNo;
+            page = child;
+            version = childVersion;
+        }
+
+        // another thread changed a node on the way down or holds the node: start over from the root
+        this->unpinNode(pageNo, false);
+        std::this_thread::yield();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::postSeparators
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::postSeparators(std::vector<PathNode<K> > &path, PageId splitPageNo,
+                                    std::vector<PageKeyPair<K> > &separators)
+{
+    // the level receiving the separators, and whether the node split below it was reached through the path,
+    // so that the path node above it still holds its key range if nothing changed it since
+    int level = 1;
+    bool onPath = true;
+
+    while (!separators.empty())
+    {
+        bool childIsLeaf = level == 1;
+        PageId pageNo;
+        Page *page;
+        int splitIndex = -1;
+        int depth = (int)path.size() - level;
+        bool fromPath = onPath && depth >= 0 && bufMgr->pageLatch(path[depth].page).tryUpgrade(path[depth].version);
+        if (fromPath)
+        {
+            pageNo = path[depth].pageNo;
+            page = path[depth].page;
+            path[depth].locked = true;
+            splitIndex = childIndex((NonLeafNode<K> *)page, splitPageNo);
+            if (splitIndex < 0)
+            {
+                path[depth].version = bufMgr->pageLatch(page).unlock();
+                path[depth].locked = false;
+                fromPath = false;
+            }
+            else
+            {
+                path[depth].dirty = true;
+            }
+        }
+        while (splitIndex < 0)
+        {
+            onPath = false;
+            this->lockNode(separators[0].key, level, pageNo, page);
+
+            if (((NonLeafNode<K> *)page)->level < level)
+            {
+                // the root split: grow the tree by one level. The new root starts out with the old root
+                // as its only child, counting every entry, and receives the separators below. It is latched
+                // before it is published, so that no reader sees it half written.
+                PageId rootNo;
+                Page *rootPage;
+                this->allocNode(rootNo, rootPage, true);
+                bufMgr->pageLatch(rootPage).lock();
+
+                NonLeafNode<K> *newRoot = (NonLeafNode<K> *)rootPage;
+                newRoot->level = level;
+                newRoot->highKey = KeyTraits<K>::max();
+                newRoot->rightSibPageNo = Page::INVALID_NUMBER;
+                int rootCount = this->chainCount(pageNo, Page::INVALID_NUMBER, false);
+                fillNonLeaf(newRoot, &separators[0].key, &pageNo, &rootCount, 1);
+
+                {
+                    std::lock_guard<std::mutex> guard(metaMutex);
+                    rootPageNum = rootNo;
+                    this->updateMetaPage();
+                }
+                bufMgr->pageLatch(page).unlock();
+                this->unpinNode(pageNo, false);
+                pageNo = rootNo;
+                page = rootPage;
+                splitIndex = 0;
+                break;
+            }
+
+            // equal keys may span several nodes: the one holding the split node may be further right
+            splitIndex = childIndex((NonLeafNode<K> *)page, splitPageNo);
+            while (splitIndex < 0 && ((NonLeafNode<K> *)page)->rightSibPageNo != Page::INVALID_NUMBER)
+            {
+                PageId rightPageNo = ((NonLeafNode<K> *)page)->rightSibPageNo;
+                bufMgr->pageLatch(page).unlock();
+                this->unpinNode(pageNo, false);
+                pageNo = rightPageNo;
+                this->readNode(pageNo, page);
+                bufMgr->pageLatch(page).lock();
+                splitIndex = childIndex((NonLeafNode<K> *)page, splitPageNo);
+            }
+            if (splitIndex < 0)
+            {
+                // the split leaf was itself split off a leaf whose separator is not posted yet:
+                // let the insert that split that one post it first
+                bufMgr->pageLatch(page).unlock();
+                this->unpinNode(pageNo, false);
+                countLatch.unlock();
+                std::this_thread::yield();
+                countLatch.lock();
+                structureEpoch++;
+            }
+        }
+
+        NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+        NonLeafView<K> view(node);
+        int size = view.size();
+        std::vector<K> nodeKeys(size);
+        view.keys(0, size, nodeKeys.data());
+        int added = (int)separators.size();
+        size_t total = size + added;
+
+        // the new nodes go in after the split node and after the nodes split off it later and posted before them,
+        // which are between the two on the level below
+        int at = splitIndex + 1;
+        PageId linkPageNo = this->rightLink(splitPageNo, childIsLeaf);
+        while (linkPageNo != separators[0].pageNo && linkPageNo != Page::INVALID_NUMBER)
+        {
+            if (at <= size && node->pageNoArray[at] == linkPageNo)
+            {
+                at++;
+            }
+            linkPageNo = this->rightLink(linkPageNo, childIsLeaf);
+        }
+
+        // the children with the new ones among them; each key separates the children on its either side
+        std::vector<K> keys(nodeKeys.begin(), nodeKeys.begin() + at - 1);
+        std::vector<PageId> children(node->pageNoArray, node->pageNoArray + at);
+        std::vector<int> counts(node->countArray, node->countArray + at);
+        for (int j = 0; j < added; j++)
+        {
+            keys.push_back(separators[j].key);
+            children.push_back(separators[j].pageNo);
+            counts.push_back(0);
+        }
+        keys.insert(keys.end(), nodeKeys.begin() + at - 1, nodeKeys.end());
+        children.insert(children.end(), node->pageNoArray + at, node->pageNoArray + size + 1);
+        counts.insert(counts.end(), node->countArray + at, node->countArray + size + 1);
+
+        // the entries of every new node, and of the nodes split off it since, were counted for the child
+        // on its left until now
+        PageId edgePageNo = Page::INVALID_NUMBER;
+        if (at + added > size && node->rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            Page *rightPage;
+            this->readNode(node->rightSibPageNo, rightPage);
+            edgePageNo = ((NonLeafNode<K> *)rightPage)->pageNoArray[0];
+            this->unpinNode(node->rightSibPageNo, false);
+        }
+        for (int j = at; j < at + added; j++)
+        {
+            PageId stopPageNo = (j < (int)total) ? children[j + 1] : edgePageNo;
+            counts[j] = this->chainCount(children[j], stopPageNo, childIsLeaf);
+            counts[at - 1] -= counts[j];
+        }
+
+        if (NonLeafView<K>::fits(&keys[0], (int)total))
+        {
+            fillNonLeaf(node, &keys[0], &children[0], &counts[0], (int)total + 1);
+            separators.clear();
+        }
+        else
+        {
+            // the node overflows: spread the children over the node and new nodes linked in on its right.
+            // The key between two neighbouring nodes is the high key of the left one and moves up to the parent.
+            bool append = at > size && node->rightSibPageNo == Page::INVALID_NUMBER;
+            std::vector<size_t> ends = nonLeafParts(&keys[0], total, append);
+            int nodes = (int)ends.size();
+            std::vector<PageId> pageNos(nodes);
+            std::vector<Page *> pages(nodes);
+            pageNos[0] = pageNo;
+            pages[0] = page;
+            for (int n = 1; n < nodes; n++)
+            {
+                this->allocNode(pageNos[n], pages[n], true);
+            }
+
+            std::vector<PageKeyPair<K> > parentSeparators;
+            K highKey = node->highKey;
+            PageId rightSibPageNo = node->rightSibPageNo;
+            size_t begin = 0;
+            for (int n = 0; n < nodes; n++)
+            {
+                size_t end = ends[n];
+                NonLeafNode<K> *part = (NonLeafNode<K> *)pages[n];
+
+                // children begin..end-1 are separated by keys begin..end-2
+                fillNonLeaf(part, &keys[begin], &children[begin], &counts[begin], (int)(end - begin));
+                part->level = node->level;
+                part->highKey = (n + 1 < nodes) ? keys[end - 1] : highKey;
+                part->rightSibPageNo = (n + 1 < nodes) ? pageNos[n + 1] : rightSibPageNo;
+
+                if (n > 0)
+                {
+                    PageKeyPair<K> separator;
+                    separator.set(pageNos[n], keys[begin - 1]);
+                    parentSeparators.push_back(separator);
+                    this->unpinNode(pageNos[n], true);
+                }
+                begin = end;
+            }
+
+            separators.swap(parentSeparators);
+            splitPageNo = pageNo;
+        }
+
+        // the node is released before its own separators are posted a level up
+        if (fromPath)
+        {
+            path[depth].version = bufMgr->pageLatch(page).unlock();
+            path[depth].locked = false;
+        }
+        else
+        {
+            this->releaseNode(pageNo, page);
+        }
+        level++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::rightLink
+// -----------------------------------------------------------------------------
+
+template <class K>
+PageId BTree<K>::rightLink(const PageId pageNo, const bool leaf)
+{
+    Page *page;
+    this->readNode(pageNo, page);
+    PageId rightPageNo = leaf ? ((LeafNode<K> *)page)->rightSibPageNo : ((NonLeafNode<K> *)page)->rightSibPageNo;
+    this->unpinNode(pageNo, false);
+    return rightPageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::chainCount
+// -----------------------------------------------------------------------------
+
+template <class K>
+int BTree<K>::chainCount(const PageId pageNo, const PageId stopPageNo, const bool leaf)
+{
+    int count = 0;
+    PageId next = pageNo;
+    while (next != stopPageNo && next != Page::INVALID_NUMBER)
+    {
+        Page *page;
+        PageId current = next;
+        this->readNode(current, page);
+        count += subtreeCount<K>(page, leaf);
+        next = leaf ? ((LeafNode<K> *)page)->rightSibPageNo : ((NonLeafNode<K> *)page)->rightSibPageNo;
+        this->unpinNode(current, false);
+    }
+    return count;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::releasePath
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::releasePath(std::vector<PathNode<K> > &path)
+{
+    this->unlockPath(path);
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        this->unpinNode(path[i].pageNo, path[i].dirty);
+    }
+    path.clear();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::unlockPath
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::unlockPath(std::vector<PathNode<K> > &path)
+{
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        if (path[i].locked)
+        {
+            path[i].version = bufMgr->pageLatch(path[i].page).unlock();
+            path[i].locked = false;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::releaseNode
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::releaseNode(const PageId pageNo, Page *page, const bool dirty)
+{
+    bufMgr->pageLatch(page).unlock();
+    this->unpinNode(pageNo, dirty);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::deleteEntry
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::deleteEntry(const void *key, const RecordId rid)
+{
+    K keyVal = KeyTraits<K>::fromValue(key);
+    if (KeyTraits<K>::unindexable(keyVal))
+    {
+        // the key that pads the nodes, or NaN, which no entry has
+        return false;
+    }
+
+    std::vector<PathNode<K> > path;
+    PageId leafPageNo;
+    Page *leafPage;
+    std::uint64_t leafVersion;
+    int pos;
+    int listSize;
+
+    // most deletes leave the leaf at or above the minimum and change nothing but the leaf,
+    // which is then the only node latched. One that rebalances moves entries between the key ranges
+    // of the children of a node, and keeps every other writer out while it does.
+    bool exclusive = false;
+    while (true)
+    {
+        countLatch.lockShared();
+        if (!this->findEntry(keyVal, rid, false, path, leafPageNo, leafPage, leafVersion, pos, listSize))
+        {
+            countLatch.unlockShared();
+            continue;
+        }
+        if (pos < 0)
+        {
+            this->unpinNode(leafPageNo, false);
+            this->releasePath(path);
+            countLatch.unlockShared();
+            return false;
+        }
+
+        // a posting list that keeps an entry keeps its slot
+        bool underflow = LeafView<K>(leafPage).size() <= LeafNode<K>::MIN && listSize <= 1;
+        if (!underflow && bufMgr->pageLatch(leafPage).tryUpgrade(leafVersion))
+        {
+            break;
+        }
+
+        this->unpinNode(leafPageNo, false);
+        this->releasePath(path);
+        countLatch.unlockShared();
+        if (underflow)
+        {
+            // the leaf has to be rebalanced: search again with the whole path latched
+            countLatch.lock();
+            structureEpoch++;
+            if (!this->findEntry(keyVal, rid, true, path, leafPageNo, leafPage, leafVersion, pos, listSize))
+            {
+                // a leaf on the way waits for its separator, which cannot be posted until the latch is released
+                countLatch.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            if (pos < 0)
+            {
+                bufMgr->pageLatch(leafPage).unlock();
+                this->unpinNode(leafPageNo, false);
+                this->releasePath(path);
+                countLatch.unlock();
+                return false;
+            }
+            exclusive = true;
+            break;
+        }
+    }
+    LeafNode<K> *leaf = (LeafNode<K> *)leafPage;
+    LeafView<K> view(leaf);
+
+    bool removeSlot = true;
+    if (isPosting(view.rids()[pos]))
+    {
+        PageId headPageNo = view.rids()[pos].page_number;
+        if (!this->removeFromPosting(headPageNo, rid))
+        {
+            this->releaseNode(leafPageNo, leafPage, false);
+            this->releasePath(path);
+            if (exclusive)
+            {
+                countLatch.unlock();
+            }
+            else
+            {
+                countLatch.unlockShared();
+            }
+            return false;
+        }
+        if (headPageNo != Page::INVALID_NUMBER)
+        {
+            // the list may have lost its first page
+            view.rids()[pos].page_number = headPageNo;
+            leaf->postingEntries--;
+            removeSlot = false;
+        }
+    }
+    if (removeSlot)
+    {
+        // shift the later part of the arrays over the entry
+        view.remove(pos);
+    }
+    this->addToCounts(path, -1);
+    __atomic_fetch_add(&writeStats.deletes, 1LL, __ATOMIC_RELAXED);
+
+    if (!removeSlot || view.size() >= LeafNode<K>::MIN)
+    {
+        this->releaseNode(leafPageNo, leafPage);
+        this->releasePath(path);
+    }
+    else
+    {
+        this->rebalanceLeaf(path, leafPageNo, leafPage);
+        this->rebalancePath(path);
+    }
+
+    if (exclusive)
+    {
+        countLatch.unlock();
+    }
+    else
+    {
+        countLatch.unlockShared();
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::findEntry
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::findEntry(const K key, const RecordId rid, const bool exclusive, std::vector<PathNode<K> > &path,
+                         PageId &leafPageNo, Page *&leafPage, std::uint64_t &leafVersion, int &pos, int &listSize)
+{
+    if (exclusive)
+    {
+        if (!this->lockPath(key, path, leafPageNo, leafPage))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        K leafHighKey;
+        if (!this->descendPath(key, path, leafPageNo, leafHighKey, leafPage, leafVersion))
+        {
+            this->releasePath(path);
+            return false;
+        }
+    }
+    LeafView<K> view(leafPage);
+    const RecordId *rids = view.rids();
+    VersionLatch &latch = bufMgr->pageLatch(leafPage);
+
+    // equal keys never span two leaves, so the entry is on this one if anywhere
+    pos = -1;
+    listSize = 1;
+    for (int i = view.lowerBound(key), size = view.size(); i < size && view.key(i) == key; i++)
+    {
+        if (isPosting(rids[i]) || rids[i] == rid)
+        {
+            pos = i;
+            break;
+        }
+    }
+    PageId headPageNo = (pos >= 0 && isPosting(rids[pos])) ? rids[pos].page_number : Page::INVALID_NUMBER;
+
+    if (!exclusive && !latch.validate(leafVersion))
+    {
+        this->unpinNode(leafPageNo, false);
+        this->releasePath(path);
+        return false;
+    }
+    if (headPageNo != Page::INVALID_NUMBER)
+    {
+        int total;
+        RecordId firstRid;
+        PageId prevPageNo;
+        PageId lastPageNo;
+        this->readPostingHead(headPageNo, total, firstRid, prevPageNo, lastPageNo);
+        listSize = total;
+        if (!exclusive && !latch.validate(leafVersion))
+        {
+            this->unpinNode(leafPageNo, false);
+            this->releasePath(path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::rebalanceLeaf
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::rebalanceLeaf(std::vector<PathNode<K> > &path, const PageId leafPageNo, Page *leafPage)
+{
+    PathNode<K> &parentInfo = path.back();
+    NonLeafNode<K> *parent = (NonLeafNode<K> *)parentInfo.page;
+
+    // the only leaf of the tree has no sibling to rebalance with
+    if (NonLeafView<K>(parent).size() == 0)
+    {
+        this->releaseNode(leafPageNo, leafPage);
+        return;
+    }
+
+    // pair the leaf with its left sibling, or with its right one if it is the first child
+    int rightIndex = (parentInfo.index > 0) ? parentInfo.index : 1;
+    PageId leftPageNo = parent->pageNoArray[rightIndex - 1];
+    PageId rightPageNo = parent->pageNoArray[rightIndex];
+    Page *leftPage = leafPage;
+    Page *rightPage = leafPage;
+    if (parentInfo.index > 0)
+    {
+        this->readNode(leftPageNo, leftPage);
+        bufMgr->pageLatch(leftPage).lock();
+    }
+    else
+    {
+        this->readNode(rightPageNo, rightPage);
+        bufMgr->pageLatch(rightPage).lock();
+    }
+    LeafNode<K> *left = (LeafNode<K> *)leftPage;
+    LeafNode<K> *right = (LeafNode<K> *)rightPage;
+
+    // a leaf split off the left one and still waiting for its separator sits between them
+    if (left->rightSibPageNo != rightPageNo)
+    {
+        bufMgr->pageLatch(leftPage).unlock();
+        bufMgr->pageLatch(rightPage).unlock();
+        this->unpinNode(leftPageNo, leftPage == leafPage);
+        this->unpinNode(rightPageNo, rightPage == leafPage);
+        return;
+    }
+
+    // the entries of both leaves, in order
+    LeafView<K> leftView(left);
+    LeafView<K> rightView(right);
+    int leftSize = leftView.size();
+    int rightSize = rightView.size();
+    int total = leftSize + rightSize;
+    int siblingSize = (parentInfo.index > 0) ? leftSize : rightSize;
+    std::vector<K> keys(total);
+    std::vector<RecordId> rids(total);
+    leftView.keys(0, leftSize, keys.data());
+    rightView.keys(0, rightSize, keys.data() + leftSize);
+    memcpy(rids.data(), leftView.rids(), leftSize * sizeof(RecordId));
+    memcpy(rids.data() + leftSize, rightView.rids(), rightSize * sizeof(RecordId));
+
+    // a merge frees the right leaf, which a leaf split off it and still waiting for its separator needs to find in the parent
+    if (siblingSize <= LeafNode<K>::MIN && right->rightSibPageNo != this->nextChild(parent, rightIndex))
+    {
+        this->releaseNode(leftPageNo, leftPage, leftPage == leafPage);
+        this->releaseNode(rightPageNo, rightPage, rightPage == leafPage);
+        return;
+    }
+
+    if (siblingSize <= LeafNode<K>::MIN)
+    {
+        // the sibling cannot spare an entry: merge the right leaf into the left one, which even a plain leaf holds
+        parentInfo.dirty = true;
+        fillLeaf(left, keys.data(), rids.data(), total, left->postingEntries + right->postingEntries,
+                 compressLeaves);
+        left->rightSibPageNo = right->rightSibPageNo;
+        left->highKey = right->highKey;
+        if (left->rightSibPageNo != Page::INVALID_NUMBER)
+        {
+            Page *rightSibPage;
+            this->readNode(left->rightSibPageNo, rightSibPage);
+            bufMgr->pageLatch(rightSibPage).lock();
+            ((LeafNode<K> *)rightSibPage)->leftSibPageNo = leftPageNo;
+            this->releaseNode(left->rightSibPageNo, rightSibPage);
+        }
+
+        this->releaseNode(leftPageNo, leftPage);
+        this->freeNode(rightPageNo, rightPage);
+        parent->countArray[rightIndex - 1] += parent->countArray[rightIndex];
+        removeChild(parent, rightIndex);
+        return;
+    }
+
+    // share the entries as evenly between the two leaves as the keys allow: the leaves meet between two keys,
+    // where what goes to each of them fits it. Packed leaves may have no such place, and are then left as they are.
+    // The parent takes the separator between them in place of the old one only if its keys still fit.
+    int newLeftSize = evenSplit(keys.data(), total, compressLeaves);
+    K separator = (newLeftSize < 0) ? K() : KeyTraits<K>::separator(keys[newLeftSize - 1], keys[newLeftSize]);
+    if (newLeftSize < 0 || !NonLeafView<K>(parent).holds(rightIndex - 1, separator))
+    {
+        this->releaseNode(leftPageNo, leftPage, leftPage == leafPage);
+        this->releaseNode(rightPageNo, rightPage, rightPage == leafPage);
+        return;
+    }
+
+    // entries moving from the left leaf to the right one, negative if they move the other way
+    int movedEntries = (newLeftSize < leftSize) ? this->leafEntries(left, newLeftSize, leftSize)
+                                                : -this->leafEntries(right, 0, newLeftSize - leftSize);
+    int leftEntries = leftSize + left->postingEntries - movedEntries;
+    int rightEntries = rightSize + right->postingEntries + movedEntries;
+    parentInfo.dirty = true;
+    fillLeaf(left, keys.data(), rids.data(), newLeftSize, leftEntries - newLeftSize, compressLeaves);
+    fillLeaf(right, keys.data() + newLeftSize, rids.data() + newLeftSize, total - newLeftSize,
+             rightEntries - (total - newLeftSize), compressLeaves);
+    parent->countArray[rightIndex - 1] -= movedEntries;
+    parent->countArray[rightIndex] += movedEntries;
+    NonLeafView<K>(parent).set(rightIndex - 1, separator);
+    left->highKey = separator;
+
+    this->releaseNode(leftPageNo, leftPage);
+    this->releaseNode(rightPageNo, rightPage);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::rebalancePath
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::rebalancePath(std::vector<PathNode<K> > &path)
+{
+    // every node below the root that lost a child and is left under the minimum is rebalanced
+    // with a sibling, which may in turn take a child from its parent
+    while (path.size() > 1)
+    {
+        NonLeafNode<K> *node = (NonLeafNode<K> *)path.back().page;
+        if (NonLeafView<K>(node).size() >= NonLeafNode<K>::MIN)
+        {
+            break;
+        }
+
+        PathNode<K> &parentInfo = path[path.size() - 2];
+        NonLeafNode<K> *parent = (NonLeafNode<K> *)parentInfo.page;
+
+        // pair the node with its left sibling, or with its right one if it is the first child
+        int rightIndex = (parentInfo.index > 0) ? parentInfo.index : 1;
+        PageId leftPageNo = parent->pageNoArray[rightIndex - 1];
+        PageId rightPageNo = parent->pageNoArray[rightIndex];
+        Page *leftPage = path.back().page;
+        Page *rightPage = path.back().page;
+        if (parentInfo.index > 0)
+        {
+            this->readNode(leftPageNo, leftPage);
+            bufMgr->pageLatch(leftPage).lock();
+        }
+        else
+        {
+            this->readNode(rightPageNo, rightPage);
+            bufMgr->pageLatch(rightPage).lock();
+        }
+        NonLeafNode<K> *left = (NonLeafNode<K> *)leftPage;
+        NonLeafNode<K> *right = (NonLeafNode<K> *)rightPage;
+
+        // a node split off the left one and still waiting for its separator sits between them:
+        // leave both as they are, and the nodes above too
+        if (left->rightSibPageNo != rightPageNo)
+        {
+            Page *siblingPage = (parentInfo.index > 0) ? leftPage : rightPage;
+            PageId siblingPageNo = (parentInfo.index > 0) ? leftPageNo : rightPageNo;
+            bufMgr->pageLatch(siblingPage).unlock();
+            this->unpinNode(siblingPageNo, false);
+            break;
+        }
+
+        // the keys and children of both nodes, with the separator in the parent pulled down between them
+        NonLeafView<K> leftView(left);
+        NonLeafView<K> rightView(right);
+        int leftSize = leftView.size();
+        int rightSize = rightView.size();
+        int siblingSize = (parentInfo.index > 0) ? leftSize : rightSize;
+        std::vector<K> keys(leftSize + 1 + rightSize);
+        leftView.keys(0, leftSize, keys.data());
+        keys[leftSize] = NonLeafView<K>(parent).key(rightIndex - 1);
+        rightView.keys(0, rightSize, keys.data() + leftSize + 1);
+        std::vector<PageId> children(left->pageNoArray, left->pageNoArray + leftSize + 1);
+        children.insert(children.end(), right->pageNoArray, right->pageNoArray + rightSize + 1);
+        std::vector<int> counts(left->countArray, left->countArray + leftSize + 1);
+        counts.insert(counts.end(), right->countArray, right->countArray + rightSize + 1);
+        int leftChildren = (int)children.size() / 2;
+        int rightChildren = (int)children.size() - leftChildren;
+
+        // keys that only fit the nodes merged cannot be shared between them either, and a right node with a node
+        // split off it still waiting for its separator cannot be merged away: leave both as they are, and the nodes above too
+        if ((siblingSize > NonLeafNode<K>::MIN &&
+             !(NonLeafView<K>::fits(&keys[0], leftChildren - 1) &&
+               NonLeafView<K>::fits(&keys[leftChildren], rightChildren - 1) &&
+               NonLeafView<K>(parent).holds(rightIndex - 1, keys[leftChildren - 1]))) ||
+            (siblingSize <= NonLeafNode<K>::MIN && right->rightSibPageNo != this->nextChild(parent, rightIndex)))
+        {
+            Page *siblingPage = (parentInfo.index > 0) ? leftPage : rightPage;
+            PageId siblingPageNo = (parentInfo.index > 0) ? leftPageNo : rightPageNo;
+            bufMgr->pageLatch(siblingPage).unlock();
+            this->unpinNode(siblingPageNo, false);
+            break;
+        }
+
+        parentInfo.dirty = true;
+
+        if (siblingSize <= NonLeafNode<K>::MIN)
+        {
+            // the sibling cannot spare a child: merge the right node into the left one, which holds the keys of
+            // both whatever they are, as they are fewer than twice NonLeafNode<K>::MIN
+            fillNonLeaf(left, &keys[0], &children[0], &counts[0], (int)children.size());
+            left->highKey = right->highKey;
+            left->rightSibPageNo = right->rightSibPageNo;
+
+            this->releaseNode(leftPageNo, leftPage);
+            this->freeNode(rightPageNo, rightPage);
+            parent->countArray[rightIndex - 1] += parent->countArray[rightIndex];
+            removeChild(parent, rightIndex);
+        }
+        else
+        {
+            // share the children evenly, rotating them through the separator in the parent
+            fillNonLeaf(left, &keys[0], &children[0], &counts[0], leftChildren);
+            fillNonLeaf(right, &keys[leftChildren], &children[leftChildren], &counts[leftChildren], rightChildren);
+            NonLeafView<K>(parent).set(rightIndex - 1, keys[leftChildren - 1]);
+            parent->countArray[rightIndex - 1] = subtreeCount<K>(leftPage, false);
+            parent->countArray[rightIndex] = subtreeCount<K>(rightPage, false);
+            left->highKey = keys[leftChildren - 1];
+
+            this->releaseNode(leftPageNo, leftPage);
+            this->releaseNode(rightPageNo, rightPage);
+        }
+
+        // the node was released or freed above
+        path.pop_back();
+    }
+
+    // a root left with a single child is replaced by it, unless that child is a leaf:
+    // the root is always a non-leaf node. A root that split and waits for the root above it stays.
+    if (path.size() == 1)
+    {
+        NonLeafNode<K> *root = (NonLeafNode<K> *)path[0].page;
+        if (NonLeafView<K>(root).size() == 0 && root->level > 1 && root->rightSibPageNo == Page::INVALID_NUMBER)
+        {
+            {
+                std::lock_guard<std::mutex> guard(metaMutex);
+                rootPageNum = root->pageNoArray[0];
+                this->updateMetaPage();
+            }
+            this->freeNode(path[0].pageNo, path[0].page);
+            path.clear();
+        }
+    }
+
+    this->releasePath(path);
+}
+
 // -----------------------------------------------------------------------------
-// BTreeIndex::BTreeIndex -- Constructor
+// BTree::nextChild
+// -----------------------------------------------------------------------------
+
+template <class K>
+PageId BTree<K>::nextChild(NonLeafNode<K> *node, const int index)
+{
+    if (index < NonLeafView<K>(node).size())
+    {
+        return node->pageNoArray[index + 1];
+    }
+    if (node->rightSibPageNo == Page::INVALID_NUMBER)
+    {
+        return Page::INVALID_NUMBER;
+    }
+
+    Page *rightPage;
+    this->readNode(node->rightSibPageNo, rightPage);
+    PageId pageNo = ((NonLeafNode<K> *)rightPage)->pageNoArray[0];
+    this->unpinNode(node->rightSibPageNo, false);
+    return pageNo;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::updateMetaPage
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::updateMetaPage()
+{
+    Page *metadataPage;
+    this->readNode(headerPageNum, metadataPage);
+    IndexMetaInfo *metadata = (IndexMetaInfo *)metadataPage;
+    metadata->rootPageNo = rootPageNum;
+    metadata->freePageNo = freePageNum;
+    this->unpinNode(headerPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::allocNode
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::allocNode(PageId &pageNo, Page *&page, const bool nonLeaf)
+{
+    std::lock_guard<std::mutex> guard(metaMutex);
+    if (freePageNum == Page::INVALID_NUMBER)
+    {
+        bufMgr->allocPage(file, pageNo, page);
+        if (nonLeaf)
+        {
+            this->cacheNode(pageNo, page);
+        }
+        return;
+    }
+
+    // take the most recently freed page off the list
+    pageNo = freePageNum;
+    this->readNode(pageNo, page);
+    freePageNum = ((FreeNode *)page)->nextFreePageNo;
+    this->updateMetaPage();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::cacheNode
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::cacheNode(const PageId pageNo, Page *page)
+{
+    // the pin the node was read with becomes the cache's. The caller's later unpin finds the node cached.
+    // Had the node been pinned twice, its extra pin goes.
+    if (cachedNode(pageNo) != NULL)
+    {
+        bufMgr->unPinPage(file, pageNo, false);
+        return true;
+    }
+
+    // the cached frames are never evicted, so the indexes sharing the buffer pool may only take a share of it
+    int chunkNo = pageNo / NODE_CACHE_CHUNK;
+    if (chunkNo >= NODE_CACHE_CHUNKS || !bufMgr->reserveFrame(NODE_CACHE_POOL_PERCENT))
+    {
+        return false;
+    }
+    std::atomic<Page *> *chunk = nodeCache[chunkNo];
+    if (chunk == NULL)
+    {
+        chunk = new std::atomic<Page *>[NODE_CACHE_CHUNK]();
+        nodeCache[chunkNo].store(chunk, std::memory_order_release);
+    }
+    chunk[pageNo % NODE_CACHE_CHUNK].store(page, std::memory_order_release);
+    cachedNodes++;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::cacheNonLeafLevels
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::cacheNonLeafLevels()
+{
+    // every level is a chain of right links starting under the first child of the level above
+    PageId firstPageNo = rootPageNum;
+    while (true)
+    {
+        PageId pageNo = firstPageNo;
+        int level = 0;
+        while (pageNo != Page::INVALID_NUMBER)
+        {
+            Page *page;
+            bufMgr->readPage(file, pageNo, page);
+            NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+            if (pageNo == firstPageNo)
+            {
+                level = node->level;
+                firstPageNo = node->pageNoArray[0];
+            }
+            PageId rightSibPageNo = node->rightSibPageNo;
+
+            // the lower levels are read through the buffer manager once the cache is full
+            if (!this->cacheNode(pageNo, page))
+            {
+                bufMgr->unPinPage(file, pageNo, false);
+                return;
+            }
+            pageNo = rightSibPageNo;
+        }
+        if (level <= 1)
+        {
+            return;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::freeNode
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::freeNode(const PageId pageNo, Page *page)
+{
+    std::lock_guard<std::mutex> guard(metaMutex);
+    ((FreeNode *)page)->nextFreePageNo = freePageNum;
+    this->releaseNode(pageNo, page);
+    freePageNum = pageNo;
+    this->updateMetaPage();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::startScan
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::startScan(const void *lowValParm,
+                               const Operator lowOpParm,
+                               const void *highValParm,
+                               const Operator highOpParm,
+                               const ScanOrder order,
+                               const int readAhead)
+{
+    // If another scan is already executing, it is ended by startCursor.
+    startCursor(scanCursor, lowValParm, lowOpParm, highValParm, highOpParm, order, readAhead);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::openScan
+// -----------------------------------------------------------------------------
+
+template <class K>
+BTreeScanBase *BTree<K>::openScan(const void *lowValParm,
+                                    const Operator lowOpParm,
+                                    const void *highValParm,
+                                    const Operator highOpParm,
+                                    const ScanOrder order,
+                                    const int readAhead)
+{
+    std::unique_ptr<BTreeScan<K> > cursor(new BTreeScan<K>());
+    startCursor(*cursor, lowValParm, lowOpParm, highValParm, highOpParm, order, readAhead);
+    return cursor.release();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::startCursor
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::startCursor(BTreeScan<K> &cursor,
+                                 const void *lowValParm,
+                                 const Operator lowOpParm,
+                                 const void *highValParm,
+                                 const Operator highOpParm,
+                                 const ScanOrder order,
+                                 const int readAhead)
+{
+    K lowVal = KeyTraits<K>::fromValue(lowValParm);
+    K highVal = KeyTraits<K>::fromValue(highValParm);
+
+    if (lowVal > highVal)
+    {
+        throw BadScanrangeException();
+    }
+
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+    {
+        throw BadOpcodesException();
+    }
+
+    if (cursor.scanExecuting)
+    {
+        // If another scan is already executing, that needs to be ended here.
+        cursor.endScan();
+    }
+    Operator lowOp = lowOpParm;
+    Operator highOp = highOpParm;
+    clampBound(lowVal, lowOp);
+    clampBound(highVal, highOp);
+
+    // a bound its key does not hold whole takes in every entry with the key, and the scan checks them in their
+    // records against the bound itself. Such values are strings.
+    cursor.index = this;
+    cursor.lowVal = lowVal;
+    cursor.highVal = highVal;
+    cursor.checkLow = !KeyTraits<K>::whole(lowValParm);
+    cursor.checkHigh = !KeyTraits<K>::whole(highValParm);
+    cursor.lowFull = cursor.checkLow ? std::string((const char *)lowValParm) : std::string();
+    cursor.highFull = cursor.checkHigh ? std::string((const char *)highValParm) : std::string();
+    cursor.lowFullOp = lowOpParm;
+    cursor.highFullOp = highOpParm;
+    cursor.lowOp = cursor.checkLow ? GTE : lowOp;
+    cursor.highOp = cursor.checkHigh ? LTE : highOp;
+    cursor.order = order;
+    cursor.readAhead = 0;
+    cursor.seek();
+    cursor.scanExecuting = true;
+
+    cursor.readAhead = std::min(std::max(readAhead, 0), readAheadLimit);
+    cursor.leavesSinceRequest = cursor.readAhead;
+    cursor.leavesSinceGrow = 0;
+    cursor.fillReadAhead();
+}
+
+// -----------------------------------------------------------------------------
+// BTree::findLeaf
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::findLeaf(const K key, PageId &leafPageNo, Page *&leafPage, std::uint64_t &leafVersion,
+                              const bool leftmost)
+{
+    while (true)
+    {
+        PageId pageNo = rootPageNum;
+        Page *page;
+        this->readNode(pageNo, page);
+        std::uint64_t version = bufMgr->pageLatch(page).readLock();
+        bool valid = rootPageNum == pageNo;
+
+        while (valid)
+        {
+            // the node may have split since its parent was read
+            if (!this->moveRight(key, false, leftmost, pageNo, page, version))
+            {
+                break;
+            }
+
+            // a separator equal to the key may have entries with the key on its left too
+            NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+            int index = leftmost ? NonLeafView<K>(node).lowerBound(key) : NonLeafView<K>(node).upperBound(key);
+            PageId childPageNo = node->pageNoArray[index];
+            bool childIsLeaf = node->level == 1;
+
+            // only a consistent read of the node may be followed, and the node must still point
+            // at the child once the child's version is known
+            VersionLatch &latch = bufMgr->pageLatch(page);
+            if (!latch.validate(version))
+            {
+                break;
+            }
+            Page *child;
+            this->readNode(childPageNo, child);
+            std::uint64_t childVersion = bufMgr->pageLatch(child).readLock();
+            valid = latch.validate(version);
+            this->unpinNode(pageNo, false);
+
+            pageNo = childPageNo;
+            page = child;
+            version = childVersion;
+            if (valid && childIsLeaf)
+            {
+                if (!this->moveRight(key, true, leftmost, pageNo, page, version))
+                {
+                    break;
+                }
+                leafPageNo = pageNo;
+                leafPage = page;
+                leafVersion = version;
+                return;
+            }
+        }
+
+        // another thread changed a node on the way down: start over from the root
+        this->unpinNode(pageNo, false);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::lookup
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::lookup(const void *key, RecordId &outRid)
+{
+    // a value its key does not hold whole is found among the entries with the key
+    if (!KeyTraits<K>::whole(key))
+    {
+        std::vector<RecordId> rids;
+        if (this->lookupAll(key, rids) == 0)
+        {
+            return false;
+        }
+        outRid = rids[0];
+        return true;
+    }
+
+    // no entry has the key that pads the nodes, or NaN, and the search for the first would run off the right edge
+    // of the tree
+    K keyVal = KeyTraits<K>::fromValue(key);
+    if (KeyTraits<K>::unindexable(keyVal))
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        // the leaf whose key range holds the key holds an entry with the key, if there is one
+        PageId leafPageNo;
+        Page *leafPage;
+        std::uint64_t leafVersion;
+        findLeaf(keyVal, leafPageNo, leafPage, leafVersion);
+        LeafView<K> view(leafPage);
+
+        int i = view.lowerBound(keyVal);
+        bool found = i < view.size() && view.key(i) == keyVal;
+        RecordId rid;
+        if (found)
+        {
+            rid = view.rids()[i];
+        }
+
+        VersionLatch &latch = bufMgr->pageLatch(leafPage);
+        bool valid = latch.validate(leafVersion);
+        if (valid && found && isPosting(rid))
+        {
+            // the first record id of a posting list is kept on its first page
+            int total;
+            PageId prevPageNo;
+            PageId lastPageNo;
+            this->readPostingHead(rid.page_number, total, rid, prevPageNo, lastPageNo);
+            valid = latch.validate(leafVersion);
+        }
+        this->unpinNode(leafPageNo, false);
+        if (valid)
+        {
+            if (found)
+            {
+                outRid = rid;
+            }
+            return found;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::lookupAll
+// -----------------------------------------------------------------------------
+
+template <class K>
+size_t BTree<K>::lookupAll(const void *key, std::vector<RecordId> &outRids)
+{
+    size_t outSize = outRids.size();
+    this->keyRids(KeyTraits<K>::fromValue(key), outRids);
+
+    // the entries with the key of a value it does not hold whole are those of the value only if their records say so
+    if (!KeyTraits<K>::whole(key))
+    {
+        size_t kept = outSize;
+        for (size_t i = outSize; i < outRids.size(); i++)
+        {
+            if (this->recordInRange(outRids[i], key, GTE, key, LTE))
+            {
+                outRids[kept++] = outRids[i];
+            }
+        }
+        outRids.resize(kept);
+    }
+    return outRids.size() - outSize;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::keyRids
+// -----------------------------------------------------------------------------
+
+template <class K>
+size_t BTree<K>::keyRids(const K keyVal, std::vector<RecordId> &outRids)
+{
+    size_t outSize = outRids.size();
+    if (KeyTraits<K>::unindexable(keyVal))
+    {
+        // the key that pads the nodes, or NaN, which no entry has
+        return 0;
+    }
+
+    while (true)
+    {
+        // entries read before a writer got in the way are dropped
+        outRids.resize(outSize);
+
+        // equal keys never span two leaves
+        PageId leafPageNo;
+        Page *leafPage;
+        std::uint64_t leafVersion;
+        findLeaf(keyVal, leafPageNo, leafPage, leafVersion);
+        LeafView<K> view(leafPage);
+        const RecordId *rids = view.rids();
+        VersionLatch &latch = bufMgr->pageLatch(leafPage);
+
+        int i = view.lowerBound(keyVal);
+        int end = view.upperBound(keyVal);
+        PageId headPageNo = (i < end && isPosting(rids[i])) ? rids[i].page_number : Page::INVALID_NUMBER;
+        if (headPageNo == Page::INVALID_NUMBER)
+        {
+            outRids.insert(outRids.end(), rids + i, rids + end);
+        }
+
+        bool valid = latch.validate(leafVersion);
+        if (valid && headPageNo != Page::INVALID_NUMBER)
+        {
+            valid = this->readPostingList(headPageNo, leafPage, leafVersion, outRids);
+        }
+        this->unpinNode(leafPageNo, false);
+        if (valid)
+        {
+            return outRids.size() - outSize;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::lookupMany
+// -----------------------------------------------------------------------------
+
+template <class K>
+size_t BTree<K>::lookupMany(const void *keysParm, const size_t n, RecordId *out, bool *found)
+{
+    // probe keys in ascending order, each with its position in the caller's arrays. Probes of the key that pads
+    // the nodes, or of NaN, find nothing, and are left out of the walk and of the sort.
+    std::vector<std::pair<K, size_t> > probes;
+    probes.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        K key = KeyTraits<K>::fromValue(KeyTraits<K>::value(keysParm, i));
+        found[i] = false;
+        if (!KeyTraits<K>::unindexable(key))
+        {
+            probes.push_back(std::make_pair(key, i));
+        }
+    }
+    std::sort(probes.begin(), probes.end());
+    size_t end = probes.size();
+
+    std::vector<PathNode<K> > path;
+    size_t hits = 0;
+    size_t next = 0;
+    while (next < end)
+    {
+        K key = probes[next].first;
+
+        // climb back up to the lowest node whose key range holds the key, and descend from there
+        while (!path.empty() && key >= path.back().highKey)
+        {
+            this->unpinNode(path.back().pageNo, false);
+            path.pop_back();
+        }
+        PageId leafPageNo;
+        K leafHighKey;
+        Page *leafPage;
+        std::uint64_t leafVersion;
+        if (!this->descendPath(key, path, leafPageNo, leafHighKey, leafPage, leafVersion))
+        {
+            this->releasePath(path);
+            continue;
+        }
+
+        // resolve every probe below the upper bound of the leaf on it
+        LeafView<K> view(leafPage);
+        int leafSize = view.size();
+        size_t leafHits = 0;
+        size_t stop = next;
+        for (; stop < end && probes[stop].first < leafHighKey; stop++)
+        {
+            int i = view.lowerBound(probes[stop].first);
+            size_t pos = probes[stop].second;
+            found[pos] = i < leafSize && view.key(i) == probes[stop].first;
+            if (found[pos])
+            {
+                out[pos] = view.rids()[i];
+                leafHits++;
+            }
+        }
+
+        // the probes of a leaf that changed meanwhile are resolved again, from the root. Those that
+        // found a posting list are given its first record id once the leaf is known to hold it.
+        VersionLatch &latch = bufMgr->pageLatch(leafPage);
+        bool valid = latch.validate(leafVersion);
+        bool posted = false;
+        for (size_t j = next; valid && j < stop; j++)
+        {
+            size_t pos = probes[j].second;
+            if (found[pos] && isPosting(out[pos]))
+            {
+                int total;
+                PageId prevPageNo;
+                PageId lastPageNo;
+                this->readPostingHead(out[pos].page_number, total, out[pos], prevPageNo, lastPageNo);
+                posted = true;
+            }
+        }
+        if (posted)
+        {
+            valid = latch.validate(leafVersion);
+        }
+        this->unpinNode(leafPageNo, false);
+        if (!valid)
+        {
+            this->releasePath(path);
+            continue;
+        }
+        hits += leafHits;
+        next = stop;
+    }
+    this->releasePath(path);
+
+    // a value its key does not hold whole is looked up again among the entries with the key
+    for (size_t i = 0; i < n; i++)
+    {
+        const void *value = KeyTraits<K>::value(keysParm, i);
+        if (found[i] && !KeyTraits<K>::whole(value))
+        {
+            found[i] = this->lookup(value, out[i]);
+            hits -= !found[i];
+        }
+    }
+    return hits;
+}
+
+// -----------------------------------------------------------------------------
+// BTree::clampBound
+// -----------------------------------------------------------------------------
+
+template <class K>
+void BTree<K>::clampBound(K &key, Operator &op)
+{
+    if (KeyTraits<K>::unindexable(key))
+    {
+        // no entry lies between the two keys: a high bound takes in everything up to the greatest key, and a low
+        // bound nothing above it
+        key = KeyTraits<K>::greatest();
+        op = (op == LT || op == LTE) ? LTE : GT;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::countRange
 // -----------------------------------------------------------------------------
 
-BTreeIndex::BTreeIndex(const std::string &relationName,
-                       std::string &outIndexName,
-                       BufMgr *bufMgrIn,
-                       const int attrByteOffset,
-                       const Datatype attrType)
+template <class K>
+size_t BTree<K>::countRange(const void *lowValParm, const Operator lowOpParm, const void *highValParm,
+                            const Operator highOpParm)
 {
-    //set values of the private variables
-    this->bufMgr = bufMgrIn;
-    this->attributeType = attrType;
-    this->attrByteOffset = attrByteOffset;
-    scanExecuting = false;
-
-    std ::ostringstream idxStr;
-    idxStr << relationName << '.' << attrByteOffset;
-    std ::string indexName = idxStr.str(); // indexName is the name of the index file
+    K lowVal = KeyTraits<K>::fromValue(lowValParm);
+    K highVal = KeyTraits<K>::fromValue(highValParm);
 
-    try
+    if (lowVal > highVal)
     {
-        // try to create new file
-        file = new BlobFile(indexName, false);
-        headerPageNum = file->getFirstPageNo();
-        Page *metaPage;
-        bufMgr->readPage(file, headerPageNum, metaPage);
-        IndexMetaInfo *inf = (IndexMetaInfo *)metaPage;
-
-        // std::string str(inf->relationName);
-        // std::cout << (inf->relationName) << std::endl;
+        throw BadScanrangeException();
+    }
 
-        if (strcmp(inf->relationName, relationName.c_str()) != 0 ||
-            (inf->attrByteOffset != attrByteOffset) ||
-            (inf->attrType != attrType))
-        {
-            throw BadIndexInfoException(indexName);
-        }
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+    {
+        throw BadOpcodesException();
+    }
+    Operator lowOp = lowOpParm;
+    Operator highOp = highOpParm;
+    clampBound(lowVal, lowOp);
+    clampBound(highVal, highOp);
 
-        rootPageNum = inf->rootPageNo;
-        bufMgr->unPinPage(file, headerPageNum, false);
+    // the entries below the high bound that are not below the low bound. The two counts are taken one
+    // after the other, so entries inserted or deleted in between may make the difference negative.
+    // The entries with the key of a bound it does not hold whole are left out, and counted from their records.
+    bool checkLow = !KeyTraits<K>::whole(lowValParm);
+    bool checkHigh = !KeyTraits<K>::whole(highValParm);
+    long long high = this->countBelow(highVal, !checkHigh && highOp == LTE);
+    long long low = this->countBelow(lowVal, checkLow || lowOp == GT);
+    size_t count = (high > low) ? (size_t)(high - low) : 0;
+    if (checkLow)
+    {
+        count += this->countTies(lowVal, lowValParm, lowOpParm, highValParm, highOpParm);
     }
-    catch (FileExistsException fileExistsException)
+    if (checkHigh && !(checkLow && highVal == lowVal))
     {
-        file = new BlobFile(indexName, true);
+        count += this->countTies(highVal, lowValParm, lowOpParm, highValParm, highOpParm);
+    }
+    return count;
+}
 
-        //create a new meta page
-        Page *metaPage;
-        bufMgr->allocPage(file, headerPageNum, metaPage);
+// -----------------------------------------------------------------------------
+// BTree::countTies
+// -----------------------------------------------------------------------------
 
-        IndexMetaInfo *inf = (IndexMetaInfo *)metaPage;
+template <class K>
+size_t BTree<K>::countTies(const K key, const void *lowVal, const Operator lowOp, const void *highVal,
+                           const Operator highOp)
+{
+    std::vector<RecordId> rids;
+    this->keyRids(key, rids);
+    size_t count = 0;
+    for (size_t i = 0; i < rids.size(); i++)
+    {
+        count += this->recordInRange(rids[i], lowVal, lowOp, highVal, highOp);
+    }
+    return count;
+}
 
-        //set up other attributes
-        strncpy(inf->relationName, relationName.c_str(), 20);
-        inf->attrByteOffset = attrByteOffset;
-        inf->attrType = attrType;
+// -----------------------------------------------------------------------------
+// BTree::recordInRange
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTree<K>::recordInRange(const RecordId rid, const void *lowVal, const Operator lowOp, const void *highVal,
+                             const Operator highOp)
+{
+    PageFile *relation;
+    {
+        std::lock_guard<std::mutex> guard(relationMutex);
+        if (relationFile == NULL)
+        {
+            relationFile = new PageFile(relationName, false);
+        }
+        relation = relationFile;
+    }
 
-        //create a root page
-        // PageId root_page_id;
-        // blobfile->allocatePage(root_page_id);
-        Page *rootPage;
-        bufMgr->allocPage(file, rootPageNum, rootPage);
+    Page *page;
+    bufMgr->readPage(relation, rid.page_number, page);
+    std::string record = page->getRecord(rid);
+    bufMgr->unPinPage(relation, rid.page_number, false);
 
-        //initialize the rootNode with two child leaves
-        NonLeafNodeInt *rootNode = (NonLeafNodeInt *)rootPage;
-        rootNode->level = 1;
-        for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
+    const char *field = record.c_str() + attrByteOffset;
+    size_t length = record.size() - attrByteOffset;
+    if (lowVal != NULL)
+    {
+        int c = KeyTraits<K>::compare(field, length, lowVal);
+        if ((lowOp == GT) ? c <= 0 : c < 0)
         {
-            rootNode->keyArray[i] = INT32_MAX;
+            return false;
         }
-        for (int i = 0; i < INTARRAYNONLEAFSIZE + 1; i++)
+    }
+    if (highVal != NULL)
+    {
+        int c = KeyTraits<K>::compare(field, length, highVal);
+        if ((highOp == LT) ? c >= 0 : c > 0)
         {
-            rootNode->pageNoArray[i] = NULL;
+            return false;
         }
+    }
+    return true;
+}
 
-        //create an empty left leaf page and right leaf page of the attribute type
-        Page *leftLeafPage, *rightLeafPage;
-        PageId leftLeafPageId, rightLeafPageId;
-
-        bufMgr->allocPage(file, leftLeafPageId, leftLeafPage);
-        bufMgr->allocPage(file, rightLeafPageId, rightLeafPage);
+// -----------------------------------------------------------------------------
+// BTree::recordKey
+// -----------------------------------------------------------------------------
 
-        LeafNodeInt *leftLeafNode = (LeafNodeInt *)leftLeafPage;
-        LeafNodeInt *rightLeafNode = (LeafNodeInt *)rightLeafPage;
+template <class K>
+K BTree<K>::recordKey(const char *record, const size_t size) const
+{
+    return KeyTraits<K>::fromRecord(record + attrByteOffset, size - attrByteOffset);
+}
 
-        //initialize the leaf page
-        for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
-        {
-            leftLeafNode->keyArray[i] = INT32_MAX;
-            rightLeafNode->keyArray[i] = INT32_MAX;
-        }
+// The values of a COMPOSITE key are those of the attributes, wherever they are in the record.
+template <>
+CompositeKey BTree<CompositeKey>::recordKey(const char *record, const size_t size) const
+{
+    const void *values[MAX_KEY_ATTRIBUTES];
+    for (size_t i = 0; i < attributes.size(); i++)
+    {
+        values[i] = record + attributes[i].offset;
+    }
+    return CompositeKey::of(attributes, values, attributes.size());
+}
 
-        leftLeafNode->rightSibPageNo = rightLeafPageId;
-        rightLeafNode->rightSibPageNo = NULL;
+// -----------------------------------------------------------------------------
+// BTree::countBelow
+// -----------------------------------------------------------------------------
 
-        rootNode->pageNoArray[0] = leftLeafPageId;
-        rootNode->pageNoArray[1] = rightLeafPageId;
+template <class K>
+long long BTree<K>::countBelow(const K key, const bool inclusive)
+{
+    while (true)
+    {
+        PageId pageNo = rootPageNum;
+        Page *page;
+        this->readNode(pageNo, page);
+        std::uint64_t version = bufMgr->pageLatch(page).readLock();
+        bool valid = rootPageNum == pageNo;
+        bool leaf = false;
+        long long below = 0;
 
-        //unpin the new leaf page. its dirty
-        bufMgr->unPinPage(file, leftLeafPageId, true);
-        bufMgr->unPinPage(file, rightLeafPageId, true);
-        bufMgr->unPinPage(file, rootPageNum, true);
+        while (valid)
+        {
+            // a node entirely below the bound is counted whole, and the count goes on with its right neighbour;
+            // a node split after its parent was read is counted this way too
+            K highKey = leaf ? ((LeafNode<K> *)page)->highKey : ((NonLeafNode<K> *)page)->highKey;
+            PageId rightPageNo = leaf ? ((LeafNode<K> *)page)->rightSibPageNo : ((NonLeafNode<K> *)page)->rightSibPageNo;
+            bool right = rightPageNo != Page::INVALID_NUMBER && (inclusive ? key >= highKey : key > highKey);
 
-        // page number of root page
-        // rootPageNum = root_page_id; // assign root page id
-        inf->rootPageNo = rootPageNum;
-        bufMgr->unPinPage(file, headerPageNum, true);
+            PageId nextPageNo;
+            int count;
+            bool nextIsLeaf = leaf;
+            if (right)
+            {
+                count = subtreeCount<K>(page, leaf);
+                nextPageNo = rightPageNo;
+            }
+            else if (leaf)
+            {
+                LeafNode<K> *node = (LeafNode<K> *)page;
+                LeafView<K> view(node);
+                int index = inclusive ? view.upperBound(key) : view.lowerBound(key);
+                count = std::min(index, subtreeCount<K>(page, true));
 
-        // insert entries for every tuple in the base relation
-        FileScan fscan(relationName, bufMgrIn);
+                // a posting list below the bound counts all its entries. The lists on the smaller side
+                // of it are read, those above being taken off the leaf's total when there are fewer of them.
+                std::vector<PageId> lists[2];
+                if (node->postingEntries != 0)
+                {
+                    const RecordId *rids = view.rids();
+                    for (int i = 0, size = view.size(); i < size; i++)
+                    {
+                        if (isPosting(rids[i]))
+                        {
+                            lists[i >= index].push_back(rids[i].page_number);
+                        }
+                    }
+                }
+                int postingEntries = node->postingEntries;
+                if (!bufMgr->pageLatch(page).validate(version))
+                {
+                    break;
+                }
+                if (!lists[0].empty() || !lists[1].empty())
+                {
+                    bool above = lists[1].size() < lists[0].size();
+                    int extras = 0;
+                    for (size_t i = 0; i < lists[above].size(); i++)
+                    {
+                        int total;
+                        RecordId firstRid;
+                        PageId prevPageNo;
+                        PageId lastPageNo;
+                        this->readPostingHead(lists[above][i], total, firstRid, prevPageNo, lastPageNo);
+                        extras += total - 1;
+                    }
+                    if (!bufMgr->pageLatch(page).validate(version))
+                    {
+                        break;
+                    }
+                    count += above ? postingEntries - extras : extras;
+                }
+                this->unpinNode(pageNo, false);
+                return below + count;
+            }
+            else
+            {
+                // every child left of the one holding the bound is below it. Equal keys never span two
+                // children, so those equal to an exclusive bound are all right of the child it leads to.
+                NonLeafNode<K> *node = (NonLeafNode<K> *)page;
+                int index = inclusive ? NonLeafView<K>(node).upperBound(key) : NonLeafView<K>(node).lowerBound(key);
+                count = 0;
+                for (int i = 0; i < index; i++)
+                {
+                    count += node->countArray[i];
+                }
+                nextPageNo = node->pageNoArray[index];
+                nextIsLeaf = node->level == 1;
+            }
 
-        try
-        {
-            RecordId scanRid;
-            while (1)
+            // the node must still hold what was read from it once the next node's version is known
+            VersionLatch &latch = bufMgr->pageLatch(page);
+            if (!latch.validate(version))
             {
-                fscan.scanNext(scanRid);
-                std::string recordStr = fscan.getRecord();
-                const char *record = recordStr.c_str();
-                int key = *((int *)(record + attrByteOffset));
-                this->insertEntry(&key, scanRid);
+                break;
             }
+            Page *next;
+            this->readNode(nextPageNo, next);
+            std::uint64_t nextVersion = bufMgr->pageLatch(next).readLock();
+            valid = latch.validate(version);
+            this->unpinNode(pageNo, false);
+            pageNo = nextPageNo;
+            page = next;
+            version = nextVersion;
+            leaf = nextIsLeaf;
+            below += count;
         }
-        catch (EndOfFileException e)
-        {
-            bufMgr->flushFile(file);
-        }
-    }
 
-    outIndexName = indexName;
+        // another thread changed a node on the way: start over from the root
+        this->unpinNode(pageNo, false);
+    }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::~BTreeIndex -- destructor
+// BTree::minKey
 // -----------------------------------------------------------------------------
 
-BTreeIndex::~BTreeIndex()
+template <class K>
+bool BTree<K>::minKey(void *outKey)
 {
-    scanExecuting = false;
-    // bufMgr->unPinPage(file, rootPageNum, true);
-    bufMgr->flushFile(file);
-    delete file;
-    file = nullptr;
+    return this->edgeKey(false, (K *)outKey);
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
+// BTree::maxKey
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::insertEntry(const void *key, const RecordId rid)
+template <class K>
+bool BTree<K>::maxKey(void *outKey)
 {
-    Page *rootPage;
-    bufMgr->readPage(file, rootPageNum, rootPage);
-    // assume the key can only be integer
-    NonLeafNodeInt *rootNode = (NonLeafNodeInt *)rootPage;
-    bool splited; // record whether need to split the root node
-    bool childLeaf;
-    PageId newPageId;
+    return this->edgeKey(true, (K *)outKey);
+}
 
-    // Start from root to recursively find out the leaf to insert the entry in.
-    this->recurseInsert(rootPage, rootNode->level, true, key, rid, splited, childLeaf, newPageId);
+// -----------------------------------------------------------------------------
+// BTree::edgeKey
+// -----------------------------------------------------------------------------
 
-    //if the root splited, update the metapage
-    if (splited)
+template <class K>
+bool BTree<K>::edgeKey(const bool last, K *outKey)
+{
+    while (true)
     {
-        if (rootNode->keyArray[INTARRAYNONLEAFSIZE - 1] == INT32_MAX)
+        // the padding of the key arrays is the only key above the greatest
+        PageId pageNo;
+        Page *page;
+        std::uint64_t version;
+        if (last)
         {
-            //enough room
-            this->insertNonLeaf(rootPage, (void *)&middleInt, newPageId);
-
-            // print
-            NonLeafNodeInt *node = (NonLeafNodeInt *)rootPage;
+            this->findLeaf(KeyTraits<K>::greatest(), pageNo, page, version);
         }
         else
         {
+            this->findLeaf(KeyTraits<K>::lowest(), pageNo, page, version, true);
+        }
 
-            PageId addedPageId;
-            this->split(rootPage, false, (void *)&middleInt, newPageId, addedPageId);
-
-            //create a new NonLeafPage and put the middle int on it
-            Page *newRootPage;
-            PageId newRootPageId;
-            bufMgr->allocPage(file, newRootPageId, newRootPage);
-            NonLeafNodeInt *newRoot = (NonLeafNodeInt *)newRootPage;
-
-            //we know this can never be just above the leaves so set level to 0
-            newRoot->level = 0;
-            rootPageNum = newRootPageId;
+        // the edge leaf is empty only if the whole tree is, short of a delete that has not rebalanced yet
+        bool valid = true;
+        while (valid)
+        {
+            LeafNode<K> *leaf = (LeafNode<K> *)page;
+            LeafView<K> view(leaf);
+            int count = view.size();
+            K key = (count > 0) ? view.key(last ? count - 1 : 0) : K();
+            PageId nextPageNo = last ? leaf->leftSibPageNo : leaf->rightSibPageNo;
 
-            //null eveything in this new page
-            newRoot->pageNoArray[INTARRAYNONLEAFSIZE] = NULL;
-            for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
+            VersionLatch &latch = bufMgr->pageLatch(page);
+            if (!latch.validate(version))
+            {
+                break;
+            }
+            if (count > 0 || nextPageNo == Page::INVALID_NUMBER)
             {
-                newRoot->keyArray[i] = INT32_MAX;
-                newRoot->pageNoArray[i] = NULL;
+                this->unpinNode(pageNo, false);
+                if (count > 0)
+                {
+                    *outKey = key;
+                }
+                return count > 0;
             }
 
-            //the only value in the new root is the middle value passed up from the child
-            newRoot->keyArray[0] = middleInt;
+            Page *next;
+            this->readNode(nextPageNo, next);
+            std::uint64_t nextVersion = bufMgr->pageLatch(next).readLock();
+            valid = latch.validate(version);
+            this->unpinNode(pageNo, false);
+            pageNo = nextPageNo;
+            page = next;
+            version = nextVersion;
+        }
+
+        // another thread changed the leaf: start over from the root
+        this->unpinNode(pageNo, false);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTree::scanNext
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTree<K>::scanNext(RecordId &outRid)
+{
+    scanCursor.scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTree::scanNextBatch
+// -----------------------------------------------------------------------------
+
+template <class K>
+size_t BTree<K>::scanNextBatch(RecordId *out, void *keysOut, const size_t max)
+{
+    return scanCursor.scanNextBatch(out, keysOut, max);
+}
 
-            //the left child is the old root page
-            newRoot->pageNoArray[0] = rootPageNum;
+// -----------------------------------------------------------------------------
+// BTree::endScan
+// -----------------------------------------------------------------------------
+//
+template <class K>
+const void BTree<K>::endScan()
+{
+    scanCursor.endScan();
+}
 
-            //the right child is the one that was added by the restructure method
-            newRoot->pageNoArray[1] = addedPageId;
+// -----------------------------------------------------------------------------
+// BTreeScan::BTreeScan -- Constructor
+// -----------------------------------------------------------------------------
 
-            //unpin the old root page and update the class references
-            bufMgr->unPinPage(file, rootPageNum, true);
-            rootPageNum = newRootPageId;
-            rootPage = newRootPage;
+template <class K>
+BTreeScan<K>::BTreeScan()
+    : index(nullptr), scanExecuting(false), nextEntry(-1),
+      currentPageNum(static_cast<PageId>(-1)), currentPageData(nullptr), leafVersion(0), returnedAny(false), lastKey(),
+      lowVal(), highVal(), lowOp(GTE), highOp(LTE), order(ASCENDING), leafEnd(-1), lastLeaf(true),
+      readAhead(0), leavesSinceRequest(0), leavesSinceGrow(0),
+      inPosting(false), postingKey(), checkLow(false), checkHigh(false), lowFullOp(GTE), highFullOp(LTE), postingPos(0), postingPageNum(static_cast<PageId>(-1)), postingNextNum(Page::INVALID_NUMBER)
+{
+}
 
-            //update the meta info
-            //read in the metainfo so it can be updated
-            Page *metadataPage;
+// -----------------------------------------------------------------------------
+// BTreeScan::~BTreeScan -- destructor
+// -----------------------------------------------------------------------------
 
-            bufMgr->readPage(file, headerPageNum, metadataPage);
-            IndexMetaInfo *metadata = (IndexMetaInfo *)metadataPage;
+template <class K>
+BTreeScan<K>::~BTreeScan()
+{
+    release();
+}
 
-            metadata->rootPageNo = newRootPageId;
+// -----------------------------------------------------------------------------
+// BTreeScan::release
+// -----------------------------------------------------------------------------
 
-            //unpin the metadataPage
-            bufMgr->unPinPage(file, headerPageNum, true);
+template <class K>
+void BTreeScan<K>::release()
+{
+    if (scanExecuting)
+    {
+        try
+        {
+            index->unpinNode(currentPageNum, false);
+        }
+        catch (...)
+        {
+            // the destructors calling this must not throw
         }
     }
-    bufMgr->unPinPage(file, rootPageNum, true);
+    // stop executing the scan
+    scanExecuting = false;
+    //reset variables
+    currentPageData = nullptr;
+    currentPageNum = static_cast<PageId>(-1);
+    nextEntry = -1;
+    inPosting = false;
+    postingRids.clear();
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScan
+// BTreeScan::setLeafEnd
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::startScan(const void *lowValParm,
-                                 const Operator lowOpParm,
-                                 const void *highValParm,
-                                 const Operator highOpParm)
+template <class K>
+void BTreeScan<K>::setLeafEnd()
 {
-    lowValInt = *((int *)lowValParm);
-    highValInt = *((int *)highValParm);
-    lowOp = lowOpParm;
-    highOp = highOpParm;
+    LeafNode<K> *leaf = (LeafNode<K> *)currentPageData;
+    LeafView<K> view(leaf);
 
-    if (lowValInt > highValInt)
-    {
-        // scanExecuting = false;
-        throw BadScanrangeException();
-    }
+    // number of entries on the leaf; the bounds can never reach past them
+    int count = view.size();
 
-    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE))
+    if (order == DESCENDING)
     {
+        leafEnd = (lowOp == GTE) ? view.lowerBound(lowVal) : view.upperBound(lowVal);
+        if (leafEnd > count)
+        {
+            leafEnd = count;
+        }
 
-        // scanExecuting = false;
-        throw BadOpcodesException();
+        // the scan goes on to the left sibling only if every remaining entry here qualifies
+        lastLeaf = leafEnd > 0 || leaf->leftSibPageNo == Page::INVALID_NUMBER;
+        return;
     }
 
-    Page *nt_page;
-    bufMgr->readPage(file, rootPageNum, nt_page);
-    //set the currentPageData, variable defined in header file to that leaf node
-
-    int index;
-
-    if (scanExecuting)
+    leafEnd = (highOp == LTE) ? view.upperBound(highVal) : view.lowerBound(highVal);
+    if (leafEnd > count)
     {
-        // If another scan is already executing, that needs to be ended here.
-        this->endScan();
+        leafEnd = count;
     }
 
-    startScanHeler(nt_page, lowValParm, index);
-    //unpin root page
-    bufMgr->unPinPage(file, rootPageNum, false);
-    scanExecuting = true; // not error thrown within helper, start
+    // the scan goes on to the right sibling only if every remaining entry here qualifies
+    lastLeaf = leafEnd < count || leaf->rightSibPageNo == Page::INVALID_NUMBER;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::startScanHeler
-// Start from root to find out the leaf page
+// BTreeScan::seek
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::startScanHeler(Page *nl, const void *lowValParm, int &index)
+template <class K>
+void BTreeScan<K>::seek()
 {
-
-    NonLeafNodeInt *np = (NonLeafNodeInt *)nl;
-    int level = np->level;
-
-    if (level == 0)
+    BufMgr *bufMgr = index->bufMgr;
+    if (currentPageData != nullptr)
     {
-        // recurse to find the level above leaf
-        findPageNo(nl, lowValParm, index);
+        index->unpinNode(currentPageNum, false);
+        currentPageData = nullptr;
+    }
 
-        Page *childPage;
-        bufMgr->readPage(file, ((NonLeafNodeInt *)nl)->pageNoArray[index], childPage);
-        startScanHeler(childPage, lowValParm, index);
-        bufMgr->unPinPage(file, ((NonLeafNodeInt *)nl)->pageNoArray[index], false);
+    // start from the leftmost leaf that may hold the low bound, or the last one that may hold the high bound
+    // for a descending scan, and find the first entry satisfying it from there
+    if (order == ASCENDING)
+    {
+        index->findLeaf(lowVal, currentPageNum, currentPageData, leafVersion, true);
     }
     else
     {
-        // above leaf node, get leaf page and search for record satisfing the requirements
-        Page *leafPage;
-        findPageNo(nl, lowValParm, index);
-        PageId leafId = ((NonLeafNodeInt *)nl)->pageNoArray[index];
-        bufMgr->readPage(file, leafId, leafPage);
-        LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
-        // currentPageNum = leafPageId;
+        index->findLeaf(highVal, currentPageNum, currentPageData, leafVersion);
+    }
+    returnedAny = false;
+    reposition();
 
-        // find the record satisfing the requirements
-        bool found = false;
-        while (!found)
+    // move on through the siblings while every remaining entry of the leaf is outside the scan
+    while ((order == ASCENDING) ? nextEntry >= leafEnd : nextEntry < leafEnd)
+    {
+        if (lastLeaf)
         {
-
-            // iterate through the key on the leaf
-            for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
-            {
-                int key = leaf->keyArray[i];
-                if (key == INT32_MAX)
-                {
-                    // no more key on this leaf
-                    break;
-                }
-                // check whether the key satisfy the requirements
-                if (lowOp == GTE && highOp == LTE)
-                {
-                    found = key <= highValInt && key >= lowValInt;
-                }
-                else if (lowOp == GT && highOp == LTE)
-                {
-                    found = key <= highValInt && key > lowValInt;
-                }
-                else if (lowOp == GTE && highOp == LT)
-                {
-                    found = key < highValInt && key >= lowValInt;
-                }
-                else
-                {
-                    found = key < highValInt && key > lowValInt;
-                }
-
-                if (found)
-                {
-                    currentPageData = leafPage;
-                    currentPageNum = leafId;
-                    nextEntry = i;
-
-                    break;
-                }
-            }
-
-            if (!found)
+            if (!bufMgr->pageLatch(currentPageData).validate(leafVersion))
             {
-                bufMgr->unPinPage(file, leafId, false);
-                // unpin the page
-                // search for next possible page
-                if (leaf->rightSibPageNo != NULL)
-                {
-                    PageId nextPageId = leaf->rightSibPageNo;
-                    bufMgr->readPage(file, nextPageId, leafPage);
-                    leafId = nextPageId;
-                    leaf = (LeafNodeInt *)leafPage;
-                }
-                else
-                {
-                    bufMgr->unPinPage(file, rootPageNum, false);
-                    throw NoSuchKeyFoundException();
-                }
+                reposition();
+                continue;
             }
+            index->unpinNode(currentPageNum, false);
+            currentPageData = nullptr;
+            throw NoSuchKeyFoundException();
+        }
+        if (!nextLeaf())
+        {
+            reposition();
         }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
+// BTreeScan::reposition
 // -----------------------------------------------------------------------------
 
-const void BTreeIndex::scanNext(RecordId &outRid)
+template <class K>
+void BTreeScan<K>::reposition()
 {
-    if (!scanExecuting)
+    BufMgr *bufMgr = index->bufMgr;
+    while (true)
     {
-        throw ScanNotInitializedException();
-    }
-
-    LeafNodeInt *leaf = (LeafNodeInt *)currentPageData;
+        inPosting = false;
+        LeafNode<K> *leaf = (LeafNode<K> *)currentPageData;
+        VersionLatch &latch = bufMgr->pageLatch(currentPageData);
+        std::uint64_t version = latch.readLock();
+        LeafView<K> view(leaf);
+        const RecordId *rids = view.rids();
+        int count = view.size();
 
-    if (nextEntry == INTARRAYNONLEAFSIZE - 1 || leaf->keyArray[nextEntry] == INT32_MAX)
-    {
-        // end of the page
-        // Unpin page and read papge
-        bufMgr->unPinPage(file, currentPageNum, false);
-        // No more next leaf
-        if (leaf->rightSibPageNo == NULL)
+        // position of the entry the scan goes on with, and whether it may be on a leaf to the right instead
+        int pos;
+        bool onRight;
+        PageId headPageNum = Page::INVALID_NUMBER;
+        int i = view.lowerBound(lastKey);
+        if (returnedAny && i < count && view.key(i) == lastKey && isPosting(rids[i]))
+        {
+            // the last entry returned is in a posting list: the scan goes on inside it
+            pos = i;
+            headPageNum = rids[i].page_number;
+            onRight = false;
+        }
+        else if (returnedAny)
+        {
+            // the last entry returned, among the entries with its key
+            int j = i;
+            while (j < count && view.key(j) == lastKey && !(rids[j] == lastRid))
+            {
+                j++;
+            }
+            bool found = j < count && view.key(j) == lastKey;
+            if (found)
+            {
+                pos = (order == ASCENDING) ? j + 1 : j - 1;
+            }
+            else
+            {
+                pos = (order == ASCENDING) ? j : i - 1;
+            }
+            onRight = !found && j == count;
+        }
+        else if (order == ASCENDING)
         {
-            // no more leaf page available
-            throw IndexScanCompletedException();
+            pos = (lowOp == GTE) ? view.lowerBound(lowVal) : view.upperBound(lowVal);
+            pos = std::min(pos, count);
+            onRight = pos == count;
         }
         else
         {
+            // the last entry satisfying the high bound
+            pos = (highOp == LTE) ? view.upperBound(highVal) : view.lowerBound(highVal);
+            pos = std::min(pos, count);
+            onRight = pos == count;
+            pos--;
+        }
+        PageId rightPageNum = leaf->rightSibPageNo;
+
+        if (!latch.validate(version))
+        {
+            continue;
+        }
+        if (onRight && rightPageNum != Page::INVALID_NUMBER)
+        {
+            // splits only move entries to the right
+            Page *rightPage;
+            index->readNode(rightPageNum, rightPage);
+            bufMgr->pageLatch(rightPage).readLock();
+            if (!latch.validate(version))
+            {
+                index->unpinNode(rightPageNum, false);
+                continue;
+            }
+            index->unpinNode(currentPageNum, false);
+            currentPageNum = rightPageNum;
+            currentPageData = rightPage;
+            continue;
+        }
+        if (headPageNum != Page::INVALID_NUMBER && !enterPosting(lastKey, headPageNum, true))
+        {
+            // nothing is left of the list past the last entry returned
+            pos += (order == ASCENDING) ? 1 : -1;
+        }
 
-            currentPageNum = leaf->rightSibPageNo;
-            bufMgr->readPage(file, currentPageNum, currentPageData);
-            leaf = (LeafNodeInt *)currentPageData;
-            // Reset nextEntry
-            nextEntry = 0;
+        nextEntry = pos;
+        leafVersion = version;
+        setLeafEnd();
+        if (latch.validate(version))
+        {
+            break;
         }
     }
-    // find whether the rid satisfy op
-    int key = leaf->keyArray[nextEntry];
-    // check whether satisfy
-    bool satisfy;
 
-    if (lowOp == GTE && highOp == LTE)
+    // the read-ahead starts over from the leaf the scan is on now
+    leavesSinceRequest = readAhead;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScan::nextLeaf
+// -----------------------------------------------------------------------------
+
+template <class K>
+bool BTreeScan<K>::nextLeaf()
+{
+    // the sibling must still be the next leaf once its version is known
+    LeafNode<K> *leaf = (LeafNode<K> *)currentPageData;
+    PageId nextPageNum = (order == ASCENDING) ? leaf->rightSibPageNo : leaf->leftSibPageNo;
+    VersionLatch &latch = index->bufMgr->pageLatch(currentPageData);
+    if (!latch.validate(leafVersion))
+    {
+        return false;
+    }
+    Page *nextPage;
+    index->readNode(nextPageNum, nextPage);
+    std::uint64_t nextVersion = index->bufMgr->pageLatch(nextPage).readLock();
+    if (!latch.validate(leafVersion))
     {
-        satisfy = key <= highValInt && key >= lowValInt;
+        index->unpinNode(nextPageNum, false);
+        return false;
     }
-    else if (lowOp == GT && highOp == LTE)
+
+    // Unpin page and read papge
+    index->unpinNode(currentPageNum, false);
+    currentPageNum = nextPageNum;
+    currentPageData = nextPage;
+    leafVersion = nextVersion;
+    // Reset nextEntry
+    nextEntry = (order == ASCENDING) ? 0 : LeafView<K>(currentPageData).size() - 1;
+    setLeafEnd();
+
+    if (readAhead == 0)
     {
-        satisfy = key <= highValInt && key > lowValInt;
+        return true;
     }
-    else if (lowOp == GTE && highOp == LT)
+
+    // the longer the scan runs, the further ahead it reads
+    leavesSinceRequest++;
+    if (++leavesSinceGrow >= readAhead && readAhead < index->readAheadLimit)
     {
-        satisfy = key < highValInt && key >= lowValInt;
+        readAhead = std::min(readAhead * 2, index->readAheadLimit);
+        leavesSinceGrow = 0;
     }
-    else
+    fillReadAhead();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScan::fillReadAhead
+// -----------------------------------------------------------------------------
+
+template <class K>
+void BTreeScan<K>::fillReadAhead()
+{
+    if (readAhead == 0 || lastLeaf || leavesSinceRequest < std::max(readAhead / 2, 1))
     {
-        satisfy = key < highValInt && key > lowValInt;
+        return;
     }
 
-    if (satisfy)
+    // a leaf changing under the scan is looked at again on the next leaf it enters
+    LeafNode<K> *leaf = (LeafNode<K> *)currentPageData;
+    PageId nextPageNum = (order == ASCENDING) ? leaf->rightSibPageNo : leaf->leftSibPageNo;
+    if (!index->bufMgr->pageLatch(currentPageData).validate(leafVersion) || nextPageNum == Page::INVALID_NUMBER)
     {
-        // std::cout<<"next5"<< std::endl;
-        outRid = leaf->ridArray[nextEntry];
-        nextEntry++;
-        // std::cout<<"next6"<< std::endl;
+        return;
     }
-    else
+    leavesSinceRequest = 0;
+
+    // the prefetching thread reads each leaf unpinned, with the buffer pool locked, to find the next one. A writer
+    // may be changing it, in which case the run stops there. The scan ends on a leaf whose last key is past the high
+    // bound (whose first key is before the low bound).
+    BufMgr *bufMgr = index->bufMgr;
+    ScanOrder scanOrder = order;
+    K low = lowVal;
+    K high = highVal;
+    Operator lowOperator = lowOp;
+    Operator highOperator = highOp;
+    bufMgr->prefetchPages(index->file, nextPageNum, readAhead,
+                          [bufMgr, scanOrder, low, high, lowOperator, highOperator](Page *page) -> PageId {
+                              VersionLatch &latch = bufMgr->pageLatch(page);
+                              std::uint64_t version;
+                              if (!latch.tryReadLock(version))
+                              {
+                                  return Page::INVALID_NUMBER;
+                              }
+                              LeafNode<K> *node = (LeafNode<K> *)page;
+                              PageId next = (scanOrder == ASCENDING) ? node->rightSibPageNo : node->leftSibPageNo;
+                              LeafView<K> view(node);
+                              int count = view.size();
+                              bool endsHere;
+                              if (scanOrder == ASCENDING)
+                              {
+                                  endsHere = count > 0 && ((highOperator == LTE && view.key(count - 1) > high) ||
+                                                           (highOperator == LT && view.key(count - 1) >= high));
+                              }
+                              else
+                              {
+                                  endsHere = count > 0 && ((lowOperator == GTE && view.key(0) < low) ||
+                                                           (lowOperator == GT && view.key(0) <= low));
+                              }
+                              return (endsHere || !latch.validate(version)) ? Page::INVALID_NUMBER : next;
+                          });
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScan::scanNext
+// -----------------------------------------------------------------------------
+
+template <class K>
+const void BTreeScan<K>::scanNext(RecordId &outRid)
+{
+    // a single entry is a batch of one
+    if (scanNextBatch(&outRid, NULL, 1) == 0)
     {
+        // no more entries satisfy the scan, the page stays pinned until endScan
         throw IndexScanCompletedException();
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+// BTreeScan::scanNextBatch
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::endScan()
+
+template <class K>
+size_t BTreeScan<K>::scanNextBatch(RecordId *out, void *keysOutParm, const size_t max)
 {
-    if (!scanExecuting)
+    K *keysOut = (K *)keysOutParm;
+    if (!checkLow && !checkHigh)
     {
-        throw ScanNotInitializedException();
+        return nextBatch(out, keysOut, max);
     }
-    else
+
+    // the entries tying with a bound are dropped from the batch if their records are out of range.
+    // A batch left empty is not the end of the scan.
+    if (keysOut == NULL)
     {
-        // FileIterator filePageIter((PageFile *)file);
-        bufMgr->unPinPage(file, currentPageNum, false);
-        // stop executing the scan
-        scanExecuting = false;
-        //reset variables
-        currentPageData = nullptr;
-        currentPageNum = static_cast<PageId>(-1);
-        nextEntry = -1;
+        checkKeys.resize(max);
+        keysOut = &checkKeys[0];
+    }
+    while (true)
+    {
+        size_t count = nextBatch(out, keysOut, max);
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (inBounds(keysOut[i], out[i]))
+            {
+                out[kept] = out[i];
+                keysOut[kept] = keysOut[i];
+                kept++;
+            }
+        }
+        if (kept > 0 || count == 0)
+        {
+            return kept;
+        }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::recurseInsert
+// BTreeScan::inBounds
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::recurseInsert(Page *page, int level, bool isRoot, const void *keyPtr, const RecordId rid, bool &splited, bool &childLeaf, PageId &newPageId)
-{
-    NonLeafNodeInt *node = (NonLeafNodeInt *)page;
 
-    int index; // index of node in pageNoArray to recurse on
-
-    if (level == 0)
+template <class K>
+bool BTreeScan<K>::inBounds(const K key, const RecordId rid)
+{
+    bool low = checkLow && key == lowVal;
+    bool high = checkHigh && key == highVal;
+    if (!low && !high)
     {
-        childLeaf = false;
-
-        //find the key to recurse on
-        this->findPageNo(page, keyPtr, index);
-
-        // recurse
-        //read in that page
-        Page *child;
-        bufMgr->readPage(file, node->pageNoArray[index], child);
+        return true;
+    }
+    return index->recordInRange(rid, low ? lowFull.c_str() : NULL, lowFullOp, high ? highFull.c_str() : NULL,
+                                highFullOp);
+}
 
-        PageId pageIdFromChild;
-        bool childsplited;
-        bool fromLeaf;
+// -----------------------------------------------------------------------------
+// BTreeScan::nextBatch
+// -----------------------------------------------------------------------------
 
-        recurseInsert(child, ((NonLeafNodeInt *)child)->level, false, keyPtr, rid, childsplited, fromLeaf, pageIdFromChild);
+template <class K>
+size_t BTreeScan<K>::nextBatch(RecordId *out, K *keysOut, const size_t max)
+{
+    if (!scanExecuting)
+    {
+        throw ScanNotInitializedException();
+    }
 
-        if (childsplited)
+    while (true)
+    {
+        VersionLatch &latch = index->bufMgr->pageLatch(currentPageData);
+        if (inPosting)
         {
-            if (fromLeaf)
+            if (postingPos == postingRids.size() && !nextPosting())
             {
-                //read the pageIdFromChild and set its level to 1
-                Page *pageFromChild;
-                NonLeafNodeInt *nodeFromChild;
-                bufMgr->readPage(file, pageIdFromChild, pageFromChild);
-                nodeFromChild = (NonLeafNodeInt *)pageFromChild;
-                nodeFromChild->level = 1;
+                // the list is done: the scan goes on with the entry after its slot
+                inPosting = false;
+                postingRids.clear();
+                if (latch.validate(leafVersion))
+                {
+                    nextEntry += (order == ASCENDING) ? 1 : -1;
+                }
+                else
+                {
+                    reposition();
+                }
+                continue;
+            }
 
-                //unpin the page
-                bufMgr->unPinPage(file, pageIdFromChild, true);
+            size_t count = std::min(max, postingRids.size() - postingPos);
+            std::copy(postingRids.begin() + postingPos, postingRids.begin() + postingPos + count, out);
+            if (keysOut != NULL)
+            {
+                std::fill(keysOut, keysOut + count, postingKey);
             }
+            postingPos += count;
+            lastKey = postingKey;
+            lastRid = out[count - 1];
+            returnedAny = true;
+            return count;
+        }
 
-            if (node->keyArray[INTARRAYNONLEAFSIZE - 1] == INT32_MAX)
+        if ((order == ASCENDING) ? nextEntry >= leafEnd : nextEntry < leafEnd)
+        {
+            if (lastLeaf && latch.validate(leafVersion))
             {
-                //enough room, just insert
-                splited = false;
-                insertNonLeaf(page, (void *)&middleInt, pageIdFromChild);
+                return 0;
             }
-            else
+            if (lastLeaf || !nextLeaf())
             {
-                splited = true;
-                //save the value of middleInt that the previous restructure set
-                int middleIntFromChild = middleInt;
-
-                split(page, false, (void *)&middleIntFromChild, pageIdFromChild, newPageId);
+                reposition();
+            }
+            continue;
+        }
 
-                //only need to insert if not equal
-                if (middleIntFromChild < middleInt)
+        // the entries are copied out first and kept only if the leaf did not change meanwhile.
+        // A posting list ends the block, and is read on its own. A leaf repacked since the positions were
+        // taken may have fewer slots than they reach.
+        LeafView<K> view(currentPageData);
+        const RecordId *rids = view.rids();
+        if (nextEntry >= view.capacity() || leafEnd > view.capacity())
+        {
+            reposition();
+            continue;
+        }
+        size_t count;
+        int last;
+        if (order == DESCENDING)
+        {
+            // entries from nextEntry down to leafEnd, reversed on the way out
+            count = (size_t)(nextEntry - leafEnd + 1);
+            if (count > max)
+            {
+                count = max;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                if (isPosting(rids[nextEntry - i]))
                 {
-                    //insert it onto old node (node)
-                    insertNonLeaf(page, (void *)&middleIntFromChild, pageIdFromChild);
+                    count = i;
+                    break;
                 }
-                else if (middleIntFromChild > middleInt)
+                out[i] = rids[nextEntry - i];
+                if (keysOut != NULL)
                 {
-                    //insert
-                    //read in that page
-                    Page *newNodePage;
-                    bufMgr->readPage(file, newPageId, newNodePage);
-
-                    insertNonLeaf(newNodePage, (void *)&middleIntFromChild, pageIdFromChild);
-
-                    //unpin that page
-                    bufMgr->unPinPage(file, newPageId, true);
+                    keysOut[i] = view.key(nextEntry - i);
                 }
             }
+            last = nextEntry - (int)count + 1;
         }
-        bufMgr->unPinPage(file, node->pageNoArray[index], true);
-    }
-    else
-    {
-        childLeaf = true;
-        //we are the parent of the leaf
-        //find what page the leaf is on
-        findPageNo(page, keyPtr, index);
-
-        //read in the leaf page and cast
-        Page *leafPage;
-        PageId leafPageId = node->pageNoArray[index];
-        bufMgr->readPage(file, leafPageId, leafPage);
-        LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
-
-        //find the index into the key array where the rid would go
-        findKey(leafPage, keyPtr, index);
-
-        //insert into leaf
-        //if the last place in the leaf is NULL then we dont have to restructure
-        if (leaf->keyArray[INTARRAYLEAFSIZE - 1] == INT32_MAX)
+        else
         {
-            splited = false;
-
-            //move entries over one place (start at the end)
-            for (int i = INTARRAYLEAFSIZE - 1; i > index; i--)
+            // the qualifying entries of a leaf are contiguous, so they are copied as a block
+            count = (size_t)(leafEnd - nextEntry);
+            if (count > max)
             {
-                leaf->keyArray[i] = leaf->keyArray[i - 1];
-                leaf->ridArray[i] = leaf->ridArray[i - 1];
+                count = max;
             }
-
-            //actually insert the entry
-            leaf->keyArray[index] = *(int *)keyPtr;
-            leaf->ridArray[index].page_number = rid.page_number;
-            leaf->ridArray[index].slot_number = rid.slot_number;
-        }
-        else
-        {
-            splited = true;
-
-            split(leafPage, true, keyPtr, NULL, newPageId);
-
-            //now actually put the entry passed in on one of these pages
-            if (*((int *)keyPtr) >= middleInt)
+            for (size_t i = 0; i < count; i++)
             {
-                Page *newLeafPage;
-                bufMgr->readPage(file, newPageId, newLeafPage);
-
-                LeafNodeInt *newLeaf = (LeafNodeInt *)newLeafPage;
-
-                findKey(newLeafPage, keyPtr, index);
-
-                //move the keys over on this page
-                for (int i = INTARRAYLEAFSIZE - 1; i > index; i--)
+                if (isPosting(rids[nextEntry + i]))
                 {
-                    newLeaf->keyArray[i] = newLeaf->keyArray[i - 1];
-                    newLeaf->ridArray[i].page_number = newLeaf->ridArray[i - 1].page_number;
-                    newLeaf->ridArray[i].slot_number = newLeaf->ridArray[i - 1].slot_number;
+                    count = i;
+                    break;
                 }
-
-                //actually insert the record
-                newLeaf->keyArray[index] = *(int *)keyPtr;
-                newLeaf->ridArray[index].page_number = rid.page_number;
-                newLeaf->ridArray[index].slot_number = rid.slot_number;
-
-                // unpin pages
-                bufMgr->unPinPage(file, newPageId, true);
             }
-            else
+            memcpy(out, &rids[nextEntry], count * sizeof(RecordId));
+            if (keysOut != NULL)
             {
-                findKey(leafPage, keyPtr, index);
-
-                //move the keys
-                for (int i = INTARRAYLEAFSIZE - 1; i > index; i--)
-                {
-                    leaf->keyArray[i] = leaf->keyArray[i - 1];
-                    leaf->ridArray[i].page_number = leaf->ridArray[i - 1].page_number;
-                    leaf->ridArray[i].slot_number = leaf->ridArray[i - 1].slot_number;
-                }
+                view.keys(nextEntry, (int)count, keysOut);
+            }
+            last = nextEntry + (int)count - 1;
+        }
 
-                // insert
-                leaf->keyArray[index] = *(int *)keyPtr;
-                leaf->ridArray[index].page_number = rid.page_number;
-                leaf->ridArray[index].slot_number = rid.slot_number;
+        if (count == 0)
+        {
+            // the next entry is a posting list
+            K key = view.key(nextEntry);
+            PageId headPageNum = rids[nextEntry].page_number;
+            if (!latch.validate(leafVersion))
+            {
+                reposition();
+                continue;
+            }
+            if (!enterPosting(key, headPageNum, false))
+            {
+                nextEntry += (order == ASCENDING) ? 1 : -1;
             }
+            continue;
         }
-        // unpin pages
-        bufMgr->unPinPage(file, leafPageId, true);
+        K key = view.key(last);
+
+        if (!latch.validate(leafVersion))
+        {
+            reposition();
+            continue;
+        }
+
+        lastKey = key;
+        lastRid = out[count - 1];
+        returnedAny = true;
+        nextEntry += (order == ASCENDING) ? (int)count : -(int)count;
+        return count;
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findPageNo
+// BTreeScan::enterPosting
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::findPageNo(Page *page, const void *keyPtr, int &index)
+
+template <class K>
+bool BTreeScan<K>::enterPosting(const K key, const PageId headPageNum, const bool resume)
 {
-    NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+    postingKey = key;
+    if (order == ASCENDING)
+    {
+        readPosting(headPageNum);
+    }
+    else
+    {
+        // a descending scan starts from the last page, which the first one knows
+        int total;
+        RecordId firstRid;
+        PageId prevPageNum;
+        PageId lastPageNum;
+        index->readPostingHead(headPageNum, total, firstRid, prevPageNum, lastPageNum);
+        readPostingBefore(lastPageNum, Page::INVALID_NUMBER);
+    }
 
-    // iterate the key array to find the suitable index to recurse on
-    for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
+    while (true)
     {
-        if (*(int *)keyPtr < node->keyArray[0])
+        // the record ids up to the last one returned were returned already
+        if (resume)
         {
-            index = 0;
-            return;
+            while (postingPos < postingRids.size() &&
+                   ((order == ASCENDING) ? !ridLess(lastRid, postingRids[postingPos])
+                                         : !ridLess(postingRids[postingPos], lastRid)))
+            {
+                postingPos++;
+            }
         }
-        else if (*(int *)keyPtr >= node->keyArray[i] && (i == INTARRAYNONLEAFSIZE - 1 || node->keyArray[i + 1] == INT32_MAX))
+        if (postingPos < postingRids.size())
         {
-            // reach the end of the array
-            index = i + 1;
-            return;
+            inPosting = true;
+            return true;
         }
-        else if (*(int *)keyPtr >= node->keyArray[i] && *(int *)keyPtr < node->keyArray[i + 1])
+        if (!nextPosting())
         {
-            // key is between keyarray[i] and keyarray[i+1]
-            index = i + 1;
-            return;
+            inPosting = false;
+            postingRids.clear();
+            return false;
         }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findRecurse
+// BTreeScan::readPosting
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::findKey(Page *leafPage, const void *keyPtr, int &index)
-{
-    // current key and node
-    LeafNodeInt *leaf = (LeafNodeInt *)leafPage;
 
-    // iterate the key array to find the suitable index to recurse on
-    // assume no duplicate key
-    for (int i = 0; i < INTARRAYLEAFSIZE; i++)
+template <class K>
+void BTreeScan<K>::readPosting(PageId pageNum)
+{
+    BufMgr *bufMgr = index->bufMgr;
+    Page *page;
+    index->readNode(pageNum, page);
+    VersionLatch &latch = bufMgr->pageLatch(page);
+    PostingNode *node = (PostingNode *)page;
+    PageId prevPageNum;
+    while (true)
     {
-        if (leaf->keyArray[0] == INT32_MAX || *(int *)keyPtr < leaf->keyArray[0])
-        {
-            index = 0;
-            return;
-        }
-        else if (*((int *)keyPtr) > leaf->keyArray[i] && (i == INTARRAYLEAFSIZE - 1 || leaf->keyArray[i + 1] == INT32_MAX))
+        std::uint64_t version = latch.readLock();
+        postingRids.clear();
+        decodePosting(node, postingRids);
+        postingNextNum = node->nextPageNo;
+        prevPageNum = node->prevPageNo;
+        if (latch.validate(version))
         {
-            // reach the end of the array
-            index = i + 1;
-            return;
+            break;
         }
-        else if (*((int *)keyPtr) > leaf->keyArray[i] && *((int *)keyPtr) < leaf->keyArray[i + 1])
+    }
+    index->unpinNode(pageNum, false);
+
+    if (order == DESCENDING)
+    {
+        std::reverse(postingRids.begin(), postingRids.end());
+    }
+    postingPageNum = pageNum;
+    postingPos = 0;
+
+    PageId nextPageNum = (order == ASCENDING) ? postingNextNum : prevPageNum;
+    if (nextPageNum != Page::INVALID_NUMBER)
+    {
+        bufMgr->prefetchPage(index->file, nextPageNum);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeScan::readPostingBefore
+// -----------------------------------------------------------------------------
+
+template <class K>
+void BTreeScan<K>::readPostingBefore(PageId pageNum, const PageId rightPageNum)
+{
+    // pages split off the page are linked in between it and the one it was left of
+    while (true)
+    {
+        readPosting(pageNum);
+        if (postingNextNum == rightPageNum || postingNextNum == Page::INVALID_NUMBER)
         {
-            // key is between keyarray[i] and keyarray[i+1]
-            index = i + 1;
             return;
         }
+        pageNum = postingNextNum;
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertNonLeaf
+// BTreeScan::nextPosting
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::insertNonLeaf(Page *page, const void *keyPtr, PageId pageId)
-{
-    // current key and node
-    NonLeafNodeInt *node = (NonLeafNodeInt *)page;
 
-    // iterate the key array to find where to insert
-    for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
+template <class K>
+bool BTreeScan<K>::nextPosting()
+{
+    while (true)
     {
-        if (node->keyArray[i] == INT32_MAX)
+        if (order == ASCENDING)
         {
-            node->keyArray[i] = *((int *)keyPtr);
-            node->pageNoArray[i + 1] = pageId;
-            return;
+            // the link read with the page: pages split off it since hold nothing the scan has not seen
+            if (postingNextNum == Page::INVALID_NUMBER)
+            {
+                return false;
+            }
+            readPosting(postingNextNum);
         }
-        else if (*((int *)keyPtr) < node->keyArray[i])
+        else
         {
-            // shift the later part of the array
-            for (int j = INTARRAYNONLEAFSIZE - 1; j > i; j--)
+            int total;
+            RecordId firstRid;
+            PageId prevPageNum;
+            PageId lastPageNum;
+            index->readPostingHead(postingPageNum, total, firstRid, prevPageNum, lastPageNum);
+            if (prevPageNum == Page::INVALID_NUMBER)
             {
-                node->keyArray[j] = node->keyArray[j - 1];
-                node->pageNoArray[j + 1] = node->pageNoArray[j];
+                return false;
             }
-            // insert
-            node->keyArray[i] = *((int *)keyPtr);
-            node->pageNoArray[i + 1] = pageId;
-            return;
+            readPostingBefore(prevPageNum, postingPageNum);
+        }
+        if (!postingRids.empty())
+        {
+            return true;
         }
     }
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::split
+// BTreeScan::endScan
 // -----------------------------------------------------------------------------
 //
-const void BTreeIndex::split(Page *fullPage, bool isLeaf, const void *keyPtr, PageId newPageIdChild, PageId &newPageId)
+template <class K>
+const void BTreeScan<K>::endScan()
 {
-    int middleIndex; // records the middle index to split
-
-    if (isLeaf)
+    if (!scanExecuting)
+    {
+        throw ScanNotInitializedException();
+    }
+    else
     {
-        LeafNodeInt *fullLeaf = (LeafNodeInt *)fullPage;
+        release();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::BTreeIndex -- Constructor
+// -----------------------------------------------------------------------------
 
-        //create a new page
-        Page *newLeafPage;
-        bufMgr->allocPage(file, newPageId, newLeafPage);
-        LeafNodeInt *newLeaf = (LeafNodeInt *)newLeafPage;
+BTreeIndex::BTreeIndex(const std::string &relationName,
+                       std::string &outIndexName,
+                       BufMgr *bufMgrIn,
+                       const int attrByteOffset,
+                       const Datatype attrType,
+                       const double fillFactor,
+                       const bool compressLeaves,
+                       const bool redistributeLeaves,
+                       const int buildThreads)
+    : BTreeIndex(relationName, outIndexName, bufMgrIn,
+                 std::vector<KeyAttribute>(1, KeyAttribute{attrByteOffset, attrType}), fillFactor, compressLeaves,
+                 redistributeLeaves, buildThreads)
+{
+}
 
-        //NULL everything in the new page
-        for (int i = 0; i < INTARRAYLEAFSIZE; i++)
+BTreeIndex::BTreeIndex(const std::string &relationName,
+                       std::string &outIndexName,
+                       BufMgr *bufMgrIn,
+                       const std::vector<KeyAttribute> &attributes,
+                       const double fillFactor,
+                       const bool compressLeaves,
+                       const bool redistributeLeaves,
+                       const int buildThreads)
+    : attributeType(COMPOSITE), tree(NULL)
+{
+    if (attributes.empty() || attributes.size() > (size_t)MAX_KEY_ATTRIBUTES)
+    {
+        throw BadIndexInfoException("an index is built over 1 to MAX_KEY_ATTRIBUTES attributes");
+    }
+    if (attributes.size() > 1)
+    {
+        int width = 0;
+        for (size_t i = 0; i < attributes.size(); i++)
         {
-            newLeaf->keyArray[i] = INT32_MAX;
-            //not NULLing the rids here because we just assume if the key is NULL then so is the associated rid so don't access it
+            if (CompositeKey::width(attributes[i].type) == 0)
+            {
+                throw BadIndexInfoException("keys of the attribute type cannot be part of a composite key");
+            }
+            width += CompositeKey::width(attributes[i].type);
         }
-
-        //get the middle value and index
-        int middleIndex;
-        this->findMiddle(fullPage, true, keyPtr, middleIndex);
-
-        //copy all the keys and rids over from middleIndex
-        for (int i = middleIndex; i < INTARRAYLEAFSIZE; i++)
+        if (width > COMPOSITESIZE)
         {
-            newLeaf->keyArray[i - middleIndex] = fullLeaf->keyArray[i];
-            fullLeaf->keyArray[i] = INT32_MAX;
-            newLeaf->ridArray[i - middleIndex] = fullLeaf->ridArray[i];
-            //not NULLing rids here again, just check if corresponding key is null to see if the data is valid
+            throw BadIndexInfoException("the attributes do not fit in a composite key");
         }
-
-        newLeaf->rightSibPageNo = fullLeaf->rightSibPageNo;
-        fullLeaf->rightSibPageNo = newPageId;
-
-        //unpin the page that was created
-        bufMgr->unPinPage(file, newPageId, true);
     }
     else
     {
-        //cast the fullPage to a nonleaf
-        NonLeafNodeInt *fullNode = (NonLeafNodeInt *)fullPage;
+        attributeType = attributes[0].type;
+    }
 
-        //create a new page
-        Page *newNodePage;
-        bufMgr->allocPage(file, newPageId, newNodePage);
-        NonLeafNodeInt *newNode = (NonLeafNodeInt *)newNodePage;
+    // the only place the attribute type is looked at: every operation after this runs on keys of its type
+    switch (attributeType)
+    {
+    case INTEGER:
+        tree = new BTree<int>(relationName, outIndexName, bufMgrIn, attributes, fillFactor, compressLeaves,
+                              redistributeLeaves, buildThreads);
+        break;
+    case BIGINT:
+        tree = new BTree<long long>(relationName, outIndexName, bufMgrIn, attributes, fillFactor, compressLeaves,
+                                    redistributeLeaves, buildThreads);
+        break;
+    case DOUBLE:
+        tree = new BTree<double>(relationName, outIndexName, bufMgrIn, attributes, fillFactor, compressLeaves,
+                                 redistributeLeaves, buildThreads);
+        break;
+    case STRING:
+        tree = new BTree<StringKey>(relationName, outIndexName, bufMgrIn, attributes, fillFactor, compressLeaves,
+                                    redistributeLeaves, buildThreads);
+        break;
+    case COMPOSITE:
+        tree = new BTree<CompositeKey>(relationName, outIndexName, bufMgrIn, attributes, fillFactor, compressLeaves,
+                                       redistributeLeaves, buildThreads);
+        break;
+    default:
+        throw BadIndexInfoException("keys of the attribute type cannot be indexed");
+    }
+}
 
-        // set new node's level
-        // std::cout<<"fullNodeLEVEL: "<<fullNode->level<<std::endl;
-        newNode->level = fullNode->level;
+// -----------------------------------------------------------------------------
+// BTreeIndex::checkKeyType
+// -----------------------------------------------------------------------------
 
-        // set all in the new page to be NULL
-        newNode->pageNoArray[INTARRAYNONLEAFSIZE];
-        for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
-        {
-            newNode->keyArray[i] = INT32_MAX;
-            newNode->pageNoArray[i] = NULL;
-        }
+void BTreeIndex::checkKeyType(const Datatype type) const
+{
+    if (type != attributeType)
+    {
+        throw BadIndexInfoException("keys are not of the attribute type");
+    }
+}
 
-        //get the middle value and index from the page
-        this->findMiddle(fullPage, false, keyPtr, middleIndex);
+// -----------------------------------------------------------------------------
+// BTreeCursor::BTreeCursor -- Constructor
+// -----------------------------------------------------------------------------
 
-        //the keyPtr we are trying to insert is the middle one
-        if (*((int *)keyPtr) == middleInt)
-        {
-            newNode->pageNoArray[0] = newPageIdChild;
+BTreeCursor::BTreeCursor()
+{
+}
 
-            for (int i = middleIndex + 1; i < INTARRAYNONLEAFSIZE; i++)
-            {
-                newNode->keyArray[i - middleIndex - 1] = fullNode->keyArray[i];
-                fullNode->keyArray[i] = INT32_MAX;
-                newNode->pageNoArray[i - middleIndex] = fullNode->pageNoArray[i + 1];
-            }
-        }
-        else
-        {
-            for (int i = middleIndex + 1; i < INTARRAYNONLEAFSIZE; i++)
-            {
-                newNode->keyArray[i - middleIndex - 1] = fullNode->keyArray[i];
-                fullNode->keyArray[i] = INT32_MAX;
-                newNode->pageNoArray[i - middleIndex - 1] = fullNode->pageNoArray[i];
-            }
-            newNode->pageNoArray[INTARRAYNONLEAFSIZE - middleIndex - 1] = fullNode->pageNoArray[INTARRAYNONLEAFSIZE];
-        }
+BTreeCursor::BTreeCursor(BTreeScanBase *scan)
+    : scan(scan)
+{
+}
 
-        //unpin the page that was created
-        bufMgr->unPinPage(file, newPageId, true);
-    }
+BTreeCursor::BTreeCursor(BTreeCursor &&other) noexcept
+    : scan(std::move(other.scan))
+{
+}
+
+BTreeCursor &BTreeCursor::operator=(BTreeCursor &&other) noexcept
+{
+    scan = std::move(other.scan);
+    return *this;
 }
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::findMiddle()
+// BTreeCursor::~BTreeCursor -- destructor
 // -----------------------------------------------------------------------------
-//
-const void BTreeIndex::findMiddle(Page *page, bool isLeaf, const void *keyPtr, int &middleIndex)
+
+BTreeCursor::~BTreeCursor()
 {
-    if (isLeaf)
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNext
+// -----------------------------------------------------------------------------
+
+const void BTreeCursor::scanNext(RecordId &outRid)
+{
+    if (scan == nullptr)
     {
-        LeafNodeInt *leaf = (LeafNodeInt *)page;
-        if (INTARRAYLEAFSIZE % 2 == 0)
-        {
-            if (*((int *)keyPtr) > leaf->keyArray[INTARRAYLEAFSIZE / 2 - 1] && *((int *)keyPtr) < leaf->keyArray[INTARRAYLEAFSIZE / 2])
-            {
-                middleInt = *((int *)keyPtr);
-                middleIndex = INTARRAYLEAFSIZE / 2;
-            }
-            else if (*((int *)keyPtr) > leaf->keyArray[INTARRAYLEAFSIZE / 2])
-            {
-                middleInt = (leaf->keyArray[INTARRAYLEAFSIZE / 2]);
-                middleIndex = INTARRAYLEAFSIZE / 2;
-            }
-            else
-            {
-                middleInt = (leaf->keyArray[INTARRAYLEAFSIZE / 2 - 1]);
-                middleIndex = INTARRAYLEAFSIZE / 2 - 1;
-            }
-        }
-        else
-        {
-            middleInt = (leaf->keyArray[INTARRAYLEAFSIZE / 2]);
-            middleIndex = INTARRAYLEAFSIZE / 2;
-        }
+        throw ScanNotInitializedException();
     }
-    else //non leaf
+    scan->scanNext(outRid);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeCursor::scanNextBatch
+// -----------------------------------------------------------------------------
+
+size_t BTreeCursor::scanNextBatch(RecordId *out, void *keysOut, const size_t max)
+{
+    if (scan == nullptr)
     {
-        // current node and key
-        NonLeafNodeInt *node = (NonLeafNodeInt *)page;
+        throw ScanNotInitializedException();
+    }
+    return scan->scanNextBatch(out, keysOut, max);
+}
 
-        if (INTARRAYNONLEAFSIZE % 2 == 0)
-        {
-            if (*((int *)keyPtr) > node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1] && *((int *)keyPtr) < node->keyArray[INTARRAYNONLEAFSIZE / 2])
-            {
-                middleInt = *((int *)keyPtr);
-                middleIndex = INTARRAYNONLEAFSIZE / 2 - 1;
-            }
-            else if (*((int *)keyPtr) > node->keyArray[INTARRAYNONLEAFSIZE / 2])
-            {
-                middleInt = (node->keyArray[INTARRAYNONLEAFSIZE / 2]);
-                middleIndex = INTARRAYNONLEAFSIZE / 2;
-            }
-            else if (*((int *)keyPtr) < node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1])
-            {
-                middleInt = (node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1]);
-                middleIndex = INTARRAYNONLEAFSIZE / 2 - 1;
-            }
-            // assume no duplicate
-        }
-        else
-        {
-            if (*((int *)keyPtr) > node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1] && *((int *)keyPtr) < node->keyArray[INTARRAYNONLEAFSIZE / 2])
-            {
-                middleInt = *((int *)keyPtr);
-                middleIndex = INTARRAYNONLEAFSIZE / 2 - 1;
-            }
-            else if (*((int *)keyPtr) > node->keyArray[INTARRAYNONLEAFSIZE / 2] && *((int *)keyPtr) < node->keyArray[INTARRAYNONLEAFSIZE / 2 + 1])
-            {
-                middleInt = *((int *)keyPtr);
-                middleIndex = INTARRAYNONLEAFSIZE / 2;
-            }
-            else if (*((int *)keyPtr) < node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1])
-            {
-                middleInt = (node->keyArray[INTARRAYNONLEAFSIZE / 2 - 1]);
-                middleIndex = INTARRAYNONLEAFSIZE / 2 - 1;
-            }
-            else if (*((int *)keyPtr) > node->keyArray[INTARRAYNONLEAFSIZE / 2])
-            {
-                middleInt = (node->keyArray[INTARRAYNONLEAFSIZE / 2]);
-                middleIndex = INTARRAYNONLEAFSIZE / 2;
-            }
-            // assume no duplicate
-        }
+// -----------------------------------------------------------------------------
+// BTreeCursor::endScan
+// -----------------------------------------------------------------------------
+
+const void BTreeCursor::endScan()
+{
+    if (scan == nullptr)
+    {
+        throw ScanNotInitializedException();
     }
+    scan->endScan();
 }
 
+// every node of every key type fits on a page
+static_assert(sizeof(NonLeafNode<int>) <= Page::SIZE && sizeof(LeafNode<int>) <= Page::SIZE &&
+                  sizeof(PackedLeafNode<int>) <= Page::SIZE, "INTEGER nodes do not fit on a page");
+static_assert(sizeof(NonLeafNode<long long>) <= Page::SIZE && sizeof(LeafNode<long long>) <= Page::SIZE &&
+                  sizeof(PackedLeafNode<long long>) <= Page::SIZE, "BIGINT nodes do not fit on a page");
+static_assert(sizeof(NonLeafNode<double>) <= Page::SIZE && sizeof(LeafNode<double>) <= Page::SIZE,
+              "DOUBLE nodes do not fit on a page");
+static_assert(sizeof(NonLeafNode<StringKey>) <= Page::SIZE && sizeof(LeafNode<StringKey>) <= Page::SIZE,
+              "STRING nodes do not fit on a page");
+static_assert(sizeof(NonLeafNode<CompositeKey>) <= Page::SIZE && sizeof(LeafNode<CompositeKey>) <= Page::SIZE,
+              "COMPOSITE nodes do not fit on a page");
+
+template class BTree<int>;
+template class BTree<long long>;
+template class BTree<double>;
+template class BTree<StringKey>;
+template class BTree<CompositeKey>;
+
+template class BTreeScan<int>;
+template class BTreeScan<long long>;
+template class BTreeScan<double>;
+template class BTreeScan<StringKey>;
+template class BTreeScan<CompositeKey>;
+
 } // namespace badgerdb
@@ -11,6 +11,14 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
 
 #include "types.h"
 #include "page.h"
@@ -27,7 +35,9 @@ enum Datatype
 {
   INTEGER = 0,
   DOUBLE = 1,
-  STRING = 2
+  STRING = 2,
+  BIGINT = 3,
+  COMPOSITE = 4
 };
 
 /**
@@ -42,282 +52,2637 @@ enum Operator
 };
 
 /**
- * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ * @brief Order in which a scan returns the entries of its range. Passed to BTreeIndex::startScan() method.
  */
-//                                                  sibling ptr             key               rid
-const int INTARRAYLEAFSIZE = (Page::SIZE - sizeof(PageId)) / (sizeof(int) + sizeof(RecordId));
+enum ScanOrder
+{
+  ASCENDING,  /* From the low bound up */
+  DESCENDING  /* From the high bound down */
+};
 
 /**
- * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ * @brief Largest difference between a key on a packed leaf and the leaf's base key. 0xFFFF pads the empty slots.
  */
-//                                                     level     extra pageNo                  key       pageNo
-const int INTARRAYNONLEAFSIZE = (Page::SIZE - sizeof(int) - sizeof(PageId)) / (sizeof(int) + sizeof(PageId));
+const int PACKED_MAX_DELTA = 0xFFFE;
 
 /**
- * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that
- * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
+ * @brief Slot number of the rid of a leaf entry that stands for a posting list: the page number of the rid is the
+ * first page of the list. No record of a relation is in that slot.
  */
-template <class T>
-class RIDKeyPair
+const SlotId POSTING_SLOT = 0xFFFF;
+
+/**
+ * @brief Number of bytes of encoded record ids on a posting page.
+ */
+//                                                 links, last page      total, count, size          first, last rid
+const int POSTINGDATASIZE = Page::SIZE - 3 * sizeof(PageId) - 3 * sizeof(int) - 2 * sizeof(RecordId);
+
+/**
+ * @brief Default fraction of the key slots filled in every node written by the bulk loader.
+ */
+const double DEFAULT_FILL_FACTOR = 1.0;
+
+/**
+ * @brief Fraction of its key slots a leaf keeps when it splits because entries are added after its last key,
+ * unless it is the last leaf, which keeps them all: keys inserted in ascending order leave full leaves behind.
+ */
+const double APPEND_SPLIT_FILL = 0.9;
+
+/**
+ * @brief Default number of threads that extract and sort the keys of the relation when an index is bulk loaded:
+ * 0, for one per hardware thread.
+ */
+const int DEFAULT_BUILD_THREADS = 0;
+
+/**
+ * @brief Fewest pages of the relation each of those threads reads, so that a small relation is read by one.
+ */
+const int BUILD_MIN_PAGES = 64;
+
+/**
+ * @brief Default number of leaves a scan reads ahead of the leaf it is on.
+ */
+const int DEFAULT_READ_AHEAD = 2;
+
+/**
+ * @brief Number of page numbers in each chunk of the table of cached node frames.
+ */
+const int NODE_CACHE_CHUNK = 1024;
+
+/**
+ * @brief Number of chunks in the table of cached node frames, which covers page numbers up to their product.
+ */
+const int NODE_CACHE_CHUNKS = 4096;
+
+/**
+ * @brief Percentage of the buffer pool's frames the indexes sharing it may keep pinned, all together, for their
+ * cached non-leaf nodes.
+ */
+const int NODE_CACHE_POOL_PERCENT = 25;
+
+/**
+ * @brief Largest number of leaves a scan reads ahead. The read-ahead of a long scan doubles up to this,
+ * or up to READ_AHEAD_POOL_PERCENT of the buffer pool if that is less.
+ */
+const int MAX_READ_AHEAD = 32;
+
+/**
+ * @brief Percentage of the buffer pool's frames a scan may read ahead into. Leaves read ahead are not pinned,
+ * and have to stay in the pool until the scan reaches them.
+ */
+const int READ_AHEAD_POOL_PERCENT = 10;
+
+/**
+ * @brief Number of bytes of a string a STRING key keeps.
+ */
+const int STRINGSIZE = 16;
+
+/**
+ * @brief Largest number of attributes a COMPOSITE index is built over.
+ */
+const int MAX_KEY_ATTRIBUTES = 4;
+
+/**
+ * @brief Number of bytes of a COMPOSITE key, which the normalized values of its attributes have to fit in.
+ */
+const int COMPOSITESIZE = 24;
+
+/**
+ * @brief What the tree needs to know about a key type beyond its order: the Datatype it is indexed as, the value
+ * that pads the empty key slots of a node and the high key of the last node of a level, above every key stored,
+ * the largest key below it, and whether leaves may pack its keys as 16 bit deltas. The padding itself cannot be
+ * stored as a key. It also makes the key of an attribute value, whether passed to the index or read from a record,
+ * and tells whether the key holds the whole value: values whose key does not can tie on it, and are then told
+ * apart by comparing the attribute in their records. Nodes store keys as Stored, a type of the same size whose
+ * natural order is that of the keys, so that every key type is searched by an integer or memcmp kernel.
+ */
+template <class K>
+struct KeyTraits;
+
+/**
+ * @brief The parts of KeyTraits shared by the key types that are the attribute values themselves.
+ */
+template <class K>
+struct ScalarKeyTraits
 {
-public:
-  RecordId rid;
-  T key;
-  void set(RecordId r, T k)
+  /**
+   * Form the nodes store the keys in: the key itself.
+   */
+  typedef K Stored;
+
+  static Stored normalize(const K key)
   {
-    rid = r;
-    key = k;
+    return key;
+  }
+
+  static K denormalize(const Stored stored)
+  {
+    return stored;
+  }
+
+  /**
+   * Key of a value passed to the index, which points at a K.
+   */
+  static K fromValue(const void *value)
+  {
+    return *(const K *)value;
+  }
+
+  /**
+   * Whether the key cannot be indexed: it is the one that pads the nodes. No entry has it, and as a bound it stands
+   * for the top of the order.
+   */
+  static bool unindexable(const K key)
+  {
+    return key == KeyTraits<K>::max();
+  }
+
+  /**
+   * The i-th of the values passed to the index in an array, of K.
+   */
+  static const void *value(const void *values, const size_t i)
+  {
+    return (const K *)values + i;
+  }
+
+  /**
+   * Key of the attribute at the given address of a record, of which length bytes are left from there.
+   */
+  static K fromRecord(const char *field, const size_t length)
+  {
+    K key;
+    memcpy(&key, field, sizeof(K));
+    return key;
+  }
+
+  /**
+   * Whether the key of the value is the whole value.
+   */
+  static bool whole(const void *value)
+  {
+    return true;
+  }
+
+  /**
+   * Compare the attribute at the given address of a record, of which length bytes are left from there, with a value
+   * passed to the index: negative, zero or positive as the attribute is below, equal to or above the value.
+   */
+  static int compare(const char *field, const size_t length, const void *value)
+  {
+    K key = fromRecord(field, length);
+    K other = fromValue(value);
+    return (key < other) ? -1 : (other < key) ? 1 : 0;
+  }
+
+  /**
+   * Key to post to a parent between two neighbouring nodes whose keys end with left and start with right: above left
+   * and at most right. The node on the right keeps it as its high key.
+   */
+  static K separator(const K left, const K right)
+  {
+    return right;
   }
 };
 
 /**
- * @brief Structure to store a key page pair which is used to pass the key and page to functions that make
- * any modifications to the non leaf pages of the tree.
-*/
-template <class T>
-class PageKeyPair
+ * @brief INTEGER keys: 32 bit ints.
+ */
+template <>
+struct KeyTraits<int> : ScalarKeyTraits<int>
 {
-public:
-  PageId pageNo;
-  T key;
-  void set(int p, T k)
+  static const Datatype TYPE = INTEGER;
+  static const bool PACKABLE = true;
+  static int max()
   {
-    pageNo = p;
-    key = k;
+    return INT32_MAX;
+  }
+  static int greatest()
+  {
+    return INT32_MAX - 1;
+  }
+  static int lowest()
+  {
+    return INT32_MIN;
   }
 };
 
 /**
- * @brief Overloaded operator to compare the key values of two rid-key pairs
- * and if they are the same compares to see if the first pair has
- * a smaller rid.pageNo value.
-*/
-template <class T>
-bool operator<(const RIDKeyPair<T> &r1, const RIDKeyPair<T> &r2)
+ * @brief BIGINT keys: 64 bit ints.
+ */
+template <>
+struct KeyTraits<long long> : ScalarKeyTraits<long long>
 {
-  if (r1.key != r2.key)
-    return r1.key < r2.key;
-  else
-    return r1.rid.page_number < r2.rid.page_number;
-}
+  static const Datatype TYPE = BIGINT;
+  static const bool PACKABLE = true;
+  static long long max()
+  {
+    return INT64_MAX;
+  }
+  static long long greatest()
+  {
+    return INT64_MAX - 1;
+  }
+  static long long lowest()
+  {
+    return INT64_MIN;
+  }
+};
 
 /**
- * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
- * to the following structure to store or retrieve information from it.
- * Contains the relation name for which the index is created, the byte offset
- * of the key value on which the index is made, the type of the key and the page no
- * of the root page. Root page starts as page 2 but since a split can occur
- * at the root the root page may get moved up and get a new page no.
-*/
-struct IndexMetaInfo
+ * @brief DOUBLE keys. +Infinity pads the nodes, and NaN has no place in their order: neither can be indexed.
+ * Inserting either, or building an index over a relation that has it, throws BadIndexInfoException; as a bound
+ * either takes in every finite key, and looking either up finds nothing.
+ * Nodes store a key as the 64 bit int of its IEEE bits, with all bits but the sign flipped for negative keys, which
+ * orders the ints as the doubles: the node search is that of BIGINT keys. -0.0 is stored, and read back, as 0.0.
+ * Leaves are never packed.
+ */
+template <>
+struct KeyTraits<double> : ScalarKeyTraits<double>
+{
+  static const Datatype TYPE = DOUBLE;
+  static const bool PACKABLE = false;
+  typedef long long Stored;
+  static Stored normalize(const double key)
+  {
+    long long bits;
+    double value = (key == 0.0) ? 0.0 : key;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits < 0) ? bits ^ INT64_MAX : bits;
+  }
+  static double denormalize(const Stored stored)
+  {
+    long long bits = (stored < 0) ? stored ^ INT64_MAX : stored;
+    double key;
+    memcpy(&key, &bits, sizeof(key));
+    return key;
+  }
+  static double max()
+  {
+    return std::numeric_limits<double>::infinity();
+  }
+  static double greatest()
+  {
+    return std::numeric_limits<double>::max();
+  }
+  static double lowest()
+  {
+    return -std::numeric_limits<double>::infinity();
+  }
+  static bool unindexable(const double key)
+  {
+    return key == max() || std::isnan(key);
+  }
+};
+
+/**
+ * @brief Key of a STRING attribute: the first STRINGSIZE bytes of the string, up to its terminating NUL, padded with
+ * zeroes. The bytes compare unsigned, in the order of the strings, so a key is compared with memcmp and never turned
+ * back into a string. Strings that share the first STRINGSIZE bytes have the same key; the index tells them apart
+ * by the strings in their records. @see StringKey::of
+ */
+struct StringKey
 {
   /**
-   * Name of base relation.
+   * The bytes kept.
    */
-  char relationName[20];
+  unsigned char bytes[STRINGSIZE];
 
   /**
-   * Offset of attribute, over which index is built, inside the record stored in pages.
+   * Key of a NUL terminated string, of which at most STRINGSIZE bytes are read.
    */
-  int attrByteOffset;
+  static StringKey of(const char *s)
+  {
+    return of(s, STRINGSIZE);
+  }
 
   /**
-   * Type of the attribute over which index is built.
+   * Key of a string ending at its terminating NUL or after length bytes, of which at most STRINGSIZE bytes are read.
+   * A string whose key would be the padding of the nodes gets the key right below it.
    */
-  Datatype attrType;
+  static StringKey of(const char *s, const size_t length)
+  {
+    StringKey key;
+    size_t size = strnlen(s, std::min(length, (size_t)STRINGSIZE));
+    memcpy(key.bytes, s, size);
+    memset(key.bytes + size, 0, STRINGSIZE - size);
+    if (size == STRINGSIZE && key.bytes[STRINGSIZE - 1] == 0xFF &&
+        std::count(key.bytes, key.bytes + STRINGSIZE, 0xFF) == STRINGSIZE)
+    {
+      key.bytes[STRINGSIZE - 1] = 0xFE;
+    }
+    return key;
+  }
+};
+
+inline bool operator==(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) == 0;
+}
+
+inline bool operator!=(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) != 0;
+}
+
+inline bool operator<(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) < 0;
+}
+
+inline bool operator>(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) > 0;
+}
+
+inline bool operator<=(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) <= 0;
+}
+
+inline bool operator>=(const StringKey &k1, const StringKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, STRINGSIZE) >= 0;
+}
+
+/**
+ * @brief STRING keys. Values passed to the index are NUL terminated strings, and an array of them is an array of
+ * pointers to such strings; keys the index hands back are StringKeys. A key holds the whole string if the string is
+ * shorter than STRINGSIZE bytes. Leaves are never packed.
+ */
+template <>
+struct KeyTraits<StringKey>
+{
+  static const Datatype TYPE = STRING;
+  static const bool PACKABLE = false;
+  typedef StringKey Stored;
+  static Stored normalize(const StringKey &key)
+  {
+    return key;
+  }
+  static StringKey denormalize(const Stored &stored)
+  {
+    return stored;
+  }
+  static StringKey max()
+  {
+    StringKey key;
+    memset(key.bytes, 0xFF, STRINGSIZE);
+    return key;
+  }
+  static StringKey greatest()
+  {
+    StringKey key = max();
+    key.bytes[STRINGSIZE - 1] = 0xFE;
+    return key;
+  }
+  static StringKey lowest()
+  {
+    StringKey key;
+    memset(key.bytes, 0, STRINGSIZE);
+    return key;
+  }
+  static StringKey fromValue(const void *value)
+  {
+    return StringKey::of((const char *)value);
+  }
+  static bool unindexable(const StringKey &key)
+  {
+    return key == max();
+  }
+  static const void *value(const void *values, const size_t i)
+  {
+    return ((const char *const *)values)[i];
+  }
+  static StringKey fromRecord(const char *field, const size_t length)
+  {
+    return StringKey::of(field, length);
+  }
+  static bool whole(const void *value)
+  {
+    return strnlen((const char *)value, STRINGSIZE) < (size_t)STRINGSIZE;
+  }
+  static int compare(const char *field, const size_t length, const void *value)
+  {
+    size_t size = strnlen(field, length);
+    size_t valueSize = strlen((const char *)value);
+    int c = memcmp(field, value, std::min(size, valueSize));
+    return (c != 0) ? c : (size < valueSize) ? -1 : (size > valueSize) ? 1 : 0;
+  }
 
   /**
-   * Page number of root page of the B+ Tree inside the file index file.
+   * The bytes of right up to the first one it differs from left in, padded with zeros: the shortest key above left and
+   * at most right, so that the non-leaf nodes have fewer bytes of each key to store.
    */
-  PageId rootPageNo;
+  static StringKey separator(const StringKey &left, const StringKey &right)
+  {
+    StringKey key = right;
+    int i = 0;
+    while (i < STRINGSIZE && left.bytes[i] == right.bytes[i])
+    {
+      i++;
+    }
+    if (i < STRINGSIZE - 1)
+    {
+      memset(key.bytes + i + 1, 0, STRINGSIZE - i - 1);
+    }
+    return key;
+  }
 };
 
-/*
-Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
-These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of
-node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes
-at this level are just above the leaf nodes. Otherwise set to 0.
-*/
+/**
+ * @brief One attribute an index is built over: its offset in the records and its type, which is INTEGER, BIGINT,
+ * DOUBLE or STRING.
+ */
+struct KeyAttribute
+{
+  int offset;
+  Datatype type;
+};
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
-*/
-struct NonLeafNodeInt
+ * @brief Key of a COMPOSITE index: the normalized values of its attributes one after the other, padded with zeroes.
+ * INTEGER and BIGINT values take 4 and 8 bytes, big-endian with the sign bit flipped, DOUBLE values the 8 bytes
+ * of their normalized int the same way, and STRING values the STRINGSIZE bytes of their StringKey. The bytes compare
+ * unsigned in the order of the values, attribute by attribute, so a key is compared with memcmp. Strings that share
+ * their first STRINGSIZE bytes are the same value to the index. @see CompositeKey::of
+ */
+struct CompositeKey
 {
   /**
-   * Level of the node in the tree.
+   * The normalized values.
    */
-  int level;
+  unsigned char bytes[COMPOSITESIZE];
+
+  /**
+   * Number of bytes a value of the type takes in a key, 0 for a type that cannot be part of one.
+   */
+  static int width(const Datatype type)
+  {
+    switch (type)
+    {
+    case INTEGER:
+      return sizeof(int);
+    case BIGINT:
+    case DOUBLE:
+      return sizeof(long long);
+    case STRING:
+      return STRINGSIZE;
+    default:
+      return 0;
+    }
+  }
+
+  /**
+   * Key of the values of the first count attributes, each passed by pointer to a value of its type: an int,
+   * long long or double, or a NUL terminated string. The attributes after them take their lowest values, which makes
+   * it the first key with those values, the low bound of a scan over an equality prefix. A key that would be the
+   * padding of the nodes gets the key right below it.
+   */
+  static CompositeKey of(const std::vector<KeyAttribute> &attributes, const void *const *values, const size_t count)
+  {
+    CompositeKey key;
+    memset(key.bytes, 0, COMPOSITESIZE);
+    int at = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      switch (attributes[i].type)
+      {
+      case INTEGER:
+      {
+        int value;
+        memcpy(&value, values[i], sizeof(int));
+        putBigEndian(key.bytes + at, (std::uint32_t)value ^ 0x80000000u, sizeof(int));
+        break;
+      }
+      case BIGINT:
+      {
+        long long value;
+        memcpy(&value, values[i], sizeof(long long));
+        putBigEndian(key.bytes + at, (std::uint64_t)value ^ 0x8000000000000000ull, sizeof(long long));
+        break;
+      }
+      case DOUBLE:
+      {
+        // the order-preserving int DOUBLE nodes store the value as
+        double value;
+        memcpy(&value, values[i], sizeof(double));
+        long long normalized = KeyTraits<double>::normalize(value);
+        putBigEndian(key.bytes + at, (std::uint64_t)normalized ^ 0x8000000000000000ull, sizeof(long long));
+        break;
+      }
+      case STRING:
+      {
+        const char *s = (const char *)values[i];
+        size_t size = strnlen(s, STRINGSIZE);
+        memcpy(key.bytes + at, s, size);
+        break;
+      }
+      default:
+        break;
+      }
+      at += width(attributes[i].type);
+    }
+    if (std::count(key.bytes, key.bytes + COMPOSITESIZE, 0xFF) == COMPOSITESIZE)
+    {
+      key.bytes[COMPOSITESIZE - 1] = 0xFE;
+    }
+    return key;
+  }
+
+  /**
+   * The last key with the values of the first count attributes, as CompositeKey::of takes them: the attributes after
+   * them take their highest values. The high bound of a scan over an equality prefix.
+   */
+  static CompositeKey last(const std::vector<KeyAttribute> &attributes, const void *const *values, const size_t count)
+  {
+    CompositeKey key = of(attributes, values, count);
+    int at = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      at += width(attributes[i].type);
+    }
+    memset(key.bytes + at, 0xFF, COMPOSITESIZE - at);
+    if (std::count(key.bytes, key.bytes + COMPOSITESIZE, 0xFF) == COMPOSITESIZE)
+    {
+      key.bytes[COMPOSITESIZE - 1] = 0xFE;
+    }
+    return key;
+  }
+
+private:
+  static void putBigEndian(unsigned char *out, std::uint64_t value, const int size)
+  {
+    for (int i = size - 1; i >= 0; i--)
+    {
+      out[i] = (unsigned char)value;
+      value >>= 8;
+    }
+  }
+};
+
+inline bool operator==(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) == 0;
+}
+
+inline bool operator!=(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) != 0;
+}
+
+inline bool operator<(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) < 0;
+}
+
+inline bool operator>(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) > 0;
+}
+
+inline bool operator<=(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) <= 0;
+}
+
+inline bool operator>=(const CompositeKey &k1, const CompositeKey &k2)
+{
+  return memcmp(k1.bytes, k2.bytes, COMPOSITESIZE) >= 0;
+}
+
+/**
+ * @brief COMPOSITE keys. Values passed to the index are CompositeKeys, made with CompositeKey::of or
+ * CompositeKey::last, and an array of them is an array of CompositeKeys; keys the index hands back are CompositeKeys.
+ * A key always holds the whole of the values as the index sees them. The index makes the key of a record from
+ * the attributes it was built over, see BTree::recordKey. Leaves are never packed.
+ */
+template <>
+struct KeyTraits<CompositeKey>
+{
+  static const Datatype TYPE = COMPOSITE;
+  static const bool PACKABLE = false;
+  typedef CompositeKey Stored;
+  static Stored normalize(const CompositeKey &key)
+  {
+    return key;
+  }
+  static CompositeKey denormalize(const Stored &stored)
+  {
+    return stored;
+  }
+  static CompositeKey max()
+  {
+    CompositeKey key;
+    memset(key.bytes, 0xFF, COMPOSITESIZE);
+    return key;
+  }
+  static CompositeKey greatest()
+  {
+    CompositeKey key = max();
+    key.bytes[COMPOSITESIZE - 1] = 0xFE;
+    return key;
+  }
+  static CompositeKey lowest()
+  {
+    CompositeKey key;
+    memset(key.bytes, 0, COMPOSITESIZE);
+    return key;
+  }
+  static CompositeKey fromValue(const void *value)
+  {
+    return *(const CompositeKey *)value;
+  }
+  static bool unindexable(const CompositeKey &key)
+  {
+    return key == max();
+  }
+  static const void *value(const void *values, const size_t i)
+  {
+    return (const CompositeKey *)values + i;
+  }
+  static bool whole(const void *value)
+  {
+    return true;
+  }
+
+  /**
+   * Keys are whole, so no record is ever compared with a value.
+   */
+  static int compare(const char *field, const size_t length, const void *value)
+  {
+    return 0;
+  }
+  static CompositeKey separator(const CompositeKey &left, const CompositeKey &right)
+  {
+    return right;
+  }
+};
+
+/**
+ * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that
+ * add to or make changes to the leaf node pages of the tree. Is templated for the key member.
+ */
+template <class T>
+class RIDKeyPair
+{
+public:
+  RecordId rid;
+  T key;
+  void set(RecordId r, T k)
+  {
+    rid = r;
+    key = k;
+  }
+};
+
+/**
+ * @brief Structure to store a key page pair which is used to pass the key and page to functions that make
+ * any modifications to the non leaf pages of the tree.
+*/
+template <class T>
+class PageKeyPair
+{
+public:
+  PageId pageNo;
+  T key;
+  void set(int p, T k)
+  {
+    pageNo = p;
+    key = k;
+  }
+};
+
+/**
+ * @brief Overloaded operator to compare the key values of two rid-key pairs
+ * and if they are the same compares their rids, page number first and slot number next.
+ * This is the order of the entries in the index, equal keys included.
+*/
+template <class T>
+bool operator<(const RIDKeyPair<T> &r1, const RIDKeyPair<T> &r2)
+{
+  if (r1.key != r2.key)
+    return r1.key < r2.key;
+  else if (r1.rid.page_number != r2.rid.page_number)
+    return r1.rid.page_number < r2.rid.page_number;
+  else
+    return r1.rid.slot_number < r2.rid.slot_number;
+}
+
+/**
+ * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
+ * to the following structure to store or retrieve information from it.
+ * Contains the relation name for which the index is created, the byte offset
+ * of the key value on which the index is made, the type of the key and the page no
+ * of the root page. Root page starts as page 2 but since a split can occur
+ * at the root the root page may get moved up and get a new page no.
+*/
+struct IndexMetaInfo
+{
+  /**
+   * Name of base relation.
+   */
+  char relationName[20];
+
+  /**
+   * Offset of attribute, over which index is built, inside the record stored in pages.
+   */
+  int attrByteOffset;
+
+  /**
+   * Type of the attribute over which index is built.
+   */
+  Datatype attrType;
+
+  /**
+   * Page number of root page of the B+ Tree inside the file index file.
+   */
+  PageId rootPageNo;
+
+  /**
+   * Page number of the first page freed by a delete, Page::INVALID_NUMBER if there is none.
+   */
+  PageId freePageNo;
+
+  /**
+   * Whether leaves whose keys fit are written packed.
+   */
+  bool compressLeaves;
+
+  /**
+   * Whether a leaf that overflows on insert shares its entries with a sibling before it splits.
+   */
+  bool redistributeLeaves;
+
+  /**
+   * Number of attributes the index is built over: more than one for a COMPOSITE index, whose attrByteOffset is
+   * that of the first of them.
+   */
+  int attrCount;
+
+  /**
+   * Offset and type of each attribute of a COMPOSITE index, in the order their values make its keys.
+   */
+  KeyAttribute attributes[MAX_KEY_ATTRIBUTES];
+};
+
+/*
+Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
+These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of
+node they are. The level memeber of each non leaf structure seen below is the height of the node above the leaves:
+1 if the nodes at this level are just above the leaf nodes, 2 for the level above that, and so on.
+
+The tree is a B-link tree: every node, leaf or not, has a high key and a link to its right neighbour on the same level.
+Every key stored under a node is below its high key, and every key from the high key up is stored under the nodes to its
+right. A node splits by moving its upper entries to new nodes linked in on its right and lowering its high key; the
+separators of the new nodes are posted to the parent afterwards. Until then a search that reaches the node with a key
+at or above its high key follows the right link, so a split never has to hold the parent.
+
+Entries with equal keys are ordered on their rids, and never span two leaves: a leaf holds fewer than POSTING_MIN
+entries with one key, and moves all of them to a posting list once they reach it. The posting list takes a single slot,
+whose rid points at the first of a chain of posting pages holding the key's record ids in order, delta-encoded.
+Posting pages only change with the latch of the leaf holding their list.
+
+Every non-leaf node also counts the entries under each of its children, including those under the nodes split off a child
+whose separators are not posted yet: the count belongs to the key range between two separators, not to a page. A range
+count adds up the counts of the children left of the bound on the way down to the leaf holding it, and reads no other leaf.
+*/
+
+/**
+ * @brief Structure for all non-leaf nodes, with keys of type K.
+*/
+template <class K>
+struct NonLeafNode
+{
+  /**
+   * Number of key slots.
+   */
+  //                                         high key     level, extra count   right link, extra pageNo        key         count          pageNo
+  static const int CAPACITY = (Page::SIZE - sizeof(K) - 2 * sizeof(int) - 2 * sizeof(PageId)) / (sizeof(K) + sizeof(int) + sizeof(PageId));
+
+  /**
+   * Fewest keys a non-leaf other than the root may hold after a delete before it borrows from or merges with a sibling.
+   */
+  static const int MIN = CAPACITY / 2;
+
+  /**
+   * Level of the node in the tree.
+   */
+  int level;
+
+  /**
+   * Page number of the node on the right side on the same level, Page::INVALID_NUMBER for the last node of its level.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Every key under the node is below this one. KeyTraits<K>::max() for the last node of its level.
+   */
+  K highKey;
+
+  /**
+   * Stores keys, normalized.
+   */
+  typename KeyTraits<K>::Stored keyArray[CAPACITY];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   */
+  PageId pageNoArray[CAPACITY + 1];
+
+  /**
+   * Number of entries under each child, and under the nodes split off it whose separators are not posted yet.
+   */
+  int countArray[CAPACITY + 1];
+};
+
+template <class K>
+const int NonLeafNode<K>::CAPACITY;
+
+template <class K>
+const int NonLeafNode<K>::MIN;
+
+/**
+ * @brief Non-leaf node with STRING keys. Its keys share a prefix, stored once, and are zero from some byte on, so only the
+ * bytes between are stored for each key, as many for all of them: the more the keys have in common, the more of them
+ * fit. The separators posted from the leaves are cut short to make that likely. The children keep the slots of every
+ * other non-leaf, after the key count and the prefix, and the key bytes fill the rest of the page.
+ */
+template <>
+struct NonLeafNode<StringKey>
+{
+  /**
+   * Bytes stored for each key at which CAPACITY keys fill the node.
+   */
+  static const int SUFFIXSIZE = 5;
+
+  /**
+   * Most keys a node holds: as many fit if they are stored in SUFFIXSIZE bytes or fewer after their prefix.
+   */
+  //                                         high key, prefix      level, key count, prefix and suffix length, extra count   right link, extra pageNo        key         count          pageNo
+  static const int CAPACITY = (Page::SIZE - 2 * STRINGSIZE - 5 * sizeof(int) - 2 * sizeof(PageId)) / (SUFFIXSIZE + sizeof(int) + sizeof(PageId));
+
+  /**
+   * Number of bytes for the key suffixes.
+   */
+  static const int KEYSPACE = Page::SIZE - 2 * STRINGSIZE - 4 * sizeof(int) - sizeof(PageId) -
+                              (CAPACITY + 1) * (sizeof(int) + sizeof(PageId));
+
+  /**
+   * Fewest keys a non-leaf other than the root may hold after a delete. Half the keys that fit however long they are,
+   * so that two nodes below it always merge into one.
+   */
+  static const int MIN = KEYSPACE / STRINGSIZE / 2;
+
+  /**
+   * Level of the node in the tree.
+   */
+  int level;
+
+  /**
+   * Page number of the node on the right side on the same level, Page::INVALID_NUMBER for the last node of its level.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Every key under the node is below this one. KeyTraits<StringKey>::max() for the last node of its level.
+   */
+  StringKey highKey;
+
+  /**
+   * Number of keys.
+   */
+  int keyCount;
+
+  /**
+   * Number of leading bytes every key shares, stored once in prefix.
+   */
+  int prefixLength;
+
+  /**
+   * Number of bytes stored for each key after the prefix. The bytes after those are zero.
+   */
+  int suffixLength;
+
+  /**
+   * Leading bytes of every key.
+   */
+  unsigned char prefix[STRINGSIZE];
+
+  /**
+   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
+   */
+  PageId pageNoArray[CAPACITY + 1];
+
+  /**
+   * Number of entries under each child, and under the nodes split off it whose separators are not posted yet.
+   */
+  int countArray[CAPACITY + 1];
+
+  /**
+   * The suffixLength bytes after the prefix of each key, in order.
+   */
+  unsigned char suffixes[KEYSPACE];
+};
+
+/**
+ * @brief Structure for all leaf nodes, with keys of type K. The keys come after the 4 byte fields of the header,
+ * so that it needs no padding for 8 byte keys.
+*/
+template <class K>
+struct LeafNode
+{
+  /**
+   * Number of key slots.
+   */
+  //                                          high key, base     sibling ptrs     posting entries, packed       key             rid
+  static const int CAPACITY = (Page::SIZE - 2 * sizeof(K) - 2 * sizeof(PageId) - 2 * sizeof(int)) / (sizeof(K) + sizeof(RecordId));
+
+  /**
+   * Fewest keys a leaf other than the only one may hold after a delete before it borrows from or merges with a sibling.
+   */
+  static const int MIN = CAPACITY / 2;
+
+  /**
+   * Number of entries with the same key at which a leaf moves them to a posting list. A leaf spends a key slot
+   * on every entry, while a posting list holds a key's record ids delta-encoded on pages of their own, so it only pays
+   * for keys that would fill a good part of a leaf. Keeping every other key under half a leaf lets a leaf always split
+   * between two keys.
+   */
+  static const int POSTING_MIN = CAPACITY / 2;
+
+  /**
+   * Page number of the leaf on the right side.
+     * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, for descending index scans.
+   */
+  PageId leftSibPageNo;
+
+  /**
+   * Number of entries the posting lists on the leaf hold beyond the one slot each of them takes.
+   */
+  int postingEntries;
+
+  /**
+   * Whether the leaf is laid out as a PackedLeafNode.
+   */
+  int packed;
+
+  /**
+   * Every key on the leaf is below this one. KeyTraits<K>::max() for the last leaf.
+   */
+  K highKey;
+
+  /**
+   * Key the deltas of a packed leaf are taken from.
+   */
+  K keyBase;
+
+  /**
+   * Stores keys, normalized.
+   */
+  typename KeyTraits<K>::Stored keyArray[CAPACITY];
+
+  /**
+   * Stores RecordIds.
+   */
+  RecordId ridArray[CAPACITY];
+};
+
+template <class K>
+const int LeafNode<K>::CAPACITY;
+
+template <class K>
+const int LeafNode<K>::MIN;
+
+template <class K>
+const int LeafNode<K>::POSTING_MIN;
+
+/**
+ * @brief Layout of a leaf of an index that compresses its leaves, used when every key on the leaf is within
+ * PACKED_MAX_DELTA of the first one. Keys are stored as 16 bit offsets from keyBase, which lets a leaf hold about a
+ * fifth more entries and be searched on its packed form. The header is the same as LeafNode's.
+ * Only integral keys are packed.
+*/
+template <class K>
+struct PackedLeafNode
+{
+  /**
+   * Number of key slots, kept even so that the rids stay aligned.
+   */
+  //                                           high key, base     sibling ptrs     posting entries, packed            delta                  rid
+  static const int CAPACITY = ((Page::SIZE - 2 * sizeof(K) - 2 * sizeof(PageId) - 2 * sizeof(int)) / (sizeof(std::uint16_t) + sizeof(RecordId))) & ~1;
+
+  /**
+   * Page number of the leaf on the right side.
+     * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
+   */
+  PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, for descending index scans.
+   */
+  PageId leftSibPageNo;
+
+  /**
+   * Number of entries the posting lists on the leaf hold beyond the one slot each of them takes.
+   */
+  int postingEntries;
+
+  /**
+   * Whether the leaf is laid out as a PackedLeafNode.
+   */
+  int packed;
+
+  /**
+   * Every key on the leaf is below this one. KeyTraits<K>::max() for the last leaf.
+   */
+  K highKey;
+
+  /**
+   * Key the deltas of a packed leaf are taken from.
+   */
+  K keyBase;
+
+  /**
+   * Stores keys as their difference from keyBase, padded with 0xFFFF.
+   */
+  std::uint16_t deltaArray[CAPACITY];
+
+  /**
+   * Stores RecordIds.
+   */
+  RecordId ridArray[CAPACITY];
+};
+
+template <class K>
+const int PackedLeafNode<K>::CAPACITY;
+
+/**
+ * @brief Non-leaf node with INTEGER keys.
+ */
+typedef NonLeafNode<int> NonLeafNodeInt;
+
+/**
+ * @brief Leaf node with INTEGER keys.
+ */
+typedef LeafNode<int> LeafNodeInt;
+
+/**
+ * @brief Packed leaf node with INTEGER keys.
+ */
+typedef PackedLeafNode<int> PackedLeafNodeInt;
+
+/**
+ * @brief Number of key slots in B+Tree leaf for INTEGER key.
+ */
+const int INTARRAYLEAFSIZE = LeafNodeInt::CAPACITY;
+
+/**
+ * @brief Number of key slots in a packed B+Tree leaf for INTEGER key.
+ */
+const int PACKEDLEAFSIZE = PackedLeafNodeInt::CAPACITY;
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+ */
+const int INTARRAYNONLEAFSIZE = NonLeafNodeInt::CAPACITY;
+
+/**
+ * @brief Fewest keys a leaf with INTEGER keys other than the only one may hold after a delete.
+ */
+const int INTLEAFMIN = LeafNodeInt::MIN;
+
+/**
+ * @brief Fewest keys a non-leaf with INTEGER keys other than the root may hold after a delete.
+ */
+const int INTNONLEAFMIN = NonLeafNodeInt::MIN;
+
+/**
+ * @brief Structure for the pages of a posting list. Each page holds the record ids between its first and last one,
+ * in order, as the differences between neighbours in a variable-length encoding, so that the record ids of a key
+ * stored in a relation's order take a byte or two each.
+*/
+struct PostingNode
+{
+  /**
+   * Page number of the next page of the list, Page::INVALID_NUMBER for the last one.
+   */
+  PageId nextPageNo;
+
+  /**
+   * Page number of the previous page of the list, Page::INVALID_NUMBER for the first one.
+   */
+  PageId prevPageNo;
+
+  /**
+   * Page number of the last page of the list. Only kept on the first page.
+   */
+  PageId lastPageNo;
+
+  /**
+   * Number of record ids in the whole list. Only kept on the first page.
+   */
+  int total;
+
+  /**
+   * Number of record ids on this page.
+   */
+  int count;
+
+  /**
+   * Number of bytes of data used.
+   */
+  int size;
+
+  /**
+   * Smallest record id on this page.
+   */
+  RecordId firstRid;
+
+  /**
+   * Largest record id on this page.
+   */
+  RecordId lastRid;
+
+  /**
+   * The encoded record ids.
+   */
+  unsigned char data[POSTINGDATASIZE];
+};
+
+/**
+ * @brief Structure for the nodes freed when a delete merges two nodes. Freed pages are chained
+ * from the meta page and handed out again before new pages are allocated, because pages cannot be
+ * removed from a BlobFile.
+*/
+struct FreeNode
+{
+  /**
+   * Page number of the next freed page, Page::INVALID_NUMBER for the last one.
+   */
+  PageId nextFreePageNo;
+};
+
+/**
+ * @brief A non-leaf node on the path from the root to the leaf an insert works on.
+ * Nodes on the path stay pinned while a batch is inserted, so that the next leaf can be found
+ * from the lowest node whose key range holds the next key instead of from the root.
+ */
+template <class K>
+struct PathNode
+{
+  /**
+   * Page number of the node.
+   */
+  PageId pageNo;
+
+  /**
+   * The node, pinned.
+   */
+  Page *page;
+
+  /**
+   * High key of the node when it was read. KeyTraits<K>::max() for the nodes on the right edge of the tree.
+   */
+  K highKey;
+
+  /**
+   * Position in pageNoArray of the child the path continues with.
+   */
+  int index;
+
+  /**
+   * True if the node has been modified since it was pinned.
+   */
+  bool dirty;
+
+  /**
+   * Version of the node's latch the reads of the node are validated against.
+   */
+  std::uint64_t version;
+
+  /**
+   * True while the node's latch is held for writing.
+   */
+  bool locked;
+};
+
+/**
+ * @brief Counts of the pages the inserts and deletes on an index mark dirty, to measure the writes they cause.
+ * A page released dirty to the buffer manager is written back when it is evicted or its file is flushed.
+ * Cached non-leaf nodes are never evicted, and are written once, when the index is closed.
+ */
+struct IndexWriteStats
+{
+  /**
+   * Number of entries inserted
+   */
+  long long inserts;
+
+  /**
+   * Number of entries deleted
+   */
+  long long deletes;
+
+  /**
+   * Number of times a page was released dirty to the buffer manager
+   */
+  long long dirtyPages;
+
+  /**
+   * Number of times a cached non-leaf node was released dirty
+   */
+  long long dirtyCachedNodes;
+
+  /**
+   * Clear all values
+   */
+  void clear()
+  {
+    inserts = deletes = dirtyPages = dirtyCachedNodes = 0;
+  }
+
+  /**
+   * Constructor of IndexWriteStats class
+   */
+  IndexWriteStats()
+  {
+    clear();
+  }
+};
+
+template <class K>
+class BTree;
+
+/**
+ * @brief The state of the scan of a BTreeCursor, behind an interface that does not depend on the key type,
+ * so that a cursor is the same type whatever the type of its index's keys.
+ */
+class BTreeScanBase
+{
+public:
+  virtual ~BTreeScanBase()
+  {
+  }
+
+  /**
+   * True if the scan has been started and not yet ended.
+   */
+  virtual bool isExecuting() const = 0;
+
+  /**
+   * @see BTreeCursor::scanNext
+   */
+  virtual const void scanNext(RecordId &outRid) = 0;
+
+  /**
+   * @see BTreeCursor::scanNextBatch
+   */
+  virtual size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max) = 0;
+
+  /**
+   * @see BTreeCursor::endScan
+   */
+  virtual const void endScan() = 0;
+};
+
+/**
+ * @brief A scan over a range of a BTree with keys of type K, as a BTreeCursor runs it. @see BTreeCursor
+ */
+template <class K>
+class BTreeScan : public BTreeScanBase
+{
+  friend class BTree<K>;
+
+private:
+  /**
+   * Index being scanned.
+   */
+  BTree<K> *index;
+
+  /**
+   * True if the scan has been started and not ended.
+   */
+  bool scanExecuting;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+  int nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+  PageId currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+  Page *currentPageData;
+
+  /**
+   * Version of the current leaf's latch that nextEntry, leafEnd and lastLeaf were computed at.
+   */
+  std::uint64_t leafVersion;
+
+  /**
+   * True once the scan has returned an entry.
+   */
+  bool returnedAny;
+
+  /**
+   * Key of the last entry returned, where the scan resumes if its leaf changes.
+   */
+  K lastKey;
+
+  /**
+   * Record ID of the last entry returned.
+   */
+  RecordId lastRid;
+
+  /**
+   * Low value for scan.
+   */
+  K lowVal;
+
+  /**
+   * High value for scan.
+   */
+  K highVal;
+
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+  Operator lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+  Operator highOp;
+
+  /**
+   * Order in which the entries are returned. A descending scan moves from nextEntry down through the left siblings.
+   */
+  ScanOrder order;
+
+  /**
+   * Index one past the last entry of the current leaf that satisfies the high bound.
+   * For a descending scan, index of the first entry that satisfies the low bound.
+   */
+  int leafEnd;
+
+  /**
+   * True if the scan cannot continue past the current leaf, because the bound it moves towards ends on it
+   * or it is the last leaf in the order of the scan.
+   */
+  bool lastLeaf;
+
+  /**
+   * Number of leaves to keep read ahead of the current one, 0 if read-ahead is off.
+   */
+  int readAhead;
+
+  /**
+   * Number of leaves entered since the leaves ahead were last asked for.
+   */
+  int leavesSinceRequest;
+
+  /**
+   * Number of leaves entered since readAhead last grew.
+   */
+  int leavesSinceGrow;
+
+  /**
+   * True while the cursor returns the record ids of the posting list in the slot at nextEntry.
+   */
+  bool inPosting;
+
+  /**
+   * Key of that posting list.
+   */
+  K postingKey;
+
+  /**
+   * True if the low bound's key does not hold the whole bound, so that entries whose key equals lowVal are checked
+   * against the bound in their records. lowOp is then GTE, and the bound's own operator is lowFullOp.
+   */
+  bool checkLow;
+
+  /**
+   * True if the high bound's key does not hold the whole bound, as for checkLow. highOp is then LTE.
+   */
+  bool checkHigh;
+
+  /**
+   * The low bound as passed to the index, if checkLow is set.
+   */
+  std::string lowFull;
+
+  /**
+   * The high bound as passed to the index, if checkHigh is set.
+   */
+  std::string highFull;
+
+  /**
+   * Operator of the low bound, if checkLow is set.
+   */
+  Operator lowFullOp;
+
+  /**
+   * Operator of the high bound, if checkHigh is set.
+   */
+  Operator highFullOp;
+
+  /**
+   * Keys of the entries of a batch being checked against the bounds, when the caller does not ask for them.
+   */
+  std::vector<K> checkKeys;
+
+  /**
+   * Record ids of the posting page being returned, in the order of the scan.
+   */
+  std::vector<RecordId> postingRids;
+
+  /**
+   * Position in postingRids of the next record id to return.
+   */
+  size_t postingPos;
+
+  /**
+   * Page number of the posting page being returned.
+   */
+  PageId postingPageNum;
+
+  /**
+   * Page number of the posting page that followed it when it was read, Page::INVALID_NUMBER if it was the last one.
+   */
+  PageId postingNextNum;
+
+  /**
+   * Compute leafEnd and lastLeaf for the current leaf with one in-node search on the high bound
+   * (the low bound for a descending scan), so that the entries from nextEntry up to leafEnd
+   * can be returned without checking each key.
+   */
+  void setLeafEnd();
+
+  /**
+   * Unpin the current leaf and move to its next sibling in the order of the scan, then keep the read-ahead
+   * readAhead leaves ahead of it. readAhead doubles every readAhead leaves, up to BTree::readAheadLimit.
+   *
+   * @return  False if the current leaf changed since leafVersion, in which case the scan stays on it
+   */
+  bool nextLeaf();
+
+  /**
+   * Position the cursor again after its leaf changed under it: on the entry after the last one returned,
+   * found on the current leaf or on a leaf to its right, or on the first entry of the scan if none was returned yet.
+   */
+  void reposition();
+
+  /**
+   * Position the cursor on the first entry, in the order of the scan, that satisfies the scan criteria,
+   * descending from the root. Any leaf the cursor is on is unpinned first.
+   *
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   */
+  void seek();
+
+  /**
+   * Queue the readAhead leaves after the current one, up to the leaf the scan ends on, for the buffer manager's
+   * prefetching thread, which follows their sibling links and skips those already in the pool. Done once every
+   * half readAhead leaves, so that the leaves asked for last time are still ahead when the next ones are.
+   */
+  void fillReadAhead();
+
+  /**
+   * Start returning the record ids of a posting list, from its first one in the order of the scan,
+   * or from the one after the last record id returned.
+   *
+   * @param key           Key of the list
+   * @param headPageNum   Page number of the first page of the list
+   * @param resume        Go on after the last record id returned instead of starting from the first one
+   * @return              False if no record id of the list is left to return, in which case the cursor is not in the list
+   */
+  bool enterPosting(const K key, const PageId headPageNum, const bool resume);
+
+  /**
+   * Read a posting page, consistently, into postingRids, and bring the page after it in the order of the scan
+   * into the buffer pool meanwhile.
+   *
+   * @param pageNum       Page number of the posting page
+   */
+  void readPosting(PageId pageNum);
+
+  /**
+   * Read the posting page a link led to, or the page on its right up to the right page given if pages were split off
+   * it since the link was read. A descending scan finds the page before the one it is on this way.
+   *
+   * @param pageNum       Page number the link led to
+   * @param rightPageNum  Page number of the page the one wanted is followed by, Page::INVALID_NUMBER for the last
+   *                      page of the list
+   */
+  void readPostingBefore(PageId pageNum, const PageId rightPageNum);
+
+  /**
+   * Move on to the next posting page in the order of the scan.
+   *
+   * @return  False at the end of the list
+   */
+  bool nextPosting();
+
+  /**
+   * Fetch the next entries in the range of lowVal and highVal, as scanNextBatch does without checking ties.
+   */
+  size_t nextBatch(RecordId *out, K *keysOut, const size_t max);
+
+  /**
+   * Whether an entry whose key ties with a bound that checkLow or checkHigh is set for satisfies the bound
+   * in its record. Any other entry does.
+   *
+   * @param key         Key of the entry
+   * @param rid         Record ID of the entry
+   */
+  bool inBounds(const K key, const RecordId rid);
+
+  /**
+   * Unpin the current page, if any, and reset the scan specific variables. Never throws.
+   */
+  void release();
+
+public:
+  /**
+   * Construct a scan that is not scanning anything.
+   */
+  BTreeScan();
+
+  BTreeScan(const BTreeScan &) = delete;
+  BTreeScan &operator=(const BTreeScan &) = delete;
+
+  /**
+   * BTreeScan Destructor. Ends the scan, if one is executing.
+   */
+  ~BTreeScan();
+
+  bool isExecuting() const
+  {
+    return scanExecuting;
+  }
+
+  const void scanNext(RecordId &outRid);
+
+  size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max);
+
+  const void endScan();
+};
+
+/**
+ * @brief Cursor over a range of a BTreeIndex, returned by BTreeIndex::openScan().
+ * Every cursor owns its own position and keeps its own current leaf pinned, so any number of cursors
+ * can be open on the same index at once and be advanced in any interleaving without re-descending the tree.
+ * A cursor ends its scan when it is destroyed. All cursors must be ended before their index is destroyed.
+ * A cursor takes no latches, so it never holds up inserts from other threads. It validates every read of its leaf
+ * against the leaf's version, and when the leaf changed under it, finds the last entry it returned again by following
+ * the right links, which splits only ever move entries along. The record ids of a posting list are returned a page at a time,
+ * with the next page of the list read ahead, and validated against the version of their own page, since posting pages
+ * too only ever move record ids to pages linked in on their right. Entries inserted during the scan may or may not be returned.
+ * Cursors must not be open while entries are deleted, since a delete may free the leaf a cursor is on.
+ * Cursors can be moved but not copied. A cursor scans an index of any key type.
+ */
+class BTreeCursor
+{
+private:
+  /**
+   * The scan, NULL if the cursor was never started.
+   */
+  std::unique_ptr<BTreeScanBase> scan;
+
+public:
+  /**
+   * Construct a cursor that is not scanning anything.
+   */
+  BTreeCursor();
+
+  /**
+   * Construct a cursor running a scan, which it owns from now on.
+   */
+  explicit BTreeCursor(BTreeScanBase *scan);
+
+  /**
+   * Move constructor. The other cursor is left not scanning anything.
+   */
+  BTreeCursor(BTreeCursor &&other) noexcept;
+
+  /**
+   * Move assignment. Ends this cursor's scan, if any, and takes over the other's.
+   */
+  BTreeCursor &operator=(BTreeCursor &&other) noexcept;
+
+  BTreeCursor(const BTreeCursor &) = delete;
+  BTreeCursor &operator=(const BTreeCursor &) = delete;
+
+  /**
+   * BTreeCursor Destructor. Ends the scan, if one is executing.
+   */
+  ~BTreeCursor();
+
+  /**
+   * True if the cursor has been started and not yet ended.
+   */
+  bool isExecuting() const
+  {
+    return scan != nullptr && scan->isExecuting();
+  }
+
+  /**
+     * Fetch the record id of the next index entry that matches the scan.
+     * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
+   * @param outRid    RecordId of next record found that satisfies the scan criteria returned in this
+     * @throws ScanNotInitializedException If no scan has been initialized.
+     * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+    **/
+  const void scanNext(RecordId &outRid);
+
+  /**
+   * Fetch the next qualifying entries of the current leaf in one pass, in the order of the scan. Once the current
+   * leaf is exhausted, the next call moves on to its next sibling. The end of the scan is reported through the return value
+   * instead of an exception; the cursor still has to be ended with endScan.
+   *
+   * @param out       Array that receives the RecordIds of at most max entries
+   * @param keysOut   Array that receives the keys of the same entries, for index-only queries, of the type of the
+   *                  index's keys: int, long long, double or StringKey. May be NULL.
+   * @param max       Capacity of out (and keysOut), must be at least 1
+   * @return          Number of entries returned, 0 once no more entries satisfy the scan criteria
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   **/
+  size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max);
+
+  /**
+     * Terminate the scan. Unpin any pinned pages. Reset scan specific variables.
+     * @throws ScanNotInitializedException If no scan has been initialized.
+    **/
+  const void endScan();
+};
+
+/**
+ * @brief The operations of a BTreeIndex, behind an interface that does not depend on the key type.
+ * Keys are passed by pointer, to a value of the index's attribute type, from which KeyTraits makes the key.
+*/
+class BTreeBase
+{
+public:
+  virtual ~BTreeBase()
+  {
+  }
+
+  virtual const void insertEntry(const void *key, const RecordId rid) = 0;
+
+  virtual bool lookup(const void *key, RecordId &outRid) = 0;
+
+  virtual size_t lookupAll(const void *key, std::vector<RecordId> &outRids) = 0;
+
+  virtual size_t lookupMany(const void *keys, const size_t n, RecordId *out, bool *found) = 0;
+
+  virtual bool deleteEntry(const void *key, const RecordId rid) = 0;
+
+  virtual size_t countRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp) = 0;
+
+  virtual IndexWriteStats &getWriteStats() = 0;
+
+  virtual void clearWriteStats() = 0;
+
+  virtual bool minKey(void *outKey) = 0;
+
+  virtual bool maxKey(void *outKey) = 0;
+
+  virtual const void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp,
+                               const ScanOrder order, const int readAhead) = 0;
+
+  virtual BTreeScanBase *openScan(const void *lowVal, const Operator lowOp, const void *highVal,
+                                  const Operator highOp, const ScanOrder order, const int readAhead) = 0;
+
+  virtual const void scanNext(RecordId &outRid) = 0;
+
+  virtual size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max) = 0;
+
+  virtual const void endScan() = 0;
+};
+
+/**
+ * @brief The B+ Tree of a BTreeIndex, over keys of type K. The node layouts and every search, split, merge
+ * and scan are written once, for any K that KeyTraits describes, and instantiated for int, long long, double,
+ * StringKey and CompositeKey keys in btree.cpp. A BTreeIndex picks the instantiation for its attribute type once,
+ * when it is constructed, so that no operation on the tree looks at the type again.
+*/
+template <class K>
+class BTree : public BTreeBase
+{
+  friend class BTreeScan<K>;
+
+private:
+  /**
+   * File object for the index file.
+   */
+  File *file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+  BufMgr *bufMgr;
+
+  /**
+   * Meta page
+   */
+  Page *metaPage;
+
+  /**
+   * Page number of meta page.
+   */
+  PageId headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file. Only changed with the latch of the old root held.
+   */
+  std::atomic<PageId> rootPageNum;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+  Datatype attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. That of the first attribute of a COMPOSITE index.
+   */
+  int attrByteOffset;
+
+  /**
+   * Offset and type of every attribute the index is built over, in the order their values make the keys.
+   */
+  std::vector<KeyAttribute> attributes;
+
+  /**
+   * Name of the relation.
+   */
+  std::string relationName;
+
+  /**
+   * The relation, opened the first time a record is compared with a value. NULL until then.
+   */
+  PageFile *relationFile;
+
+  /**
+   * Guards relationFile.
+   */
+  std::mutex relationMutex;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+  int leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+  int nodeOccupancy;
+
+  /**
+   * Page number of the first freed page, Page::INVALID_NUMBER if there is none. Mirrors the meta page.
+   */
+  PageId freePageNum;
+
+  /**
+   * Whether leaves whose keys fit are written packed. Mirrors the meta page. Always false for keys that do not pack.
+   */
+  bool compressLeaves;
+
+  /**
+   * Whether a leaf that overflows on insert shares its entries with a sibling before it splits. Mirrors the meta page.
+   */
+  bool redistributeLeaves;
+
+  /**
+   * Guards freePageNum and the meta page.
+   */
+  std::mutex metaMutex;
+
+  /**
+   * Keeps the counts in the non-leaf nodes exact. Held shared by an insert or a delete from before it finds its leaf
+   * until it has added its change to the counts above the leaf, and exclusively while entries move between the key
+   * ranges of a node's children: while separators are posted and while nodes are rebalanced. The non-leaf nodes
+   * therefore neither split nor merge while it is held shared. Readers never take it.
+   */
+  SharedLatch countLatch;
+
+  /**
+   * Incremented every time countLatch is taken exclusively, so that a path through the non-leaf nodes recorded
+   * while it was held shared is known to be still valid while the value is the same.
+   */
+  std::atomic<std::uint64_t> structureEpoch;
+
+  /**
+   * Path from the root down to the level above the last leaf, recorded by the last insert into that leaf,
+   * without the pins. Lets inserts of keys beyond the last one skip the descent.
+   */
+  std::vector<PathNode<K> > appendPath;
+
+  /**
+   * Page number of the last leaf, as recorded with appendPath. Page::INVALID_NUMBER if there is none.
+   */
+  PageId appendLeafNum;
+
+  /**
+   * Value of structureEpoch appendPath was recorded at.
+   */
+  std::uint64_t appendEpoch;
+
+  /**
+   * Guards appendPath, appendLeafNum and appendEpoch.
+   */
+  std::mutex appendMutex;
+
+  /**
+   * Frames of the cached non-leaf nodes, by page number, in chunks of NODE_CACHE_CHUNK allocated as needed: the upper
+   * levels of the tree, and the non-leaf nodes allocated later, as long as the buffer manager has frames to reserve
+   * for them. Each frame is pinned once for as long as the index is open, and the nodes are read and unpinned
+   * without the buffer manager.
+   * A page number keeps its frame until the index is closed, even after the page is freed and reused as a leaf,
+   * so that the pins taken on it always match the unpins.
+   */
+  std::atomic<std::atomic<Page *> *> nodeCache[NODE_CACHE_CHUNKS];
+
+  /**
+   * Number of frames in nodeCache, each reserved from the buffer manager, which shares NODE_CACHE_POOL_PERCENT
+   * of its pool among all the indexes. The non-leaf nodes beyond it are read through the buffer manager like
+   * the leaves. Guarded by metaMutex.
+   */
+  int cachedNodes;
+
+  /**
+   * Most leaves a scan reads ahead: MAX_READ_AHEAD, or READ_AHEAD_POOL_PERCENT of the buffer pool if that is less.
+   */
+  int readAheadLimit;
+
+  /**
+   * Counts of the entries inserted and deleted and of the pages they marked dirty. Added to atomically.
+   */
+  IndexWriteStats writeStats;
+
+  // MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * Cursor of the scan run through startScan/scanNext/endScan.
+   */
+  BTreeScan<K> scanCursor;
+
+  /**
+   * Extract the (key, rid) pair of every tuple in the relation, sorted on key and on rid among equal keys.
+   * The relation's pages are split into contiguous shares, one per thread; each thread sorts the pairs of its share
+   * into a run, and the runs are merged two by two, in parallel, until one is left. Pairs are ordered on rid as well
+   * as on key, so the result does not depend on the number of threads.
+   *
+   * @param relationName  Name of the relation
+   * @param buildThreads  Number of threads, as in BTreeIndex::BTreeIndex
+   * @param entries       The sorted pairs
+   **/
+  const void extractEntries(const std::string &relationName, const int buildThreads,
+                            std::vector<RIDKeyPair<K> > &entries);
+
+  /**
+   * Build the tree bottom-up from entries sorted on key. Leaves are written left to right,
+   * chained through rightSibPageNo, and every non-leaf level is then built over the level below it
+   * until a single root remains. The meta page must already be allocated.
+   *
+   * @param entries     Key-rid pairs sorted in ascending key order
+   * @param fillFactor  Fraction of the key slots to fill in each node, in (0, 1]
+   **/
+  const void bulkLoad(const std::vector<RIDKeyPair<K> > &entries, const double fillFactor);
+
+  /**
+   * Write one level of non-leaf nodes over the given children, left to right.
+   *
+   * @param children      Smallest key and page number of every node on the level below, in key order
+   * @param childCounts   Number of entries under each of the children
+   * @param level         Value of the level member for the new nodes (1 if just above the leaves)
+   * @param fillFactor    Fraction of the key slots to fill in each node, in (0, 1]
+   * @param parents       Smallest key and page number of every node written on this level
+   * @param parentCounts  Number of entries under each of the nodes written
+   **/
+  const void bulkLoadNonLeafLevel(const std::vector<PageKeyPair<K> > &children, const std::vector<int> &childCounts,
+                                  const int level, const double fillFactor, std::vector<PageKeyPair<K> > &parents,
+                                  std::vector<int> &parentCounts);
+
+  /**
+   * Follow the right links from a node, optimistically, to the node on its level whose key range holds the key.
+   * Every node left behind is unpinned.
+   *
+   * @param key         Key to search for
+   * @param leaf        True if the node is a leaf
+   * @param leftmost    Stay on a node whose high key equals the key, since entries equal to it may remain on the node
+   * @param pageNo      Page number of the node, replaced by the one found
+   * @param page        The node, pinned; replaced by the one found, pinned
+   * @param version     Version of the node's latch; replaced by that of the one found
+   * @return            False if a node changed while its link was followed, in which case the node now in
+   *                    pageNo and page is still pinned and the search has to start over
+   **/
+  bool moveRight(const K key, const bool leaf, const bool leftmost, PageId &pageNo, Page *&page,
+                 std::uint64_t &version);
+
+  /**
+   * Descend from the root to the leaf whose key range holds the key, unpinning each node once its
+   * child is pinned, and following right links past nodes whose separators are not posted yet.
+   * Starts over whenever a node changes under it.
+   *
+   * @param key         Key to search for
+   * @param leafPageNo  Page number of the leaf found
+   * @param leafPage    The leaf found, returned pinned
+   * @param leafVersion Version of the leaf's latch the reads of the leaf have to be validated against
+   * @param leftmost    Descend to the leftmost leaf that may hold the key instead. Entries equal to the key
+   *                    then start on that leaf or on the leaves to its right, even when they span several leaves.
+   **/
+  const void findLeaf(const K key, PageId &leafPageNo, Page *&leafPage, std::uint64_t &leafVersion,
+                      const bool leftmost = false);
+
+  /**
+   * Descend from the last node of the path, or from the root if the path is empty, to the leaf whose
+   * key range holds the key, pinning every non-leaf node on the way and recording the child taken
+   * and the version of its latch. Right links are followed wherever a node split after its parent was read,
+   * so the last node of the path is not necessarily the parent of the leaf. Nothing is latched.
+   *
+   * @param key         Key to search for
+   * @param path        Pinned non-leaf nodes, extended down to the level above the leaf
+   * @param leafPageNo  Page number of the leaf found
+   * @param leafHighKey High key of the leaf. KeyTraits<K>::max() for the last leaf.
+   * @param leafPage    The leaf found, returned pinned
+   * @param leafVersion Version of the leaf's latch the reads of the leaf have to be validated against
+   * @return            False if a node changed on the way down, in which case the leaf is not pinned
+   *                    and the path has to be released before starting over
+   **/
+  bool descendPath(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, K &leafHighKey,
+                   Page *&leafPage, std::uint64_t &leafVersion);
+
+  /**
+   * Reach the last leaf through the path recorded by the last insert into it, instead of descending, if the tree
+   * kept its shape since and the key goes after every key on the leaf. Called with countLatch held shared.
+   *
+   * @param key         Key to insert
+   * @param path        Receives the recorded path, every node pinned
+   * @param leafPageNo  Page number of the leaf found
+   * @param leafHighKey High key of the leaf
+   * @param leafPage    The leaf found, returned pinned
+   * @param leafVersion Version of the leaf's latch the reads of the leaf have to be validated against
+   * @return            False if the recorded path cannot be used, in which case nothing is left pinned
+   **/
+  bool appendLeaf(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, K &leafHighKey,
+                  Page *&leafPage, std::uint64_t &leafVersion);
+
+  /**
+   * Record the path to the last leaf for appendLeaf. Called with countLatch held shared.
+   *
+   * @param path        Non-leaf nodes from the root down to the level above the leaf
+   * @param leafPageNo  Page number of the last leaf
+   **/
+  const void recordAppendPath(const std::vector<PathNode<K> > &path, const PageId leafPageNo);
+
+  /**
+   * Descend from the root to the leaf whose key range holds the key, latching every node on the way
+   * for writing and keeping the latches, waiting for them where needed. If a node on the way split and
+   * the separator of its new neighbour is not posted yet, everything is released and the caller has to
+   * let the separator in and start over, so that every node of the path is the parent of the next one.
+   *
+   * @param key         Key to search for
+   * @param path        Receives the non-leaf nodes from the root down to the parent of the leaf, pinned and latched
+   * @param leafPageNo  Page number of the leaf found
+   * @param leafPage    The leaf found, returned pinned and latched
+   * @return            False if a node on the way split and waits for the separator of its new neighbour,
+   *                    in which case nothing is left latched or pinned
+   **/
+  bool lockPath(const K key, std::vector<PathNode<K> > &path, PageId &leafPageNo, Page *&leafPage);
+
+  /**
+   * Find the entry with the key and rid, or the posting list holding the entries with the key.
+   *
+   * @param key         Key of the entry
+   * @param rid         Record ID of the entry
+   * @param exclusive   Latch the path and the leaf for writing with lockPath instead of descending optimistically
+   * @param path        Receives the non-leaf nodes from the root down to the parent of the leaf, pinned
+   * @param leafPageNo  Page number of the leaf holding the entry, or that would hold it
+   * @param leafPage    That leaf, pinned
+   * @param leafVersion Version of the leaf's latch the search was validated against, if not exclusive
+   * @param pos         Position of the entry or of the posting list on the leaf, -1 if there is neither
+   * @param listSize    Number of record ids in the posting list, 1 if the entry is not in one
+   * @return            False if a node changed during an optimistic search, or if lockPath met a node waiting
+   *                    for its separator, in which case nothing is left pinned
+   **/
+  bool findEntry(const K key, const RecordId rid, const bool exclusive, std::vector<PathNode<K> > &path,
+                 PageId &leafPageNo, Page *&leafPage, std::uint64_t &leafVersion, int &pos, int &listSize);
+
+  /**
+   * Latch, without waiting, the nodes an insert of entries into a leaf changes: the leaf itself and,
+   * if the leaf has to split, its right sibling, whose left link changes. The parent is not latched:
+   * the separators of the new leaves are posted to it afterwards.
+   *
+   * @param leafPage       The leaf, pinned
+   * @param leafVersion    Version of the leaf's latch the leaf was read at
+   * @param entries        Entries to insert into the leaf, sorted on key
+   * @param count          Number of entries to insert into the leaf
+   * @param rightSibPageNo Page number of the right sibling if it was latched, Page::INVALID_NUMBER otherwise
+   * @param rightSibPage   The right sibling, pinned if it was latched
+   * @param share          Set if the leaf has to split and redistributeLeaves is set: nothing is latched, and
+   *                       the entries are to be inserted by insertRedistributed instead
+   * @return               False if any of the nodes changed since it was read or is latched by another
+   *                       thread, or if share is set, in which case nothing is left latched
+   **/
+  bool latchInsert(Page *leafPage, const std::uint64_t leafVersion, const RIDKeyPair<K> *entries,
+                   const size_t count, PageId &rightSibPageNo, Page *&rightSibPage, bool &share);
+
+  /**
+   * Insert entries into a leaf that has to split, sharing them with a sibling first: the leaf and a sibling
+   * under the same parent are refilled evenly if the entries fit the two of them, and are split into three
+   * leaves, each about two thirds full, otherwise. The leaf splits as it would without redistribution only if
+   * it has no such sibling. Called with countLatch held exclusively.
+   *
+   * @param entries     Key-rid pairs sorted in ascending key order, the first of them in the key range of the leaf
+   * @param count       Number of entries
+   * @return            Number of the entries inserted: those in the key range of the leaf. 0 if lockPath met
+   *                    a node waiting for its separator, in which case nothing is left pinned
+   **/
+  size_t insertRedistributed(const RIDKeyPair<K> *entries, size_t count);
+
+  /**
+   * Refill a leaf and its left or right sibling with their entries and the entries to insert, spread evenly
+   * over the two of them, or over three with a new leaf chained in after the right one. The leaves meet
+   * between two keys, and the new entries are then inserted into the leaf whose key range holds them.
+   *
+   * @param path         Pinned and latched non-leaf nodes from the root down to the parent of the leaf
+   * @param rightIndex   Position in the parent of the right leaf of the two
+   * @param leafPageNo   Page number of the leaf
+   * @param leafPage     The leaf, pinned and latched
+   * @param entries      Key-rid pairs sorted in ascending key order, all within the key range of the leaf
+   * @param count        Number of entries
+   * @param parts        Number of leaves to spread the entries over: 2 or 3
+   * @param splitPageNos Receives the page number of every leaf split, in the order their separators are posted
+   * @param newLeaves    Receives the smallest key and page number of the leaves split off each of them
+   * @return             False if the entries do not fit, or a leaf split off the left one sits between the two,
+   *                     in which case nothing has changed and only the leaf is left latched. Otherwise every
+   *                     leaf is released.
+   **/
+  bool shareLeaves(std::vector<PathNode<K> > &path, const int rightIndex, const PageId leafPageNo, Page *leafPage,
+                   const RIDKeyPair<K> *entries, const size_t count, const int parts,
+                   std::vector<PageId> &splitPageNos, std::vector<std::vector<PageKeyPair<K> > > &newLeaves);
+
+  /**
+   * Insert entries sorted on key. Each leaf receiving entries is reached from the lowest node
+   * on the pinned path whose key range holds its first key, and gets all of its entries at once.
+   *
+   * @param entries     Key-rid pairs sorted in ascending key order
+   * @param count       Number of entries
+   **/
+  const void insertSorted(const RIDKeyPair<K> *entries, const size_t count);
+
+  /**
+   * Add to the counts of the children the path goes through, after the leaf it leads to gained or lost entries.
+   * Called with countLatch held, so that the path still leads to the leaf.
+   *
+   * @param path        Pinned non-leaf nodes from the root down to the level above the leaf
+   * @param delta       Number of entries added to the leaf, negative for entries removed
+   **/
+  const void addToCounts(std::vector<PathNode<K> > &path, const int delta);
+
+  /**
+   * Merge sorted entries into a leaf. Entries whose key has a posting list on the leaf are added to the list,
+   * and keys reaching POSTING_MIN entries move to a new one. If the entries do not fit, they are spread evenly over
+   * the leaf and as many new leaves as needed, chained in after it, ending each leaf between two keys,
+   * and the high key of the leaf is lowered.
+   *
+   * @param leafPageNo  Page number of the leaf
+   * @param leafPage    The leaf, pinned by the caller
+   * @param entries     Key-rid pairs sorted in ascending key order, all within the key range of the leaf
+   * @param count       Number of entries
+   * @param newLeaves   Smallest key and page number of every new leaf, in key order
+   **/
+  const void insertIntoLeaf(const PageId leafPageNo, Page *leafPage, const RIDKeyPair<K> *entries,
+                            const size_t count, std::vector<PageKeyPair<K> > &newLeaves);
+
+  /**
+   * Move every run of POSTING_MIN or more entries with one key to a new posting list, in place.
+   *
+   * @param keys        Keys of the entries, in index order
+   * @param rids        Their rids
+   * @param sizes       Number of entries each stands for: 1, or the length of its posting list
+   **/
+  const void foldPostings(std::vector<K> &keys, std::vector<RecordId> &rids, std::vector<int> &sizes);
+
+  /**
+   * Write a new posting list, filling each page before starting the next.
+   *
+   * @param rids        Record ids of the list, in order
+   * @param count       Number of record ids, at least one
+   * @return            Page number of the first page of the list
+   **/
+  PageId writePosting(const RecordId *rids, const int count);
+
+  /**
+   * Merge record ids into a posting list. Each goes to the first page whose last record id is not below it, or to the
+   * last page; a page that overflows keeps what fits and the rest moves to new pages linked in after it.
+   * Called with the latch of the leaf holding the list.
+   *
+   * @param headPageNo  Page number of the first page of the list
+   * @param rids        Record ids to add, in order
+   * @param count       Number of record ids
+   **/
+  const void addToPosting(const PageId headPageNo, const RecordId *rids, const int count);
+
+  /**
+   * Remove a record id from a posting list. A page left empty leaves the list and is freed.
+   * Called with the latch of the leaf holding the list.
+   *
+   * @param headPageNo  Page number of the first page of the list, replaced if that page is freed;
+   *                    Page::INVALID_NUMBER once the list is empty
+   * @param rid         Record id to remove
+   * @return            False if the list does not hold the record id
+   **/
+  bool removeFromPosting(PageId &headPageNo, const RecordId rid);
+
+  /**
+   * Read, consistently and without latching it, what a posting page keeps about its list and its neighbours.
+   *
+   * @param pageNo      Page number of the posting page
+   * @param total       Receives the number of record ids in the list, if the page is the first one
+   * @param firstRid    Receives the smallest record id on the page
+   * @param prevPageNo  Receives the page number of the previous page, Page::INVALID_NUMBER for the first one
+   * @param lastPageNo  Receives the page number of the last page of the list, if the page is the first one
+   **/
+  const void readPostingHead(const PageId pageNo, int &total, RecordId &firstRid, PageId &prevPageNo,
+                             PageId &lastPageNo);
+
+  /**
+   * Append the record ids of a posting list, reading its pages in order without latching them.
+   *
+   * @param headPageNo  Page number of the first page of the list
+   * @param leafPage    The leaf holding the list, pinned
+   * @param leafVersion Version of the leaf's latch the list was found at
+   * @param rids        Receives the record ids
+   * @return            False if the leaf changed meanwhile, in which case the record ids appended may be wrong
+   **/
+  bool readPostingList(const PageId headPageNo, Page *leafPage, const std::uint64_t leafVersion,
+                       std::vector<RecordId> &rids);
+
+  /**
+   * Count the entries some slots of a leaf stand for, reading the first page of every posting list among them.
+   * Called with the latch of the leaf.
+   *
+   * @param leaf        The leaf
+   * @param begin       Position of the first slot
+   * @param end         Position one past the last slot
+   * @return            Number of entries
+   **/
+  int leafEntries(const LeafNode<K> *leaf, const int begin, const int end);
+
+  /**
+   * Latch, waiting for nothing, the leftmost node on the level whose key range may hold the key. The node is found
+   * from the root, optimistically, and the search starts over until the node is latched at the version it was read at.
+   * If the tree is not that high, the root is latched instead, and it is then the only node on the level below
+   * with no parent: any other node there is linked in on its right.
+   *
+   * @param key         Key to search for
+   * @param level       Level of the node, 1 for the nodes just above the leaves
+   * @param pageNo      Page number of the node latched
+   * @param page        The node, pinned and latched
+   **/
+  const void lockNode(const K key, const int level, PageId &pageNo, Page *&page);
+
+  /**
+   * Post the separators of new leaves split off a leaf to the node holding the leaf, right after it and after
+   * any nodes split off it later whose separators got there first. The node receiving them is latched on its own,
+   * after the split leaf has been released. The entries of the new leaves move from the count of the child on
+   * their left to their own. A node that overflows is split into as many nodes as needed, linked in on its right,
+   * and is released before their separators are posted a level up in turn. If the root splits, a new root is put
+   * above it and the meta page is updated. Called with countLatch held exclusively; if the split leaf waits for
+   * its own separator, the latch is let go until that is posted.
+   *
+   * @param path        Pinned non-leaf nodes from the root down to the level above the leaves, as last descended.
+   *                    A node of the path is tried first for the level it is on, and the root is searched only if
+   *                    it changed since. Left pinned, with nothing latched.
+   * @param splitPageNo Page number of the leaf that split
+   * @param separators  Smallest key and page number of every new leaf, in key order. Consumed.
+   **/
+  const void postSeparators(std::vector<PathNode<K> > &path, PageId splitPageNo,
+                            std::vector<PageKeyPair<K> > &separators);
+
+  /**
+   * Read the right link of a node.
+   *
+   * @param pageNo      Page number of the node
+   * @param leaf        True if the node is a leaf
+   * @return            Page number of its right neighbour, Page::INVALID_NUMBER if there is none
+   **/
+  PageId rightLink(const PageId pageNo, const bool leaf);
+
+  /**
+   * Count the entries under a node and the nodes right of it on its level, up to a given node.
+   * Called with countLatch held exclusively, so that no node counted changes.
+   *
+   * @param pageNo      Page number of the first node counted
+   * @param stopPageNo  Page number of the first node not counted, Page::INVALID_NUMBER to count up to the end of
+   *                    the level
+   * @param leaf        True if the nodes are leaves
+   * @return            Number of entries
+   **/
+  int chainCount(const PageId pageNo, const PageId stopPageNo, const bool leaf);
 
   /**
-   * Stores keys.
-   */
-  int keyArray[INTARRAYNONLEAFSIZE];
+   * Count the entries with a key below the key, or up to it, from the counts on the way down to the leaf
+   * holding it. Starts over from the root whenever a node changes under it.
+   *
+   * @param key         Key to count up to
+   * @param inclusive   Count the entries equal to the key too
+   * @return            Number of entries
+   **/
+  long long countBelow(const K key, const bool inclusive);
 
   /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
-   */
-  PageId pageNoArray[INTARRAYNONLEAFSIZE + 1];
-};
+   * Read the smallest or largest key from the first or last leaf.
+   *
+   * @param last        Read the largest key instead of the smallest
+   * @param outKey      Receives the key, if there is one
+   * @return            False if the tree is empty
+   **/
+  bool edgeKey(const bool last, K *outKey);
 
-/**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
-*/
-struct LeafNodeInt
-{
   /**
-   * Stores keys.
-   */
-  int keyArray[INTARRAYLEAFSIZE];
+   * Release the latches held on nodes of the path, recording the versions readers see from now on.
+   **/
+  const void unlockPath(std::vector<PathNode<K> > &path);
 
   /**
-   * Stores RecordIds.
-   */
-  RecordId ridArray[INTARRAYLEAFSIZE];
+   * Release the latches held on nodes of the path, unpin every node and empty the path.
+   **/
+  const void releasePath(std::vector<PathNode<K> > &path);
 
   /**
-   * Page number of the leaf on the right side.
-     * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
-   */
-  PageId rightSibPageNo;
-};
-
-/**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
-*/
-class BTreeIndex
-{
+   * Release the latch held on a node and unpin it.
+   *
+   * @param pageNo      Page number of the node
+   * @param page        The node, pinned and latched
+   * @param dirty       False if the node was latched but not modified
+   **/
+  const void releaseNode(const PageId pageNo, Page *page, const bool dirty = true);
 
-private:
   /**
-   * File object for the index file.
-   */
-  File *file;
+   * Rebalance a leaf left with fewer than INTLEAFMIN entries with its left sibling, or its right one
+   * if it is the first child. The two are merged if the sibling is at the minimum too, otherwise their
+   * entries are shared as evenly between them as the keys allow. Two leaves with a split-off leaf between them whose separator
+   * is not posted yet are left alone, and so is a right leaf with such a leaf after it that would otherwise be merged away.
+   * The leaf is released.
+   *
+   * @param path        Pinned and latched non-leaf nodes from the root down to the parent of the leaf
+   * @param leafPageNo  Page number of the leaf
+   * @param leafPage    The leaf, pinned and latched
+   **/
+  const void rebalanceLeaf(std::vector<PathNode<K> > &path, const PageId leafPageNo, Page *leafPage);
 
   /**
-   * Buffer Manager Instance.
-   */
-  BufMgr *bufMgr;
+   * Rebalance the non-leaf nodes of the path bottom-up after their children merged, the same way
+   * rebalanceLeaf does for leaves, and remove the root once it is left with a single non-leaf child.
+   * Every node of the path is released.
+   *
+   * @param path        Pinned and latched non-leaf nodes from the root down
+   **/
+  const void rebalancePath(std::vector<PathNode<K> > &path);
 
   /**
-   * Meta page
-   */
-  Page *metaPage;
+   * Page number of the node following a child of a non-leaf node on its level: the next child, or the first
+   * child of the right sibling of the node after its last one. A node split off the child and still waiting
+   * for its separator is not it. Called with countLatch held exclusively, which keeps the children in place.
+   *
+   * @param node        Latched non-leaf node
+   * @param index       Index of the child in the node
+   * @return            Page number of the following node, Page::INVALID_NUMBER after the last node of the level
+   **/
+  PageId nextChild(NonLeafNode<K> *node, const int index);
 
   /**
-   * Page number of meta page.
-   */
-  PageId headerPageNum;
+   * Write the root page number and the head of the freed page list to the meta page.
+   * Called with metaMutex held.
+   **/
+  const void updateMetaPage();
 
   /**
-   * page number of root page of B+ tree inside index file.
-   */
-  PageId rootPageNum;
+   * Allocate a node, reusing the most recently freed page if there is one.
+   *
+   * @param pageNo      Page number of the node
+   * @param page        The node, pinned
+   * @param nonLeaf     Keep the node's frame in the cache of non-leaf nodes if the page is new to the file
+   *                    and the cache has room for it.
+   *                    A reused page may still be pinned by a reader that reached it before it was freed.
+   **/
+  const void allocNode(PageId &pageNo, Page *&page, const bool nonLeaf = false);
 
   /**
-   * Datatype of attribute over which index is built.
-   */
-  Datatype attributeType;
+   * Pin a page of the index file: a cached node's frame directly, any other page through the buffer manager.
+   *
+   * @param pageNo      Page number
+   * @param page        The page, pinned
+   **/
+  void readNode(const PageId pageNo, Page *&page)
+  {
+    page = cachedNode(pageNo);
+    if (page == NULL)
+    {
+      bufMgr->readPage(file, pageNo, page);
+    }
+  }
 
   /**
-   * Offset of attribute, over which index is built, inside records.
-   */
-  int attrByteOffset;
+   * Unpin a page pinned with readNode or allocNode. Cached nodes stay pinned, and are written out when
+   * the index is closed.
+   *
+   * @param pageNo      Page number
+   * @param dirty       True if the page was modified
+   **/
+  void unpinNode(const PageId pageNo, const bool dirty)
+  {
+    bool cached = cachedNode(pageNo) != NULL;
+    if (!cached)
+    {
+      bufMgr->unPinPage(file, pageNo, dirty);
+    }
+    if (dirty)
+    {
+      __atomic_fetch_add(cached ? &writeStats.dirtyCachedNodes : &writeStats.dirtyPages, 1, __ATOMIC_RELAXED);
+    }
+  }
 
   /**
-   * Number of keys in leaf node, depending upon the type of key.
-   */
-  int leafOccupancy;
+   * Frame of a cached node, NULL if the page is not cached.
+   *
+   * @param pageNo      Page number
+   **/
+  Page *cachedNode(const PageId pageNo) const
+  {
+    if (pageNo / NODE_CACHE_CHUNK >= (PageId)NODE_CACHE_CHUNKS)
+    {
+      return NULL;
+    }
+    std::atomic<Page *> *chunk = nodeCache[pageNo / NODE_CACHE_CHUNK].load(std::memory_order_acquire);
+    return (chunk == NULL) ? NULL : chunk[pageNo % NODE_CACHE_CHUNK].load(std::memory_order_acquire);
+  }
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
-   */
-  int nodeOccupancy;
+   * Keep a pinned node's frame in the cache, with the pin. Called with metaMutex held, or before the index is shared.
+   *
+   * @param pageNo      Page number of the node
+   * @param page        The node, pinned
+   * @return            False if the cache is full, in which case the caller keeps its pin
+   **/
+  bool cacheNode(const PageId pageNo, Page *page);
 
-  // MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Cache the non-leaf nodes of the tree level by level from the root, as many as the cache has room for.
+   * Called before the index is shared.
+   **/
+  const void cacheNonLeafLevels();
 
   /**
-   * True if an index scan has been started.
-   */
-  bool scanExecuting;
+   * Put a node on the list of freed pages, release its latch and unpin it.
+   *
+   * @param pageNo      Page number of the node
+   * @param page        The node, pinned and latched
+   **/
+  const void freeNode(const PageId pageNo, Page *page);
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
-   */
-  int nextEntry;
+   * Append the record ids of every entry with the key, in index order.
+   *
+   * @param key         Key to look up
+   * @param outRids     Receives the record ids
+   * @return            Number of entries found
+   **/
+  size_t keyRids(const K key, std::vector<RecordId> &outRids);
 
   /**
-   * Page number of current page being scanned.
-   */
-  PageId currentPageNum;
+   * Check the attribute in a record against bounds passed to the index, in full: values whose key does not hold
+   * all of them tie on it with other values, and only their records tell the entries with the key apart.
+   *
+   * @param rid         Record ID of the record
+   * @param lowVal      Low bound, as passed to the index, NULL for none
+   * @param lowOp       Low operator (GT/GTE)
+   * @param highVal     High bound, as passed to the index, NULL for none
+   * @param highOp      High operator (LT/LTE)
+   * @return            True if the attribute satisfies both bounds
+   **/
+  bool recordInRange(const RecordId rid, const void *lowVal, const Operator lowOp, const void *highVal,
+                     const Operator highOp);
 
   /**
-   * Current Page being scanned.
-   */
-  Page *currentPageData;
+   * Key of a record, made from the attributes the index is built over.
+   *
+   * @param record      The record
+   * @param size        Number of bytes of the record
+   * @return            Key of the record
+   **/
+  K recordKey(const char *record, const size_t size) const;
 
   /**
-   * Low INTEGER value for scan.
-   */
-  int lowValInt;
+   * Bring an unindexable bound, KeyTraits<K>::max() that pads the nodes or a NaN DOUBLE, down to
+   * KeyTraits<K>::greatest(), with the operator that selects the same entries as max(). A search for max() itself
+   * would run off the right edge of the tree, and NaN has no place in the order.
+   *
+   * @param key         The bound
+   * @param op          Its operator, GT or GTE for a low bound and LT or LTE for a high one
+   **/
+  static void clampBound(K &key, Operator &op);
 
   /**
-   * Low DOUBLE value for scan.
-   */
-  double lowValDouble;
+   * Count the entries with a key that satisfy the bounds in their records.
+   *
+   * @param key         Key of the entries, that of one of the bounds
+   * @return            Number of entries
+   **/
+  size_t countTies(const K key, const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
 
   /**
-   * Low STRING value for scan.
-   */
-  std::string lowValString;
+   * Check the scan parameters and position the cursor on the first entry that satisfies them,
+   * ending the cursor's previous scan if it is still executing.
+   *
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+   **/
+  const void startCursor(BTreeScan<K> &cursor, const void *lowValParm, const Operator lowOpParm,
+                         const void *highValParm, const Operator highOpParm, const ScanOrder order,
+                         const int readAhead);
 
+public:
   /**
-   * High INTEGER value for scan.
+   * Open the index file of the relation on the attribute, or create and bulk load it.
+   * @see BTreeIndex::BTreeIndex
    */
-  int highValInt;
+  BTree(const std::string &relationName, std::string &outIndexName, BufMgr *bufMgrIn,
+        const std::vector<KeyAttribute> &attributes, const double fillFactor, const bool compressLeaves,
+        const bool redistributeLeaves, const int buildThreads);
 
   /**
-   * High DOUBLE value for scan.
+   * Flush the index file and close it.
    */
-  double highValDouble;
+  ~BTree();
 
   /**
-   * High STRING value for scan.
+   * Insert entries with keys of type K. @see BTreeIndex::insertEntries
    */
-  std::string highValString;
+  const void insertEntries(const std::vector<RIDKeyPair<K> > &entries);
+
+  // The operations of BTreeIndex, on keys of type K. @see BTreeIndex
+
+  const void insertEntry(const void *key, const RecordId rid);
+
+  bool lookup(const void *key, RecordId &outRid);
+
+  size_t lookupAll(const void *key, std::vector<RecordId> &outRids);
+
+  size_t lookupMany(const void *keys, const size_t n, RecordId *out, bool *found);
+
+  bool deleteEntry(const void *key, const RecordId rid);
+
+  size_t countRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
+
+  IndexWriteStats &getWriteStats()
+  {
+    return writeStats;
+  }
+
+  void clearWriteStats()
+  {
+    writeStats.clear();
+  }
+
+  bool minKey(void *outKey);
+
+  bool maxKey(void *outKey);
+
+  const void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp,
+                       const ScanOrder order, const int readAhead);
 
+  BTreeScanBase *openScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp,
+                          const ScanOrder order, const int readAhead);
+
+  const void scanNext(RecordId &outRid);
+
+  size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max);
+
+  const void endScan();
+};
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation, of type INTEGER, BIGINT, DOUBLE or STRING; the tree itself is a BTree over keys of the attribute's type.
+ * A STRING attribute is keyed on the first STRINGSIZE bytes of its strings, as StringKeys. Entries whose strings share
+ * those bytes have the same key, so they come in rid order rather than in the order of their strings, and lookups
+ * and bounds that tie with them beyond the key compare the strings in their records. A scan whose bound ties with
+ * entries starts on them even if none of them is in its range, and then returns nothing rather than throwing
+ * NoSuchKeyFoundException.
+ * startScan/scanNext/endScan run one scan at a time; openScan returns independent cursors for any number
+ * of concurrent scans.
+ *
+ * lookup, lookupAll, lookupMany, insertEntry, insertEntries and deleteEntry can be called from any number
+ * of threads at once, through optimistic lock coupling on the version latch of each node's buffer frame.
+ * Readers take no latches: they validate every node they read against its version and start over from
+ * the root if a writer got in between. The tree is a B-link tree, so a reader that reaches a node after it split
+ * follows the node's right link instead of starting over. An insert latches only the leaf it changes, plus its right
+ * sibling if the leaf splits; the separators of the new leaves are posted to the parent after the leaf is released,
+ * one node at a time, so no insert ever holds a node and its parent together. It never waits for a latch and starts
+ * over instead. A delete that leaves its leaf at or above the minimum latches only the leaf; one that has to
+ * rebalance latches the whole path from the root down. The entry counts kept in the non-leaf nodes are updated
+ * without latching them; posting separators and rebalancing, which move entries between counts, wait for those updates
+ * and keep other writers out while they run. Scans and range counts take no latches and may run alongside inserts,
+ * but scans not alongside deletes. The bulk load in the constructor must not run while another thread uses the index.
+*/
+class BTreeIndex
+{
+private:
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Datatype of attribute over which index is built.
    */
-  Operator lowOp;
+  Datatype attributeType;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * The tree, over keys of the attribute's type.
    */
-  Operator highOp;
+  BTreeBase *tree;
 
   /**
-   * records the value the new page to be split on
+   * Check that keys passed to the index are of the type of its keys.
+   *
+   * @param type      Datatype of the keys passed
+   * @throws  BadIndexInfoException If it is not attributeType
    **/
-  int middleInt;
-  
+  void checkKeyType(const Datatype type) const;
 
 public:
   /**
    * BTreeIndex Constructor.
      * Check to see if the corresponding index file exists. If so, open the file.
-     * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+     * If not, create it and bulk load it: the (key, rid) pairs of every tuple in the base relation are
+     * extracted and sorted by buildThreads threads, and written bottom-up as packed leaves and non-leaf levels.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn                        Buffer Manager Instance
    * @param attrByteOffset            Offset of attribute, over which index is to be built, in the record
-   * @param attrType                        Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param attrType                        Datatype of attribute over which index is built: INTEGER (int),
+   *                                  BIGINT (long long), DOUBLE (double) or STRING (NUL terminated char string,
+   *                                  keyed as StringKey). Decides the type of every key passed to the index, and
+   *                                  which instantiation of BTree runs it.
+   * @param fillFactor                Fraction of the key slots filled in each node when the index is bulk loaded.
+   *                                  Values outside (0, 1] are clamped. Ignored if the index file already exists.
+   * @param compressLeaves            Write the leaves whose keys are all within PACKED_MAX_DELTA of each other packed, as
+   *                                  PackedLeafNode. Ignored for DOUBLE, STRING and COMPOSITE keys, and if the index
+   *                                  file already exists.
+   * @param redistributeLeaves        Let a leaf that overflows on insert share its entries with a sibling, and split
+   *                                  two full leaves into three, B*-tree style, rather than split in two. Random inserts
+   *                                  then leave the leaves over 80% full, where even splits leave them around 60%.
+   *                                  Ignored if the index file already exists.
+   * @param buildThreads              Number of threads the relation's pages are split between when the index is bulk
+   *                                  loaded, each extracting and sorting the entries of its share, before the sorted
+   *                                  runs are merged. At most one per BUILD_MIN_PAGES pages, and one per hardware
+   *                                  thread if 0. The index file is the same whatever the number.
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters,
+   *                                    or if keys of the attribute type cannot be indexed,
+   *                                    or if the index is created over a relation with an attribute value whose key
+   *                                    pads the nodes: INT32_MAX, INT64_MAX or +infinity, or that is NaN.
+   *                                    @see insertEntry
+   */
+  BTreeIndex(const std::string &relationName, std::string &outIndexName,
+             BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+             const double fillFactor = DEFAULT_FILL_FACTOR, const bool compressLeaves = false,
+             const bool redistributeLeaves = false,
+             const int buildThreads = DEFAULT_BUILD_THREADS);
+
+  /**
+   * BTreeIndex Constructor for an index over several attributes of the relation, a COMPOSITE index, whose keys
+   * are the values of the attributes in order, compared attribute by attribute. A range whose bounds share the values
+   * of the first attributes, such as i = 5 AND d BETWEEN x AND y, is a single range of keys: a scan with the bounds
+   * CompositeKey::of(attributes, {&i, &x}, 2) and CompositeKey::of(attributes, {&i, &y}, 2) descends to it once and
+   * reads it off consecutive leaves, and one with CompositeKey::of and CompositeKey::last over {&i} returns every
+   * entry with i = 5. Every key passed to the index is a CompositeKey. The index file is named after the relation
+   * and the offsets of the attributes, and its meta page keeps the attributes.
+   * With a single attribute, the same as the constructor for that attribute.
+   *
+   * @param attributes              Offset and type of every attribute, in order: at most MAX_KEY_ATTRIBUTES of them,
+   *                                  of types INTEGER, BIGINT, DOUBLE or STRING, whose values take at most
+   *                                  COMPOSITESIZE bytes of a CompositeKey.
+   * @throws  BadIndexInfoException     If the index file already exists for other attributes, or if the attributes
+   *                                    cannot make a key.
+   * @see BTreeIndex::BTreeIndex for the other parameters
    */
   BTreeIndex(const std::string &relationName, std::string &outIndexName,
-             BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
+             BufMgr *bufMgrIn, const std::vector<KeyAttribute> &attributes,
+             const double fillFactor = DEFAULT_FILL_FACTOR, const bool compressLeaves = false,
+             const bool redistributeLeaves = false,
+             const int buildThreads = DEFAULT_BUILD_THREADS);
 
   /**
    * BTreeIndex Destructor.
@@ -325,18 +2690,158 @@ public:
      * and delete file instance thereby closing the index file.
      * Destructor should not throw any exceptions. All exceptions should be caught in here itself.
      * */
-  ~BTreeIndex();
+  ~BTreeIndex()
+  {
+    delete tree;
+  }
+
+  BTreeIndex(const BTreeIndex &) = delete;
+  BTreeIndex &operator=(const BTreeIndex &) = delete;
 
   /**
      * Insert a new entry using the pair <value,rid>.
-     * Start from root to recursively find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
+     * Start from root to find out the leaf to insert the entry in. The insertion may cause splitting of leaf node.
      * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
      * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
      * Make sure to unpin pages as soon as you can.
+     * With redistributeLeaves set, a full leaf first shares its entries with a sibling, and splits along with it into three.
    * @param key            Key to insert, pointer to integer/double/char string
    * @param rid            Record ID of a record whose entry is getting inserted into the index.
+   * @throws  BadIndexInfoException If the key is KeyTraits<K>::max() of the index's keys, INT32_MAX, INT64_MAX or
+   *                                +infinity, which pads the nodes, or is NaN. A bound equal to either is fine:
+   *                                no entry has it.
     **/
-  const void insertEntry(const void *key, const RecordId rid);
+  const void insertEntry(const void *key, const RecordId rid)
+  {
+    tree->insertEntry(key, rid);
+  }
+
+  /**
+   * Insert a batch of entries. The batch is sorted on key, and consecutive keys that fall in the same leaf
+   * are merged into it together, with at most one split pass per leaf, and without descending from the root
+   * for each key. Only the nodes that change are written back.
+   * @param entries        Key-rid pairs to insert, in any order, with keys of the type of the index's keys.
+   *                       A STRING index takes StringKeys, made with StringKey::of.
+   * @throws  BadIndexInfoException If the keys are not of the type of the index's keys, or one of them is
+   *                                KeyTraits<K>::max() or NaN. @see insertEntry
+   **/
+  template <class K>
+  const void insertEntries(const std::vector<RIDKeyPair<K> > &entries)
+  {
+    checkKeyType(KeyTraits<K>::TYPE);
+    static_cast<BTree<K> *>(tree)->insertEntries(entries);
+  }
+
+  /**
+   * Look up one entry with the given key, with a single descent from the root. Of several, the one with the smallest rid.
+   * Does not touch the scan run by startScan.
+   * @param key            Key to look up, pointer to integer/double/char string
+   * @param outRid         RecordId of an entry with the key, if there is one
+   * @return               True if an entry with the key was found
+   **/
+  bool lookup(const void *key, RecordId &outRid)
+  {
+    return tree->lookup(key, outRid);
+  }
+
+  /**
+   * Look up every entry with the given key. Does not touch the scan run by startScan.
+   * @param key            Key to look up, pointer to integer/double/char string
+   * @param outRids        Receives the RecordIds of the entries with the key, appended in index order.
+   *                       A posting list is read a page at a time, in order.
+   * @return               Number of entries found
+   **/
+  size_t lookupAll(const void *key, std::vector<RecordId> &outRids)
+  {
+    return tree->lookupAll(key, outRids);
+  }
+
+  /**
+   * Look up one entry for each of many keys. The keys are sorted internally and resolved in one walk
+   * over the tree: all keys falling in the same leaf are searched on it together, and the next leaf is
+   * reached from the lowest pinned node above it instead of from the root.
+   * Does not touch the scan run by startScan.
+   * @param keys           Array of the keys to look up, of the type of the index's keys, in any order, possibly repeated.
+   *                       For a STRING index, an array of pointers to char strings.
+   * @param n              Number of keys
+   * @param out            Receives, at the position of each key, the RecordId of an entry with the key
+   * @param found          Receives, at the position of each key, whether an entry with the key was found
+   * @return               Number of keys found
+   **/
+  size_t lookupMany(const void *keys, const size_t n, RecordId *out, bool *found)
+  {
+    return tree->lookupMany(keys, n, out, found);
+  }
+
+  /**
+   * Delete the entry with the pair <value,rid>.
+   * A leaf left with fewer than INTLEAFMIN entries borrows entries from a sibling, or is merged with it
+   * when the sibling cannot spare any. A merge removes a separator from the parent, which may in turn
+   * borrow from or merge with its own sibling, up to the root. The root is removed once it has a single
+   * non-leaf child. Pages freed by merges are reused by later inserts.
+   * No cursor may be open on the index. Only a delete that rebalances latches more than the leaf.
+   * @param key            Key to delete, pointer to integer/double/char string
+   * @param rid            Record ID of the record whose entry is getting deleted from the index.
+   *                       An entry in a posting list leaves the list, and the list its leaf once it is empty.
+   * @return               True if the entry was found and deleted, false if there is no such entry
+   **/
+  bool deleteEntry(const void *key, const RecordId rid)
+  {
+    return tree->deleteEntry(key, rid);
+  }
+
+  /**
+   * Count the entries in a range without scanning it: the counts kept in the non-leaf nodes are added up
+   * on the way down to the leaves holding the two bounds, so only O(height) nodes are read.
+   * Does not touch the scan run by startScan. Inserts and deletes running at the same time may or may not be counted.
+   * @param lowVal    Low value of range, pointer to integer / double / char string
+   * @param lowOp     Low operator (GT/GTE)
+   * @param highVal   High value of range, pointer to integer / double / char string
+   * @param highOp    High operator (LT/LTE)
+   * @return          Number of entries that satisfy the range
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+   **/
+  size_t countRange(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp)
+  {
+    return tree->countRange(lowVal, lowOp, highVal, highOp);
+  }
+
+  /**
+   * Get the counts of the pages the inserts and deletes on the index marked dirty
+   */
+  IndexWriteStats &getWriteStats()
+  {
+    return tree->getWriteStats();
+  }
+
+  /**
+   * Clear the counts of the pages the inserts and deletes on the index marked dirty
+   */
+  void clearWriteStats()
+  {
+    tree->clearWriteStats();
+  }
+
+  /**
+   * Read the smallest key in the index from the first leaf. Does not touch the scan run by startScan.
+   * @param outKey    Receives the smallest key, pointer to integer/double/StringKey
+   * @return          False if the index is empty, in which case outKey is left alone
+   **/
+  bool minKey(void *outKey)
+  {
+    return tree->minKey(outKey);
+  }
+
+  /**
+   * Read the largest key in the index from the last leaf. Does not touch the scan run by startScan.
+   * @param outKey    Receives the largest key, pointer to integer/double/StringKey
+   * @return          False if the index is empty, in which case outKey is left alone
+   **/
+  bool maxKey(void *outKey)
+  {
+    return tree->maxKey(outKey);
+  }
 
   /**
      * Begin a filtered scan of the index.  For instance, if the method is called
@@ -349,21 +2854,42 @@ public:
    * @param lowOp        Low operator (GT/GTE)
    * @param highVal    High value of range, pointer to integer / double / char string
    * @param highOp    High operator (LT/LTE)
+   * @param order     ASCENDING to return the entries from the low bound up, DESCENDING to start at the last
+   *                  entry that satisfies the high bound and return them from there down
+   * @param readAhead Number of leaves to read ahead of the one the scan is on, growing for long scans. The leaves
+   *                  are read by the buffer manager's prefetching thread while the scan goes on. 0 turns
+   *                  read-ahead off, values above MAX_READ_AHEAD or READ_AHEAD_POOL_PERCENT of the buffer pool
+   *                  are clamped.
    * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
    * @throws  BadScanrangeException If lowVal > highval
      * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
     **/
-  const void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp);
-    
-    /**
-      * Start from root to find out the leaf page that contains the first RecordID
-      * @param nl    the current page
-      * @param lowValParm    Low value of range, pointer to integer / double / char string
-      * @param index to store the index we find
-        * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
-       **/
-  const void startScanHeler(Page *nl, const void *lowValParm, int &index);
+  const void startScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp,
+                       const ScanOrder order = ASCENDING, const int readAhead = DEFAULT_READ_AHEAD)
+  {
+    tree->startScan(lowVal, lowOp, highVal, highOp, order, readAhead);
+  }
     
+  /**
+     * Begin a filtered scan of the index on a new cursor, independent of the scan run by startScan and of any other cursor.
+     * Takes the same parameters as startScan. The returned cursor keeps the leaf holding its next entry pinned until it is ended.
+   * @param lowVal    Low value of range, pointer to integer / double / char string
+   * @param lowOp        Low operator (GT/GTE)
+   * @param highVal    High value of range, pointer to integer / double / char string
+   * @param highOp    High operator (LT/LTE)
+   * @param order     Order in which the entries are returned, as for startScan
+   * @param readAhead Number of leaves to read ahead of the one the scan is on, as for startScan
+   * @return          Cursor positioned on the first entry, in the order of the scan, that satisfies the scan criteria
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+    **/
+  BTreeCursor openScan(const void *lowVal, const Operator lowOp, const void *highVal, const Operator highOp,
+                       const ScanOrder order = ASCENDING, const int readAhead = DEFAULT_READ_AHEAD)
+  {
+    return BTreeCursor(tree->openScan(lowVal, lowOp, highVal, highOp, order, readAhead));
+  }
+
   /**
      * Fetch the record id of the next index entry that matches the scan.
      * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
@@ -371,81 +2897,46 @@ public:
      * @throws ScanNotInitializedException If no scan has been initialized.
      * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
     **/
-  const void scanNext(RecordId &outRid); // returned record id
+  const void scanNext(RecordId &outRid) // returned record id
+  {
+    tree->scanNext(outRid);
+  }
+
+  /**
+   * Fetch the next qualifying entries of the scan started by startScan, a leaf at a time.
+   * @see BTreeCursor::scanNextBatch
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   **/
+  size_t scanNextBatch(RecordId *out, void *keysOut, const size_t max)
+  {
+    return tree->scanNextBatch(out, keysOut, max);
+  }
 
   /**
      * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
      * @throws ScanNotInitializedException If no scan has been initialized.
     **/
-  const void endScan();
-
-  /**
-   * Start from root to recursively find out the leaf to insert the entry in.
-   * The insertion may cause splitting of leaf node.
-   * If the node is full and splited, set splitted to true
-   * and save the PageId of the newly created node into newPageId
-   * so that the page can be added to its parent page.
-   *
-   * @param page is the page to recurse on
-   * @param level is the level of the page recursed on
-   * @param isRook record whether ths current page is root
-   * @param keyPtr is the pointer to the key
-   * @param rid is the rid of the node we need to insert
-   * @param splited records whether the node is splited
-   * @param childLeaf records whether the child node is a leaf
-   * @param newPageId records the child's page id if it is splited
-   *
-  **/
-  const void recurseInsert(Page *page, int level, bool isRoot, const void *keyPtr, const RecordId rid, bool &splited, bool &childLeaf, PageId &newPageId);
-
-  /**
-     * find the PageNo of the child to recurse
-     *
-     * @param page The page we are trying to find the child PageId on
-     * @param keyPtr Pointer to the key we are trying to find
-   * @param index to store the index we find
-  **/
-  const void findPageNo(Page *page, const void *keyPtr, int &index);
-
-  /**
-   * find the index of page for value at keyPtr
-   *
-     * @param page The page we are trying to find the child PageId on
-     * @param keyPtr Pointer to the key we are trying to find
-   * @param index to store the index we find
-  **/
-  const void findKey(Page *leafPage, const void *keyPtr, int &index);
+  const void endScan()
+  {
+    tree->endScan();
+  }
+};
 
-  /**
-   * find the middle value based on key
-   *
-   * @param page to find the middle value
-     * @param isLeaf
-     * @param keyPtr Pointer to the key
-     * @param middleIndex to record the middle index we find
-   **/
-  const void findMiddle(Page* page, bool isLeaf, const void* keyPtr, int &middleIndex);
+// The key of a record of a COMPOSITE index is made from all the attributes it is built over. Declared ahead of the
+// instantiations below, which would otherwise take the generic definition.
+template <>
+CompositeKey BTree<CompositeKey>::recordKey(const char *record, const size_t size) const;
 
-  /**
-   * inset in to non leaf page
-   *
-   * @param page to insert on
-   * @param keyPtr pointer to the key to insert
-   * @param pageId for the insertion
-  **/
-  const void insertNonLeaf(Page* page, const void* keyPtr, PageId pageId);
+extern template class BTree<int>;
+extern template class BTree<long long>;
+extern template class BTree<double>;
+extern template class BTree<StringKey>;
+extern template class BTree<CompositeKey>;
 
-  /**
-     * split a page
-   * use the key to determine the middle key
-     *
-     *@param fullPage The page to split
-     *@param isLeaf records whether the page is the leaf
-     *@param keyPtr The key we are trying to insert
-     *@param newPageIdChild from the child we are going to insert after spliting
-     *@param newPageId the PageId of the new page created after spliting
-    **/
-    const void split(Page* fullPage, bool isLeaf, const void* keyPtr, PageId newPageIdChild, PageId &newPageId);
-};
+extern template class BTreeScan<int>;
+extern template class BTreeScan<long long>;
+extern template class BTreeScan<double>;
+extern template class BTreeScan<StringKey>;
+extern template class BTreeScan<CompositeKey>;
 
 } // namespace badgerdb
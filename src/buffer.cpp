@@ -13,6 +13,7 @@
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/badgerdb_exception.h"
 
 namespace badgerdb { 
 
@@ -21,7 +22,7 @@ namespace badgerdb {
 //----------------------------------------
 
 BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+	: numBufs(bufs), stopping(false), reservedFrames(0) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -40,6 +41,17 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
 
 BufMgr::~BufMgr() {
+  // stop the prefetching thread, dropping what it has not read yet
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopping = true;
+  }
+  prefetchReady.notify_all();
+  if (prefetcher.joinable())
+  {
+    prefetcher.join();
+  }
+
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
@@ -58,7 +70,7 @@ void BufMgr::allocBuf(FrameId & frame)
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
+  // Called with the mutex held by the public operation
   std::uint32_t numScanned = 0;
   bool found = 0;
 
@@ -119,6 +131,8 @@ void BufMgr::allocBuf(FrameId & frame)
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
@@ -151,9 +165,130 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 }
 
 
+void BufMgr::prefetchPage(File* file, const PageId pageNo)
+{
+  prefetchPages(file, pageNo, 1, nullptr);
+}
+
+
+void BufMgr::prefetchPages(File* file, const PageId pageNo, const int count,
+                           const std::function<PageId(Page*)> &next)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // a queue as long as the pool has frames would only replace pages read ahead by others
+  if (count <= 0 || prefetchQueue.size() >= numBufs)
+  {
+    return;
+  }
+  PrefetchRequest request = {file, pageNo, count, next};
+  prefetchQueue.push_back(request);
+  if (!prefetcher.joinable())
+  {
+    prefetcher = std::thread(&BufMgr::prefetchLoop, this);
+  }
+  prefetchReady.notify_one();
+}
+
+
+void BufMgr::finishPrefetches()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  prefetchIdle.wait(lock, [this] { return prefetchQueue.empty(); });
+}
+
+
+void BufMgr::prefetchLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    prefetchReady.wait(lock, [this] { return stopping || !prefetchQueue.empty(); });
+    if (stopping)
+    {
+      return;
+    }
+    PrefetchRequest request = prefetchQueue.front();
+    prefetchQueue.pop_front();
+
+    try
+    {
+      FrameId frameNo = 0;
+      try
+      {
+        hashTable->lookup(request.file, request.pageNo, frameNo);
+
+        // already present, make sure it survives the next sweep of the clock
+        bufDescTable[frameNo].refbit = true;
+      }
+      catch(HashNotFoundException e)
+      {
+        allocBuf(frameNo);
+
+        bufStats.diskreads++;
+        bufStats.prefetchreads++;
+        bufPool[frameNo] = request.file->readPage(request.pageNo);
+
+        // set up the entry like readPage does, but leave the frame unpinned
+        bufDescTable[frameNo].Set(request.file, request.pageNo);
+        bufDescTable[frameNo].pinCnt = 0;
+
+        hashTable->insert(request.file, request.pageNo, frameNo);
+      }
+
+      // the rest of the run goes first, but after whatever the other threads are waiting for
+      if (request.count > 1 && request.next)
+      {
+        request.pageNo = request.next(&bufPool[frameNo]);
+        request.count--;
+        if (request.pageNo != Page::INVALID_NUMBER)
+        {
+          prefetchQueue.push_front(request);
+        }
+      }
+    }
+    catch(const BadgerDbException &e)
+    {
+      // every frame is pinned, or the page is gone: a prefetch is only a hint
+    }
+
+    if (prefetchQueue.empty())
+    {
+      prefetchIdle.notify_all();
+    }
+    lock.unlock();
+    std::this_thread::yield();
+    lock.lock();
+  }
+}
+
+
+bool BufMgr::reserveFrame(const int percent)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (reservedFrames >= numBufs * percent / 100)
+  {
+    return false;
+  }
+  reservedFrames++;
+  return true;
+}
+
+
+void BufMgr::releaseFrames(const std::uint32_t count)
+{
+  std::lock_guard<std::mutex> guard(mutex);
+
+  reservedFrames -= count;
+}
+
+
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
@@ -170,6 +305,18 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
+  // the prefetching thread only reads the file with the mutex held, so once these are gone it is done with it
+  for (std::deque<PrefetchRequest>::iterator it = prefetchQueue.begin(); it != prefetchQueue.end();)
+  {
+    it = (it->file == file) ? prefetchQueue.erase(it) : it + 1;
+  }
+  if (prefetchQueue.empty())
+  {
+    prefetchIdle.notify_all();
+  }
+
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
@@ -195,6 +342,8 @@ void BufMgr::flushFile(const File* file)
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
@@ -212,6 +361,8 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::lock_guard<std::mutex> guard(mutex);
+
   FrameId frameNo;
 
   // alloc a new frame
@@ -9,7 +9,13 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "latch.h"
 #include <iostream>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <functional>
+#include <condition_variable>
 
 namespace badgerdb {
 
@@ -61,6 +67,12 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * Version latch over the contents of the frame. Only meaningful while the frame is pinned,
+   * so it is left alone when the frame is cleared for another page.
+	 */
+  VersionLatch latch;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -137,12 +149,17 @@ struct BufStats
 	 */
   int diskwrites;
 
+	/**
+   * Number of the disk reads made by the prefetching thread, which are counted in diskreads too
+	 */
+  int prefetchreads;
+
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = diskreads = diskwrites = prefetchreads = 0;
   }
       
 	/**
@@ -187,6 +204,59 @@ class BufMgr
   BufStats bufStats;
 
 	/**
+   * Serializes the public operations, so that any number of threads can share the buffer pool
+	 */
+  std::mutex mutex;
+
+	/**
+   * @brief A page to read into the buffer pool ahead of time, and how many of the pages that follow it to read
+   * after it. next gives the page that follows a page once it is in the pool, or Page::INVALID_NUMBER to stop.
+	 */
+  struct PrefetchRequest
+  {
+    File* file;
+    PageId pageNo;
+    int count;
+    std::function<PageId(Page*)> next;
+  };
+
+	/**
+   * Pages waiting for the prefetching thread, guarded by the mutex
+	 */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+	/**
+   * Signalled when a request is queued, or when the prefetching thread has to stop
+	 */
+  std::condition_variable prefetchReady;
+
+	/**
+   * Signalled when the prefetching thread has emptied the queue
+	 */
+  std::condition_variable prefetchIdle;
+
+	/**
+   * Thread reading the queued pages, started by the first prefetch
+	 */
+  std::thread prefetcher;
+
+	/**
+   * True once the prefetching thread has to stop
+	 */
+  bool stopping;
+
+	/**
+   * Number of frames reserved through reserveFrame(), over all their owners, guarded by the mutex
+	 */
+  std::uint32_t reservedFrames;
+
+	/**
+   * Body of the prefetching thread: read the queued pages, one page at a time with the mutex held, so that
+   * the other threads get the pool in between two reads
+	 */
+  void prefetchLoop();
+
+	/**
 	 * Allocate a free frame.  
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
@@ -230,6 +300,35 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Queues the given page to be read from the file into a frame by a background thread, without pinning it,
+	 * so that a later readPage() finds it in the buffer pool. Returns at once. Nothing is read if the page is
+	 * already present. The frame can be replaced like any other unpinned frame. A prefetch is a hint: one that
+	 * cannot be done, because every frame is pinned or the page does not exist, is dropped.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 */
+  void prefetchPage(File* file, const PageId PageNo);
+
+	/**
+	 * Queues the given page and up to count - 1 of the pages that follow it to be read like prefetchPage()
+	 * reads a page. The page that follows a page is only known once the page is in the pool: the background
+	 * thread calls next on the page for it, with the page unpinned and the buffer pool locked, so next must not
+	 * call the BufMgr. Page::INVALID_NUMBER from next ends the run.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file of the first page to be read
+	 * @param count   Number of pages to read at most
+	 * @param next    Page number of the page that follows a page
+	 */
+  void prefetchPages(File* file, const PageId PageNo, const int count, const std::function<PageId(Page*)> &next);
+
+	/**
+	 * Waits until the background thread has read every page queued so far
+	 */
+  void finishPrefetches();
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -254,6 +353,7 @@ class BufMgr
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
+	 * The prefetches of the file still queued are dropped, so that the file can be closed once this returns.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
@@ -271,11 +371,55 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Version latch of the frame holding a pinned page. The latch protects the contents of the page
+	 * for as long as it stays pinned; the buffer manager itself never takes it.
+	 *
+	 * @param page  	Page returned by readPage() or allocPage() and still pinned
+	 */
+  VersionLatch & pageLatch(const Page* page)
+  {
+		return bufDescTable[page - bufPool].latch;
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
 
 	/**
+	 * Reserve a frame its owner keeps pinned for as long as it likes, such as a node an index caches. All owners
+	 * share the reservations, so that together they never pin more than the given share of the pool.
+	 *
+	 * @param percent  	Percentage of the frames in the pool the reservations may reach
+	 * @return  False if the reservations have reached it already
+	 */
+  bool reserveFrame(const int percent);
+
+	/**
+	 * Give back frames reserved through reserveFrame(), once their owner has unpinned them.
+	 *
+	 * @param count  	Number of frames to give back
+	 */
+  void releaseFrames(const std::uint32_t count);
+
+	/**
+   * Get the number of frames reserved through reserveFrame() by all their owners
+	 */
+  std::uint32_t getReservedFrames()
+  {
+		std::lock_guard<std::mutex> guard(mutex);
+		return reservedFrames;
+  }
+
+	/**
+   * Get the number of frames in the buffer pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+	/**
    * Get buffer pool usage statistics
 	 */
   BufStats & getBufStats()
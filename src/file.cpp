@@ -11,7 +11,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
-#include <cstdio>r
+#include <cstdio>
 #include <cassert>
 
 #include "exceptions/file_exists_exception.h"
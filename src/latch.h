@@ -0,0 +1,196 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Version latch for optimistic lock coupling.
+ *
+ * The version is even while the latch is free and odd while a writer holds it. Taking and releasing
+ * the latch both increment it, so a reader that sees the same even version before and after reading
+ * the data the latch protects knows that no writer changed the data in between. Readers never write
+ * the latch, so they do not slow each other down.
+ */
+class VersionLatch
+{
+public:
+  VersionLatch() : version(0)
+  {
+  }
+
+  /**
+   * Wait until no writer holds the latch.
+   *
+   * @return  Version to validate the reads against
+   */
+  std::uint64_t readLock() const
+  {
+    std::uint64_t v = version.load(std::memory_order_acquire);
+    while (v & 1)
+    {
+      std::this_thread::yield();
+      v = version.load(std::memory_order_acquire);
+    }
+    return v;
+  }
+
+  /**
+   * Read the version if no writer holds the latch. Never waits.
+   *
+   * @param v   Receives the version to validate the reads against
+   * @return    False if a writer holds the latch, in which case the data it protects must not be read
+   */
+  bool tryReadLock(std::uint64_t &v) const
+  {
+    v = version.load(std::memory_order_acquire);
+    return (v & 1) == 0;
+  }
+
+  /**
+   * Whether no writer has taken the latch since readLock() returned the version,
+   * i.e. whether everything read in between is consistent.
+   *
+   * @param v   Version returned by readLock()
+   */
+  bool validate(const std::uint64_t v) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version.load(std::memory_order_relaxed) == v;
+  }
+
+  /**
+   * Take the latch for writing if it is still at the version, i.e. if nothing changed since it was read.
+   * Never waits.
+   *
+   * @param v   Version returned by readLock()
+   * @return    True if the latch was taken
+   */
+  bool tryUpgrade(const std::uint64_t v)
+  {
+    std::uint64_t expected = v;
+    return (v & 1) == 0 && version.compare_exchange_strong(expected, v + 1, std::memory_order_acquire);
+  }
+
+  /**
+   * Take the latch for writing if no writer holds it. Never waits.
+   *
+   * @return    True if the latch was taken
+   */
+  bool tryLock()
+  {
+    return tryUpgrade(version.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Take the latch for writing, waiting for the writer holding it if needed.
+   */
+  void lock()
+  {
+    while (!tryLock())
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * Release the latch taken for writing.
+   *
+   * @return  Version readers see from now on
+   */
+  std::uint64_t unlock()
+  {
+    std::uint64_t v = version.load(std::memory_order_relaxed) + 1;
+    version.store(v, std::memory_order_release);
+    return v;
+  }
+
+private:
+  std::atomic<std::uint64_t> version;
+};
+
+/**
+ * @brief Latch held shared by any number of threads at once, or exclusively by one.
+ *
+ * A thread waiting to take it exclusively keeps new shared holders out, so that a steady stream of them
+ * cannot hold it off. A holder must not take it again, shared or not, before releasing it.
+ */
+class SharedLatch
+{
+public:
+  SharedLatch() : state(0)
+  {
+  }
+
+  /**
+   * Take the latch shared, waiting while it is held or wanted exclusively.
+   */
+  void lockShared()
+  {
+    while (true)
+    {
+      std::uint32_t s = state.load(std::memory_order_relaxed);
+      if ((s & EXCLUSIVE) == 0 && state.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+      {
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * Release the latch taken shared.
+   */
+  void unlockShared()
+  {
+    state.fetch_sub(1, std::memory_order_release);
+  }
+
+  /**
+   * Take the latch exclusively, waiting for the other exclusive holder and then for the shared holders to leave.
+   */
+  void lock()
+  {
+    while (true)
+    {
+      std::uint32_t s = state.load(std::memory_order_relaxed);
+      if ((s & EXCLUSIVE) == 0 && state.compare_exchange_weak(s, s | EXCLUSIVE, std::memory_order_acquire))
+      {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    while (state.load(std::memory_order_acquire) != EXCLUSIVE)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * Release the latch taken exclusively.
+   */
+  void unlock()
+  {
+    state.store(0, std::memory_order_release);
+  }
+
+private:
+  /**
+   * Bit set while the latch is held or wanted exclusively. The bits below count the shared holders.
+   */
+  static const std::uint32_t EXCLUSIVE = 1u << 31;
+
+  std::atomic<std::uint32_t> state;
+};
+
+} // namespace badgerdb
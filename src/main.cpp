@@ -6,7 +6,14 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <thread>
+#include <atomic>
 #include "btree.h"
+#include "node_search.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
@@ -19,6 +26,7 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -46,6 +54,8 @@ const int	relationSize = 5000;
 
 //large relation sizes for testing split fuctions
 const int   largerelationSize = 100000;
+// number of distinct keys in the relation of test24
+const int   duplicateKeys = 16;
 
 const int   maxrelationsize  = 300000;
 
@@ -76,10 +86,49 @@ void createRelationRandom();
 void createLargeRelationForward();
 void createLargeRelationBackward();
 void createLargeRelationRandom();
+void createLargeRelationDuplicates();
+void createLargeRelationIdentifiers();
+void createLargeRelationPairs();
 void createMaxRelationForward();
 void createMaxRelationBackward();
 void createMaxRelationRandom();
 void intTests();
+void fillFactorTests(double fillFactor);
+void nodeSearchTests();
+void cursorTests();
+void batchScanTests();
+int batchScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void batchInsertTests();
+int keyScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void deleteTests();
+void lookupTests();
+void lookupManyTests();
+void readAheadTests();
+int readAheadScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, int readAhead);
+void reverseScanTests();
+int reverseScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void concurrentTests();
+void blinkTests();
+void countTests();
+void duplicateTests();
+void compressTests();
+void appendTests();
+void nodeCacheTests();
+void nodeCacheLimitTests();
+void redistributeTests();
+int indexPages(bool redistributeLeaves, const std::vector<int> &keys);
+void writeTests();
+void doubleKeyTests();
+void bigintKeyTests();
+void doubleOrderTests();
+void stringKeyTests();
+void stringNodeTests();
+void compositeKeyTests();
+void parallelBuildTests();
+int orderedScan(BTreeIndex *index, int lowVal, int highVal, ScanOrder order);
+int rangeCount(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int duplicateScan(BTreeIndex *index, int lowVal, int highVal, ScanOrder order);
+bool ridBefore(const RecordId &r1, const RecordId &r2);
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
 void indexTests();
 void emptyTests();
@@ -98,6 +147,33 @@ void test7();
 void test8();
 void test9();
 void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
+void test35();
+void test36();
+void test37();
 void errorTests();
 void deleteRelation();
 
@@ -172,6 +248,33 @@ int main(int argc, char **argv)
     test8();
     test9();
     test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+	test29();
+	test30();
+	test31();
+	test32();
+	test33();
+	test34();
+	test35();
+	test36();
+	test37();
 	errorTests();
 	std::cout << "Pass all tests!" << std::endl;
 
@@ -279,373 +382,632 @@ void test10()
     deleteRelation();
 }
 
-
-// -----------------------------------------------------------------------------
-// createRelationForward
-// -----------------------------------------------------------------------------
-
-void createRelationForward()
+void test11()
 {
-	std::vector<RecordId> ridVec;
-  // destroy any old copies of relation file
-	try
-	{
-		File::remove(relationName);
-	}
-	catch(FileNotFoundException e)
-	{
-	}
-
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < relationSize; i++ )
-	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-  }
-
-	file1->writePage(new_page_number, new_page);
+    // Create a relation with tuples valued 0 to a max relation size in random order and bulk load it with a low fill factor, so that the tree gets more than one non-leaf level, then insert past the end of it
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createMaxRelationRandom, fill factor 0.1" << std::endl;
+    createMaxRelationRandom();
+    // the empty tree test leaves its index file behind
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    fillFactorTests(0.1);
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createRelationBackward
-// -----------------------------------------------------------------------------
-
-void createRelationBackward()
+void test12()
 {
-  // destroy any old copies of relation file
-	try
-	{
-		File::remove(relationName);
-	}
-	catch(FileNotFoundException e)
-	{
-	}
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // Insert a bunch of tuples into the relation.
-  for(int i = relationSize - 1; i >= 0; i-- )
-	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
-
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-  }
-
-	file1->writePage(new_page_number, new_page);
+    // Check every in-node search kernel the CPU supports against a linear count, on key arrays padded with INT32_MAX like the nodes are
+    std::cout << "---------------------" << std::endl;
+    std::cout << "nodeSearchTests" << std::endl;
+    nodeSearchTests();
 }
 
-// -----------------------------------------------------------------------------
-// createRelationRandom
-// -----------------------------------------------------------------------------
-
-void createRelationRandom()
+void test13()
 {
-  // destroy any old copies of relation file
-	try
-	{
-		File::remove(relationName);
-	}
-	catch(FileNotFoundException e)
-	{
-	}
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // insert records in random order
-
-  std::vector<int> intvec(relationSize);
-  for( int i = 0; i < relationSize; i++ )
-  {
-    intvec[i] = i;
-  }
-
-  long pos;
-  int val;
-	int i = 0;
-  while( i < relationSize )
-  {
-    pos = random() % (relationSize-i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
-
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
-
-		int temp = intvec[relationSize-1-i];
-		intvec[relationSize-1-i] = intvec[pos];
-		intvec[pos] = temp;
-		i++;
-  }
-  
-	file1->writePage(new_page_number, new_page);
+    // Create a relation with tuples valued 0 to a large relation size in random order and run several interleaved cursors on one index
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, cursors" << std::endl;
+    createLargeRelationRandom();
+    cursorTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
 }
 
-
-// -----------------------------------------------------------------------------
-// createLargeRelationForward
-// -----------------------------------------------------------------------------
-
-void createLargeRelationForward()
+void test14()
 {
-    std::vector<RecordId> ridVec;
-  // destroy any old copies of relation file
+    // Create a relation with tuples valued 0 to a large relation size in backward order and scan it a leaf at a time
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationBackward, batched scans" << std::endl;
+    createLargeRelationBackward();
+    batchScanTests();
     try
     {
-        File::remove(relationName);
+        File::remove(intIndexName);
     }
     catch(FileNotFoundException e)
     {
     }
+    deleteRelation();
+}
 
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < largerelationSize; i++ )
+void test15()
+{
+    // Create an empty relation and fill its index through batches of interleaved keys, so that every batch merges into full leaves
+    std::cout << "---------------------" << std::endl;
+    std::cout << "EmptyTree, batch inserts" << std::endl;
+    createEmpty();
+    try
     {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-        }
-  }
-
-    file1->writePage(new_page_number, new_page);
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    batchInsertTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createLargeRelationBackward
-// -----------------------------------------------------------------------------
-
-void createLargeRelationBackward()
+void test16()
 {
-  // destroy any old copies of relation file
+    // Create a relation with tuples valued 0 to a large relation size in random order, then delete from and reinsert into its index
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, deletes" << std::endl;
+    createLargeRelationRandom();
+    deleteTests();
     try
     {
-        File::remove(relationName);
+        File::remove(intIndexName);
     }
     catch(FileNotFoundException e)
     {
     }
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+    deleteRelation();
+}
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = largerelationSize - 1; i >= 0; i-- )
+void test17()
+{
+    // Create a relation with tuples valued 0 to relation size in random order and probe its index for single keys
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createRelationRandom, lookups" << std::endl;
+    createRelationRandom();
+    lookupTests();
+    try
     {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
-
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-        }
-  }
+void test18()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order and probe its index for many keys at once
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, multi-get" << std::endl;
+    createLargeRelationRandom();
+    lookupManyTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-    file1->writePage(new_page_number, new_page);
+void test19()
+{
+    // Create a relation with tuples valued 0 to a max relation size in forward order and run long range scans that read leaves ahead
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createMaxRelationForward, read-ahead" << std::endl;
+    createMaxRelationForward();
+    readAheadTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createLargeRelationRandom
-// -----------------------------------------------------------------------------
+void test20()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order and scan its index backwards
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, reverse scans" << std::endl;
+    createLargeRelationRandom();
+    reverseScanTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-void createLargeRelationRandom()
+void test21()
 {
-  // destroy any old copies of relation file
+    // Create a relation with tuples valued 0 to a large relation size in random order and use its index from several threads at once
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, concurrent threads" << std::endl;
+    createLargeRelationRandom();
+    concurrentTests();
     try
     {
-        File::remove(relationName);
+        File::remove(intIndexName);
     }
     catch(FileNotFoundException e)
     {
     }
-  file1 = new PageFile(relationName, true);
+    deleteRelation();
+}
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+void test22()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order and scan its index while other threads split its leaves
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, scans during inserts" << std::endl;
+    createLargeRelationRandom();
+    blinkTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-  // insert records in random order
+void test23()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order and count ranges of its index while other threads change it
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, range counts" << std::endl;
+    createLargeRelationRandom();
+    countTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-  std::vector<int> intvec(largerelationSize);
-  for( int i = 0; i < largerelationSize; i++ )
-  {
-    intvec[i] = i;
-  }
+void test24()
+{
+    // Create a relation whose tuples share a few key values and index it with posting lists
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationDuplicates" << std::endl;
+    createLargeRelationDuplicates();
+    duplicateTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-  long pos;
-  int val;
-    int i = 0;
-  while( i < largerelationSize )
-  {
-    pos = random() % (largerelationSize-i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
+void test25()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order and index it with packed leaves
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, packed leaves" << std::endl;
+    createLargeRelationRandom();
+    compressTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+void test26()
+{
+    // Create an empty relation and insert keys into its index in ascending order, as time-ordered data comes in
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, ascending inserts" << std::endl;
+    createEmpty();
+    appendTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-          file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-        }
+void test27()
+{
+  // Create a relation with tuples valued 0 to relationSize in random order and keep the upper levels of its index
+  // pinned while the relation itself streams through the buffer pool
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, cached non-leaf levels" << std::endl;
+    createLargeRelationRandom();
+    nodeCacheTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-        int temp = intvec[largerelationSize-1-i];
-        intvec[largerelationSize-1-i] = intvec[pos];
-        intvec[pos] = temp;
-        i++;
-  }
-  
-    file1->writePage(new_page_number, new_page);
+void test28()
+{
+    // Create an empty relation and insert keys into its index in random order, sharing the entries of full leaves
+    // with their siblings
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, random inserts with redistribution" << std::endl;
+    createEmpty();
+    redistributeTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
 }
 
-// -----------------------------------------------------------------------------
-// createmaxRelationForward
-// -----------------------------------------------------------------------------
+void test29()
+{
+    // Create an empty relation and count the pages its index writes for random inserts and deletes
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, pages written per insert" << std::endl;
+    createEmpty();
+    writeTests();
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-void createMaxRelationForward()
+void test30()
 {
-    std::vector<RecordId> ridVec;
-  // destroy any old copies of relation file
+    // Create a relation with random keys and index its double field
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, DOUBLE keys" << std::endl;
+    createLargeRelationRandom();
+    doubleKeyTests();
     try
     {
-        File::remove(relationName);
+        File::remove(doubleIndexName);
     }
     catch(FileNotFoundException e)
     {
     }
+    deleteRelation();
+}
 
-  file1 = new PageFile(relationName, true);
+void test31()
+{
+    // Create an empty relation and insert 64 bit keys into its index
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, BIGINT keys" << std::endl;
+    createEmpty();
+    bigintKeyTests();
+    deleteRelation();
+}
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+void test32()
+{
+    // Create a relation with string identifiers that share their first bytes, and index them
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationIdentifiers, STRING keys" << std::endl;
+    createLargeRelationIdentifiers();
+    stringKeyTests();
+    try
+    {
+        File::remove(stringIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < maxrelationsize; i++ )
+void test33()
+{
+    // Create an empty relation and insert string keys sharing long prefixes into its index
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, STRING keys with shared prefixes" << std::endl;
+    createEmpty();
+    stringNodeTests();
+    try
     {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+        File::remove(stringIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
 
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
+void test34()
+{
+    // Create an empty relation and insert double keys of both signs into its index
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createEmpty, DOUBLE keys of both signs" << std::endl;
+    createEmpty();
+    doubleOrderTests();
+    deleteRelation();
+}
+
+void test35()
+{
+    // Create a relation whose records repeat their int field, and index them on the int and double fields together
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationPairs, COMPOSITE keys" << std::endl;
+    createLargeRelationPairs();
+    compositeKeyTests();
+    deleteRelation();
+}
+
+void test36()
+{
+    // Create a relation with tuples valued 0 to a large relation size in random order, and bulk load indexes on it with several threads
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, parallel build" << std::endl;
+    createLargeRelationRandom();
+    parallelBuildTests();
+    deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// createRelationForward
+// -----------------------------------------------------------------------------
+
+void createRelationForward()
+{
+	std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(InsufficientSpaceException e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationBackward
+// -----------------------------------------------------------------------------
+
+void createRelationBackward()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = relationSize - 1; i >= 0; i-- )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(InsufficientSpaceException e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationRandom
+// -----------------------------------------------------------------------------
+
+void createRelationRandom()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(relationSize);
+  for( int i = 0; i < relationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+	int i = 0;
+  while( i < relationSize )
+  {
+    pos = random() % (relationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(InsufficientSpaceException e)
+			{
+      	file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+
+		int temp = intvec[relationSize-1-i];
+		intvec[relationSize-1-i] = intvec[pos];
+		intvec[pos] = temp;
+		i++;
+  }
+  
+	file1->writePage(new_page_number, new_page);
+}
+
+
+// -----------------------------------------------------------------------------
+// createLargeRelationForward
+// -----------------------------------------------------------------------------
+
+void createLargeRelationForward()
+{
+    std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = 0; i < largerelationSize; i++ )
+    {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
               new_page = file1->allocatePage(new_page_number);
             }
         }
@@ -654,157 +1016,3242 @@ void createMaxRelationForward()
     file1->writePage(new_page_number, new_page);
 }
 
-// -----------------------------------------------------------------------------
-// createMaxRelationBackward
-// -----------------------------------------------------------------------------
-
-void createMaxRelationBackward()
+// -----------------------------------------------------------------------------
+// createLargeRelationBackward
+// -----------------------------------------------------------------------------
+
+void createLargeRelationBackward()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = largerelationSize - 1; i >= 0; i-- )
+    {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+  }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createLargeRelationRandom
+// -----------------------------------------------------------------------------
+
+void createLargeRelationRandom()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(largerelationSize);
+  for( int i = 0; i < largerelationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+    int i = 0;
+  while( i < largerelationSize )
+  {
+    pos = random() % (largerelationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+          file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+
+        int temp = intvec[largerelationSize-1-i];
+        intvec[largerelationSize-1-i] = intvec[pos];
+        intvec[pos] = temp;
+        i++;
+  }
+  
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createLargeRelationIdentifiers
+// -----------------------------------------------------------------------------
+
+void createLargeRelationIdentifiers()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order. Every four identifiers share their first STRINGSIZE bytes.
+
+  std::vector<int> intvec(largerelationSize);
+  for( int i = 0; i < largerelationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+    int i = 0;
+  while( i < largerelationSize )
+  {
+    pos = random() % (largerelationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "ext:%012d-%02d", val / 4, val % 4);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+          file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+
+        int temp = intvec[largerelationSize-1-i];
+        intvec[largerelationSize-1-i] = intvec[pos];
+        intvec[pos] = temp;
+        i++;
+  }
+  
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createLargeRelationPairs
+// -----------------------------------------------------------------------------
+
+void createLargeRelationPairs()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order. Record val has the int val % 50 and the double val / 50 * 0.5 - 500,
+  // so every int comes with doubles of both signs.
+
+  std::vector<int> intvec(largerelationSize);
+  for( int i = 0; i < largerelationSize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+    int i = 0;
+  while( i < largerelationSize )
+  {
+    pos = random() % (largerelationSize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val % 50;
+    record1.d = (val / 50) * 0.5 - 500;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+          file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+
+        int temp = intvec[largerelationSize-1-i];
+        intvec[largerelationSize-1-i] = intvec[pos];
+        intvec[pos] = temp;
+        i++;
+  }
+  
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createLargeRelationDuplicates
+// -----------------------------------------------------------------------------
+
+void createLargeRelationDuplicates()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // the integer field cycles through duplicateKeys values, the other two stay unique
+  for(int i = 0; i < largerelationSize; i++ )
+    {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i % duplicateKeys;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+  }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createmaxRelationForward
+// -----------------------------------------------------------------------------
+
+void createMaxRelationForward()
+{
+    std::vector<RecordId> ridVec;
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = 0; i < maxrelationsize; i++ )
+    {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+  }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createMaxRelationBackward
+// -----------------------------------------------------------------------------
+
+void createMaxRelationBackward()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+  for(int i = maxrelationsize - 1; i >= 0; i-- )
+    {
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = i;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+                file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+  }
+
+    file1->writePage(new_page_number, new_page);
+}
+
+// -----------------------------------------------------------------------------
+// createMaxRelationRandom
+// -----------------------------------------------------------------------------
+
+void createMaxRelationRandom()
+{
+  // destroy any old copies of relation file
+    try
+    {
+        File::remove(relationName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+  file1 = new PageFile(relationName, true);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+    PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // insert records in random order
+
+  std::vector<int> intvec(maxrelationsize);
+  for( int i = 0; i < maxrelationsize; i++ )
+  {
+    intvec[i] = i;
+  }
+
+  long pos;
+  int val;
+    int i = 0;
+  while( i < maxrelationsize )
+  {
+    pos = random() % (maxrelationsize-i);
+    val = intvec[pos];
+    sprintf(record1.s, "%05d string record", val);
+    record1.i = val;
+    record1.d = val;
+
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+
+        while(1)
+        {
+            try
+            {
+            new_page.insertRecord(new_data);
+                break;
+            }
+            catch(InsufficientSpaceException e)
+            {
+          file1->writePage(new_page_number, new_page);
+              new_page = file1->allocatePage(new_page_number);
+            }
+        }
+
+        int temp = intvec[maxrelationsize-1-i];
+        intvec[maxrelationsize-1-i] = intvec[pos];
+        intvec[pos] = temp;
+        i++;
+  }
+  
+    file1->writePage(new_page_number, new_page);
+}
+
+
+// -----------------------------------------------------------------------------
+// indexTests
+// -----------------------------------------------------------------------------
+
+void indexTests()
+{
+  if(testNum == 1)
+  {
+    intTests();
+        try
+        {
+            File::remove(intIndexName);
+        }
+      catch(FileNotFoundException e)
+      {
+      }
+  }
+}
+
+
+// -----------------------------------------------------------------------------
+// intTests
+// -----------------------------------------------------------------------------
+
+void intTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// run some tests
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(&index,0,GT,1,LT), 0)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+}
+
+// -----------------------------------------------------------------------------
+// fillFactorTests
+// -----------------------------------------------------------------------------
+
+void fillFactorTests(double fillFactor)
+{
+  std::cout << "Bulk load a B+ Tree index on the integer field with fill factor " << fillFactor << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, fillFactor);
+
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(intScan(&index,maxrelationsize - 10,GTE,maxrelationsize,LT), 10)
+
+	// the inserted keys all point at the record with key 0
+	RecordId zeroRid;
+	int zero = 0;
+	index.startScan(&zero, GTE, &zero, LTE);
+	index.scanNext(zeroRid);
+	index.endScan();
+
+	for(int i = maxrelationsize; i < maxrelationsize + 2000; i++)
+	{
+		index.insertEntry(&i, zeroRid);
+	}
+	checkPassFail(intScan(&index,maxrelationsize - 10,GTE,maxrelationsize + 2000,LT), 2010)
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+}
+
+// -----------------------------------------------------------------------------
+// nodeSearchTests
+// -----------------------------------------------------------------------------
+
+void nodeSearchTests()
+{
+	const SearchKernel kernels[] = {SEARCH_SCALAR, SEARCH_SSE42, SEARCH_AVX2};
+	const int sizes[] = {INTARRAYLEAFSIZE, INTARRAYNONLEAFSIZE};
+	std::vector<int> keys(INTARRAYNONLEAFSIZE);
+
+	for(int k = 0; k < 3; k++)
+	{
+		if(NodeSearch::setKernel(kernels[k]) != kernels[k])
+		{
+			std::cout << "Search kernel " << kernels[k] << " not supported by this CPU" << std::endl;
+			continue;
+		}
+		std::cout << "Search kernel " << kernels[k] << std::endl;
+
+		int mismatches = 0;
+		for(int s = 0; s < 2; s++)
+		{
+			for(int filled = 0; filled <= sizes[s]; filled += 31)
+			{
+				// odd keys from -501 up, then the empty-slot marker
+				for(int i = 0; i < sizes[s]; i++)
+				{
+					keys[i] = (i < filled) ? 2 * i - 501 : INT32_MAX;
+				}
+				for(int key = -505; key < 2 * filled - 495; key++)
+				{
+					int less = 0, lessOrEqual = 0;
+					for(int i = 0; i < filled; i++)
+					{
+						less += keys[i] < key;
+						lessOrEqual += keys[i] <= key;
+					}
+					mismatches += NodeSearch::lowerBound(&keys[0], sizes[s], key) != less;
+					mismatches += NodeSearch::upperBound(&keys[0], sizes[s], key) != lessOrEqual;
+				}
+			}
+		}
+		checkPassFail(mismatches, 0)
+
+		// the 16-bit kernels of packed leaves: deltas in steps of three up to the top of their range,
+		// each twice, then the padding; and their widening back to keys
+		mismatches = 0;
+		std::vector<std::uint16_t> deltas(PACKEDLEAFSIZE);
+		std::vector<int> decoded(PACKEDLEAFSIZE);
+		for(int filled = 0; filled <= PACKEDLEAFSIZE; filled += 37)
+		{
+			for(int i = 0; i < PACKEDLEAFSIZE; i++)
+			{
+				deltas[i] = (i < filled) ? (std::uint16_t)(PACKED_MAX_DELTA - 3 * ((filled - 1 - i) / 2)) : 0xFFFF;
+			}
+			for(int key = PACKED_MAX_DELTA - 3 * filled / 2 - 2; key <= PACKED_MAX_DELTA; key++)
+			{
+				int less = 0, lessOrEqual = 0;
+				for(int i = 0; i < filled; i++)
+				{
+					less += deltas[i] < key;
+					lessOrEqual += deltas[i] <= key;
+				}
+				mismatches += NodeSearch::lowerBound16(&deltas[0], PACKEDLEAFSIZE, (std::uint16_t)key) != less;
+				mismatches += NodeSearch::upperBound16(&deltas[0], PACKEDLEAFSIZE, (std::uint16_t)key) != lessOrEqual;
+			}
+			NodeSearch::decode16(&deltas[0], filled, -70000, &decoded[0]);
+			for(int i = 0; i < filled; i++)
+			{
+				mismatches += decoded[i] != deltas[i] - 70000;
+			}
+		}
+		checkPassFail(mismatches, 0)
+
+		// the 64-bit kernels of BIGINT and DOUBLE nodes: keys of both signs that differ only in their upper 32 bits,
+		// probed at, just below and just above each of them
+		mismatches = 0;
+		const int sizes64[] = {LeafNode<long long>::CAPACITY, NonLeafNode<long long>::CAPACITY};
+		std::vector<long long> keys64(std::max(sizes64[0], sizes64[1]));
+		for(int s = 0; s < 2; s++)
+		{
+			for(int filled = 0; filled <= sizes64[s]; filled += 29)
+			{
+				for(int i = 0; i < sizes64[s]; i++)
+				{
+					keys64[i] = (i < filled) ? ((long long)(2 * i - 301) << 32) + 7 : INT64_MAX;
+				}
+				for(int key = -305; key < 2 * filled - 295; key++)
+				{
+					for(int offset = 6; offset <= 8; offset++)
+					{
+						long long probe = ((long long)key << 32) + offset;
+						int less = 0, lessOrEqual = 0;
+						for(int i = 0; i < filled; i++)
+						{
+							less += keys64[i] < probe;
+							lessOrEqual += keys64[i] <= probe;
+						}
+						mismatches += NodeSearch::lowerBound(&keys64[0], sizes64[s], probe) != less;
+						mismatches += NodeSearch::upperBound(&keys64[0], sizes64[s], probe) != lessOrEqual;
+					}
+				}
+			}
+		}
+		checkPassFail(mismatches, 0)
+	}
+
+	// searches stay exact while another thread keeps switching between the kernels
+	for(int i = 0; i < INTARRAYNONLEAFSIZE; i++)
+	{
+		keys[i] = 2 * i;
+	}
+	std::atomic<bool> switching(true);
+	std::thread switcher([&kernels, &switching]()
+	{
+		for(int k = 0; switching; k = (k + 1) % 3)
+		{
+			NodeSearch::setKernel(kernels[k]);
+		}
+	});
+	int mismatches = 0;
+	for(int round = 0; round < 20; round++)
+	{
+		for(int key = -1; key < 2 * INTARRAYNONLEAFSIZE; key++)
+		{
+			mismatches += NodeSearch::lowerBound(&keys[0], INTARRAYNONLEAFSIZE, key) != (key + 1) / 2;
+			mismatches += NodeSearch::upperBound(&keys[0], INTARRAYNONLEAFSIZE, key) != (key + 2) / 2;
+		}
+	}
+	switching = false;
+	switcher.join();
+	checkPassFail(mismatches, 0)
+
+	NodeSearch::setKernel(NodeSearch::detectKernel());
+}
+
+// -----------------------------------------------------------------------------
+// cursorTests
+// -----------------------------------------------------------------------------
+
+void cursorTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and open several cursors on it" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	const int numCursors = 4;
+	int lowVals[numCursors] = {0, 25, 5000, 99000};
+	int highVals[numCursors] = {3000, 25, 9000, 100000};
+	Operator lowOps[numCursors] = {GTE, GTE, GT, GTE};
+	Operator highOps[numCursors] = {LT, LTE, LTE, LT};
+	int expected[numCursors] = {3000, 1, 4000, 1000};
+
+	std::vector<BTreeCursor> cursors;
+	for(int c = 0; c < numCursors; c++)
+	{
+		cursors.push_back(index.openScan(&lowVals[c], lowOps[c], &highVals[c], highOps[c]));
+	}
+
+	// the scan run by startScan is independent of the cursors
+	int legacyLow = 40000, legacyHigh = 40500;
+	index.startScan(&legacyLow, GTE, &legacyHigh, LT);
+
+	// advance the cursors round robin, checking every one returns its keys in order
+	int found[numCursors] = {0, 0, 0, 0};
+	int lastKey[numCursors] = {-1, -1, -1, -1};
+	int legacyFound = 0;
+	bool running = true;
+	int outOfOrder = 0;
+	Page *curPage;
+	while(running)
+	{
+		running = false;
+		for(int c = 0; c < numCursors; c++)
+		{
+			if(!cursors[c].isExecuting())
+			{
+				continue;
+			}
+			running = true;
+			try
+			{
+				RecordId rid;
+				cursors[c].scanNext(rid);
+				bufMgr->readPage(file1, rid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+				bufMgr->unPinPage(file1, rid.page_number, false);
+				outOfOrder += myRec.i <= lastKey[c];
+				lastKey[c] = myRec.i;
+				found[c]++;
+			}
+			catch(IndexScanCompletedException e)
+			{
+				cursors[c].endScan();
+			}
+		}
+		try
+		{
+			RecordId rid;
+			index.scanNext(rid);
+			legacyFound++;
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+	}
+	index.endScan();
+
+	checkPassFail(outOfOrder, 0)
+	for(int c = 0; c < numCursors; c++)
+	{
+		checkPassFail(found[c], expected[c])
+	}
+	checkPassFail(legacyFound, 500)
+
+	// a cursor that is not ended is ended when it goes away
+	{
+		BTreeCursor cursor = index.openScan(&lowVals[0], GTE, &highVals[0], LTE);
+	}
+
+	// cursors report a missing range just like startScan
+	int noLow = 200000, noHigh = 300000;
+	try
+	{
+		BTreeCursor cursor = index.openScan(&noLow, GTE, &noHigh, LTE);
+		std::cout << "NoSuchKeyFoundException test failed." << std::endl;
+		exit(1);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		std::cout << "NoSuchKeyFoundException test passed." << std::endl;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// batchScanTests
+// -----------------------------------------------------------------------------
+
+void batchScanTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and scan it in batches" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	checkPassFail(batchScan(&index,25,GT,40,LT), 14)
+	checkPassFail(batchScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(batchScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(batchScan(&index,0,GT,1,LT), 0)
+	checkPassFail(batchScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(batchScan(&index,largerelationSize - 500,GT,largerelationSize * 2,LTE), 499)
+}
+
+int batchScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	const size_t batchSize = 64;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	Page *curPage;
+
+  std::cout << "Batch scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	// every key comes back in order, and matches the record its rid points at
+	int numResults = 0;
+	int lastKey = lowVal - 1;
+	size_t count;
+	while((count = index->scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if(myRec.i != keys[i] || keys[i] <= lastKey)
+			{
+				std::cout << "Batch scan returned key " << keys[i] << " for record " << myRec.i << " after key " << lastKey << std::endl;
+				exit(1);
+			}
+			lastKey = keys[i];
+		}
+		numResults += count;
+	}
+
+	// the end of the scan is reported every time it is asked for
+	checkPassFail(index->scanNextBatch(rids, NULL, batchSize), 0)
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+void batchInsertTests()
+{
+  std::cout << "Create an empty B+ tree index and insert into it in batches" << std::endl;
+	const int batchKeys = 200000;
+	RecordId rid;
+	rid.page_number = 1;
+	rid.slot_number = 0;
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		// keys 3i in one batch, in random order, land in the single empty leaf
+		std::vector<RIDKeyPair<int> > batch;
+		for(int i = 0; i < batchKeys; i++)
+		{
+			RIDKeyPair<int> entry;
+			entry.set(rid, 3 * i);
+			batch.push_back(entry);
+		}
+		std::random_shuffle(batch.begin(), batch.end());
+		index.insertEntries(batch);
+		checkPassFail(keyScan(&index,0,GTE,3 * batchKeys,LT), batchKeys)
+
+		// keys 3i+1 in one batch go into every leaf, which are all full
+		for(int i = 0; i < batchKeys; i++)
+		{
+			batch[i].key = 3 * i + 1;
+		}
+		std::random_shuffle(batch.begin(), batch.end());
+		index.insertEntries(batch);
+		checkPassFail(keyScan(&index,0,GTE,3 * batchKeys,LT), 2 * batchKeys)
+
+		// keys 3i+2 in smaller batches, enough new leaves to split the root
+		for(int i = 0; i < batchKeys; i++)
+		{
+			batch[i].key = 3 * i + 2;
+		}
+		std::random_shuffle(batch.begin(), batch.end());
+		const int chunk = 10000;
+		for(int i = 0; i < batchKeys; i += chunk)
+		{
+			std::vector<RIDKeyPair<int> > part(batch.begin() + i, batch.begin() + i + chunk);
+			index.insertEntries(part);
+		}
+		checkPassFail(keyScan(&index,0,GTE,3 * batchKeys,LT), 3 * batchKeys)
+
+		// single inserts go through the same path
+		for(int i = 1; i <= 1000; i++)
+		{
+			int key = -i;
+			index.insertEntry(&key, rid);
+		}
+		index.insertEntries(std::vector<RIDKeyPair<int> >());
+	}
+
+	// the tree is complete once reopened
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(keyScan(&index,-1000,GTE,3 * batchKeys,LT), 3 * batchKeys + 1000)
+	checkPassFail(keyScan(&index,-3,GT,3,LT), 5)
+	checkPassFail(keyScan(&index,30000,GTE,40000,LTE), 10001)
+	checkPassFail(keyScan(&index,3 * batchKeys - 10,GT,3 * batchKeys * 2,LTE), 9)
+}
+
+void deleteTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and delete entries from it" << std::endl;
+	std::vector<RIDKeyPair<int> > odd, even;
+	std::streamoff indexSize;
+
+	{
+		// a low fill factor gives the tree two non-leaf levels, whose nodes all start out under the minimum
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.1);
+
+		// the rid of every key, from the index itself
+		const size_t batchSize = 256;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		size_t count;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				RIDKeyPair<int> entry;
+				entry.set(rids[i], keys[i]);
+				(keys[i] % 2 ? odd : even).push_back(entry);
+			}
+		}
+		index.endScan();
+
+		// a missing key or a key with another rid deletes nothing
+		int key = largerelationSize;
+		checkPassFail(index.deleteEntry(&key, odd[0].rid), false)
+		key = odd[0].key;
+		checkPassFail(index.deleteEntry(&key, even[0].rid), false)
+
+		// delete every odd key in random order: leaves borrow and merge all over the tree
+		std::random_shuffle(odd.begin(), odd.end());
+		int deleted = 0;
+		for(size_t i = 0; i < odd.size(); i++)
+		{
+			deleted += index.deleteEntry(&odd[i].key, odd[i].rid);
+		}
+		checkPassFail(deleted, largerelationSize / 2)
+		checkPassFail(index.deleteEntry(&odd[0].key, odd[0].rid), false)
+		checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), largerelationSize / 2)
+		checkPassFail(batchScan(&index,25,GT,40,LT), 7)
+
+		// mixed load: the odd keys come back in one batch while the even keys go one by one
+		index.insertEntries(odd);
+		std::random_shuffle(even.begin(), even.end());
+		deleted = 0;
+		for(size_t i = 0; i < even.size(); i++)
+		{
+			deleted += index.deleteEntry(&even[i].key, even[i].rid);
+		}
+		checkPassFail(deleted, largerelationSize / 2)
+		checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), largerelationSize / 2)
+		checkPassFail(batchScan(&index,-3,GT,3,LT), 1)
+	}
+
+	{
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		indexSize = indexFile.tellg();
+	}
+
+	{
+		// delete everything after reopening: the tree shrinks back to a root over one empty leaf
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int deleted = 0;
+		for(size_t i = 0; i < odd.size(); i++)
+		{
+			deleted += index.deleteEntry(&odd[i].key, odd[i].rid);
+		}
+		checkPassFail(deleted, largerelationSize / 2)
+		checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), 0)
+	}
+
+	// reinsert everything after reopening: the freed pages are used before the file grows
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	index.insertEntries(even);
+	index.insertEntries(odd);
+	checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(batchScan(&index,3000,GTE,4000,LT), 1000)
+	{
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		bool reused = indexFile.tellg() <= indexSize;
+		checkPassFail(reused, true)
+	}
+}
+
+void lookupTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and look up single keys" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	RecordId rid;
+	Page *curPage;
+
+	// every key is found, with the rid of its record
+	int found = 0;
+	for(int key = 0; key < relationSize; key++)
+	{
+		if(index.lookup(&key, rid))
+		{
+			bufMgr->readPage(file1, rid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+			bufMgr->unPinPage(file1, rid.page_number, false);
+			found += myRec.i == key;
+		}
+	}
+	checkPassFail(found, relationSize)
+
+	// misses are reported through the return value
+	int missing[] = {-1, relationSize, INT32_MIN, INT32_MAX - 1, INT32_MAX};
+	std::vector<RecordId> rids;
+	for(int i = 0; i < 5; i++)
+	{
+		checkPassFail(index.lookup(&missing[i], rid), false)
+		checkPassFail(index.lookupAll(&missing[i], rids), 0)
+	}
+
+	// lookups leave the scan run through startScan where it was
+	int lowVal = 0;
+	int highVal = 100;
+	int scanned = 0;
+	index.startScan(&lowVal, GTE, &highVal, LT);
+	try
+	{
+		while(1)
+		{
+			index.scanNext(rid);
+			scanned++;
+			int key = scanned * 37 % relationSize;
+			index.lookup(&key, rid);
+			index.lookupAll(&key, rids);
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	index.endScan();
+	checkPassFail(scanned, 100)
+
+	// equal keys spanning several leaves are all found
+	int dupKey = relationSize / 2;
+	RecordId dupRid;
+	index.lookup(&dupKey, dupRid);
+	for(int i = 0; i < 2000; i++)
+	{
+		index.insertEntry(&dupKey, dupRid);
+	}
+	rids.clear();
+	checkPassFail(index.lookupAll(&dupKey, rids), 2001)
+	checkPassFail((int)rids.size(), 2001)
+	checkPassFail(index.lookup(&dupKey, rid), true)
+	int neighbour = dupKey - 1;
+	checkPassFail(index.lookupAll(&neighbour, rids), 1)
+	neighbour = dupKey + 1;
+	checkPassFail(index.lookupAll(&neighbour, rids), 1)
+}
+
+void lookupManyTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and look up many keys at once" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// random keys, some repeated and some missing on both ends of the tree, the largest int among them
+	const int numProbes = 20000;
+	std::vector<int> keys(numProbes);
+	for(int i = 0; i < numProbes; i++)
+	{
+		keys[i] = (int)(random() % (largerelationSize + 2000)) - 1000;
+	}
+	keys[0] = keys[numProbes - 1];
+	keys[1] = INT32_MAX;
+
+	RecordId *rids = new RecordId[numProbes];
+	bool *found = new bool[numProbes];
+	int hits = (int)index.lookupMany(&keys[0], numProbes, rids, found);
+
+	// every result sits at the position of its key and agrees with a single lookup
+	int expectedHits = 0;
+	int agree = 0;
+	for(int i = 0; i < numProbes; i++)
+	{
+		RecordId rid;
+		bool hit = index.lookup(&keys[i], rid);
+		expectedHits += hit;
+		agree += (hit == found[i]) && (!hit || rid == rids[i]);
+	}
+	checkPassFail(agree, numProbes)
+	checkPassFail(hits, expectedHits)
+
+	// every key in range is found and points at its record
+	Page *curPage;
+	int matching = 0;
+	for(int i = 0; i < numProbes; i++)
+	{
+		if(found[i])
+		{
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			matching += myRec.i == keys[i];
+		}
+		else
+		{
+			matching += keys[i] < 0 || keys[i] >= largerelationSize;
+		}
+	}
+	checkPassFail(matching, numProbes)
+	checkPassFail(index.lookupMany(&keys[0], 0, rids, found), 0)
+
+	delete[] rids;
+	delete[] found;
+}
+
+void readAheadTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and scan it with read-ahead" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// the read-ahead never changes what a scan returns, however far it reads
+	int readAheads[] = {0, 1, DEFAULT_READ_AHEAD, MAX_READ_AHEAD, 1000};
+	for(int i = 0; i < 5; i++)
+	{
+		checkPassFail(readAheadScan(&index,0,GTE,maxrelationsize,LT,readAheads[i]), maxrelationsize)
+		checkPassFail(readAheadScan(&index,1000,GT,250000,LTE,readAheads[i]), 249000)
+		checkPassFail(readAheadScan(&index,25,GT,40,LT,readAheads[i]), 14)
+	}
+
+	// several long scans reading ahead at once share the buffer pool
+	int lowVal = 0;
+	int highVal = maxrelationsize;
+	std::vector<BTreeCursor> cursors;
+	for(int c = 0; c < 3; c++)
+	{
+		cursors.push_back(index.openScan(&lowVal, GTE, &highVal, LT, ASCENDING, MAX_READ_AHEAD));
+	}
+	RecordId rid;
+	int scanned = 0;
+	try
+	{
+		while(1)
+		{
+			for(int c = 0; c < 3; c++)
+			{
+				cursors[c].scanNext(rid);
+			}
+			scanned++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	checkPassFail(scanned, maxrelationsize)
+
+	// the leaves ahead of a scan are read by the buffer manager's prefetching thread, as many as a tenth of the
+	// pool has frames for. Reading the relation first evicts every leaf of the index, once the scans above are
+	// done reading ahead.
+	bufMgr->finishPrefetches();
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+	bufMgr->clearBufStats();
+	BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LT, ASCENDING, MAX_READ_AHEAD);
+	bufMgr->finishPrefetches();
+	checkPassFail(bufMgr->getBufStats().prefetchreads, 10)
+
+	// once they are in, the scan reaches them without reading a page itself
+	bufMgr->clearBufStats();
+	const size_t batchSize = 256;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	int read = 0;
+	while(read < 4 * INTARRAYLEAFSIZE)
+	{
+		read += (int)cursor.scanNextBatch(rids, keys, batchSize);
+	}
+	bufMgr->finishPrefetches();
+	cursor.endScan();
+	checkPassFail(bufMgr->getBufStats().diskreads - bufMgr->getBufStats().prefetchreads, 0)
+}
+
+int readAheadScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, int readAhead)
+{
+	const size_t batchSize = 256;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+
+  std::cout << "Scan reading " << readAhead << " leaves ahead for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	BTreeCursor cursor = index->openScan(&lowVal, lowOp, &highVal, highOp, ASCENDING, readAhead);
+	int numResults = 0;
+	int lastKey = lowVal - 1;
+	size_t count;
+	while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			if(keys[i] <= lastKey)
+			{
+				std::cout << "Scan returned key " << keys[i] << " after key " << lastKey << std::endl;
+				exit(1);
+			}
+			lastKey = keys[i];
+		}
+		numResults += count;
+	}
+  std::cout << "Number of results: " << numResults << std::endl;
+	cursor.endScan();
+
+	return numResults;
+}
+
+void reverseScanTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and scan it in descending order" << std::endl;
+	// half full leaves, so that reinserting splits them
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.5);
+
+	// a descending scan returns what the ascending scan of the same range returns
+	checkPassFail(reverseScan(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(reverseScan(&index,25,GT,40,LT), 14)
+	checkPassFail(reverseScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(reverseScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(reverseScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(reverseScan(&index,largerelationSize - 10,GTE,largerelationSize * 2,LTE), 10)
+	checkPassFail(reverseScan(&index,0,GT,1,LT), 0)
+	checkPassFail(reverseScan(&index,-1000,GTE,0,LT), 0)
+	checkPassFail(reverseScan(&index,largerelationSize,GTE,largerelationSize * 2,LTE), 0)
+
+	// ORDER BY key DESC LIMIT 10 reads the ten largest keys and stops
+	{
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LT, DESCENDING);
+		Page *curPage;
+		int matching = 0;
+		for(int i = 0; i < 10; i++)
+		{
+			RecordId rid;
+			cursor.scanNext(rid);
+			bufMgr->readPage(file1, rid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+			bufMgr->unPinPage(file1, rid.page_number, false);
+			matching += myRec.i == largerelationSize - 1 - i;
+		}
+		checkPassFail(matching, 10)
+	}
+
+	// the rid of every odd key, from the index itself
+	std::vector<RIDKeyPair<int> > odd;
+	{
+		const size_t batchSize = 256;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		size_t count;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				if(keys[i] % 2)
+				{
+					RIDKeyPair<int> entry;
+					entry.set(rids[i], keys[i]);
+					odd.push_back(entry);
+				}
+			}
+		}
+		index.endScan();
+	}
+
+	// deleting merges leaves and reinserting splits them again; the left links follow both
+	std::random_shuffle(odd.begin(), odd.end());
+	for(size_t i = 0; i < odd.size(); i++)
+	{
+		index.deleteEntry(&odd[i].key, odd[i].rid);
+	}
+	checkPassFail(reverseScan(&index,0,GTE,largerelationSize,LT), largerelationSize / 2)
+	checkPassFail(reverseScan(&index,25,GT,40,LT), 7)
+
+	index.insertEntries(odd);
+	checkPassFail(reverseScan(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(reverseScan(&index,996,GT,1001,LT), 4)
+}
+
+void concurrentTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and use it from several threads at once" << std::endl;
+	// full leaves, so that the very first inserts split them
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// the rid of every key, from the index itself
+	std::vector<RecordId> ridOf(largerelationSize);
+	{
+		const size_t batchSize = 256;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		size_t count;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				ridOf[keys[i]] = rids[i];
+			}
+		}
+		index.endScan();
+	}
+
+	// two readers look up the even keys, which stay in the index throughout, while one thread deletes
+	// the odd keys and two more insert new keys above the relation, one by one and in batches
+	const int numInserted = 20000;
+	std::atomic<int> mismatches(0);
+	std::atomic<int> deleted(0);
+	std::vector<std::thread> threads;
+	for(int r = 0; r < 2; r++)
+	{
+		threads.push_back(std::thread([&index, &ridOf, &mismatches, r]()
+		{
+			for(int i = 0; i < 3; i++)
+			{
+				for(int key = 2 * r; key < largerelationSize; key += 4)
+				{
+					RecordId rid;
+					if(!index.lookup(&key, rid) || !(rid == ridOf[key]))
+					{
+						mismatches++;
+					}
+				}
+			}
+		}));
+	}
+	threads.push_back(std::thread([&index, &ridOf, &deleted]()
+	{
+		for(int key = 1; key < largerelationSize; key += 2)
+		{
+			deleted += index.deleteEntry(&key, ridOf[key]);
+		}
+	}));
+	for(int w = 0; w < 2; w++)
+	{
+		threads.push_back(std::thread([&index, w]()
+		{
+			std::vector<RIDKeyPair<int> > batch;
+			for(int j = 0; j < numInserted; j++)
+			{
+				RIDKeyPair<int> entry;
+				RecordId rid;
+				rid.page_number = j + 1;
+				rid.slot_number = w;
+				entry.set(rid, largerelationSize + 2 * j + w);
+				if(j % 2)
+				{
+					index.insertEntry(&entry.key, entry.rid);
+					continue;
+				}
+				batch.push_back(entry);
+				if(batch.size() == 64)
+				{
+					index.insertEntries(batch);
+					batch.clear();
+				}
+			}
+			index.insertEntries(batch);
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	checkPassFail(mismatches, 0)
+	checkPassFail(deleted, largerelationSize / 2)
+	checkPassFail(batchScan(&index,0,GTE,largerelationSize,LT), largerelationSize / 2)
+
+	// every inserted key is found with its rid, and the deleted ones are gone
+	int matching = 0;
+	for(int j = 0; j < numInserted; j++)
+	{
+		for(int w = 0; w < 2; w++)
+		{
+			int key = largerelationSize + 2 * j + w;
+			RecordId rid;
+			matching += index.lookup(&key, rid) && rid.page_number == (PageId)(j + 1) && rid.slot_number == w;
+		}
+	}
+	checkPassFail(matching, 2 * numInserted)
+	int gone = 0;
+	for(int key = 1; key < largerelationSize; key += 2)
+	{
+		RecordId rid;
+		gone += !index.lookup(&key, rid);
+	}
+	checkPassFail(gone, largerelationSize / 2)
+}
+
+void blinkTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and scan it while other threads insert into it" << std::endl;
+	// full leaves and non-leaf nodes, so that the inserts split them from the start
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// the rid of every key, from the index itself
+	std::vector<RecordId> ridOf(largerelationSize);
+	{
+		const size_t batchSize = 256;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		size_t count;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				ridOf[keys[i]] = rids[i];
+			}
+		}
+		index.endScan();
+	}
+
+	// two threads insert a second entry for random keys all over the relation, one by one and in batches,
+	// while two more scan the whole relation up and down. Every scan must return every original entry once,
+	// in order, whatever leaves split under it.
+	const int numInserted = 30000;
+	std::atomic<int> badScans(0);
+	std::vector<std::thread> threads;
+	for(int w = 0; w < 2; w++)
+	{
+		threads.push_back(std::thread([&index, w]()
+		{
+			std::vector<RIDKeyPair<int> > batch;
+			for(int j = 0; j < numInserted; j++)
+			{
+				RIDKeyPair<int> entry;
+				RecordId rid;
+				rid.page_number = largerelationSize + j;
+				rid.slot_number = w;
+				entry.set(rid, (int)((j * 7919L + w * 104729L) % largerelationSize));
+				if(j % 2)
+				{
+					index.insertEntry(&entry.key, entry.rid);
+					continue;
+				}
+				batch.push_back(entry);
+				if(batch.size() == 32)
+				{
+					index.insertEntries(batch);
+					batch.clear();
+				}
+			}
+			index.insertEntries(batch);
+		}));
+	}
+	for(int r = 0; r < 2; r++)
+	{
+		threads.push_back(std::thread([&index, &ridOf, &badScans, r]()
+		{
+			const ScanOrder order = r ? DESCENDING : ASCENDING;
+			RecordId rids[128];
+			int keys[128];
+			for(int pass = 0; pass < 4; pass++)
+			{
+				// a single entry at a time on every other pass, so that the leaf changes between most calls
+				const size_t batchSize = (pass % 2) ? 128 : 1;
+				int lowVal = 0;
+				int highVal = largerelationSize;
+				BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LT, order);
+				int originals = 0;
+				int lastKey = (order == ASCENDING) ? -1 : largerelationSize;
+				bool ordered = true;
+				size_t count;
+				while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+				{
+					for(size_t i = 0; i < count; i++)
+					{
+						ordered = ordered && ((order == ASCENDING) ? keys[i] >= lastKey : keys[i] <= lastKey);
+						lastKey = keys[i];
+						originals += rids[i] == ridOf[keys[i]];
+					}
+				}
+				if(!ordered || originals != largerelationSize)
+				{
+					std::cout << "Scan " << pass << " returned " << originals << " original entries, ordered " << ordered << std::endl;
+					badScans++;
+				}
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	checkPassFail(badScans, 0)
+
+	// every entry is there once the threads are done, in order both ways
+	for(int r = 0; r < 2; r++)
+	{
+		const ScanOrder order = r ? DESCENDING : ASCENDING;
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LT, order);
+		int numResults = 0;
+		int originals = 0;
+		int lastKey = (order == ASCENDING) ? -1 : largerelationSize;
+		bool ordered = true;
+		RecordId rid;
+		int key;
+		while(cursor.scanNextBatch(&rid, &key, 1) > 0)
+		{
+			ordered = ordered && ((order == ASCENDING) ? key >= lastKey : key <= lastKey);
+			lastKey = key;
+			originals += rid == ridOf[key];
+			numResults++;
+		}
+		checkPassFail(ordered, true)
+		checkPassFail(originals, largerelationSize)
+		checkPassFail(numResults, largerelationSize + 2 * numInserted)
+	}
+
+	// every key is found, and finds its original entry among the new ones
+	int matching = 0;
+	std::vector<RecordId> rids;
+	for(int key = 0; key < largerelationSize; key += 7)
+	{
+		rids.clear();
+		index.lookupAll(&key, rids);
+		matching += std::find(rids.begin(), rids.end(), ridOf[key]) != rids.end();
+	}
+	checkPassFail(matching, (largerelationSize + 6) / 7)
+}
+
+void countTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field and count ranges of it without scanning them" << std::endl;
+	// a low fill factor gives the tree two non-leaf levels, so that the counts on both are added up
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.1);
+
+	int key = -1;
+	checkPassFail(index.minKey(&key), true)
+	checkPassFail(key, 0)
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, largerelationSize - 1)
+
+	checkPassFail(rangeCount(&index,25,GT,40,LT), 14)
+	checkPassFail(rangeCount(&index,20,GTE,35,LTE), 16)
+	checkPassFail(rangeCount(&index,-3,GT,3,LT), 3)
+	checkPassFail(rangeCount(&index,996,GT,1001,LT), 4)
+	checkPassFail(rangeCount(&index,0,GT,1,LT), 0)
+	checkPassFail(rangeCount(&index,300,GT,400,LT), 99)
+	checkPassFail(rangeCount(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(rangeCount(&index,largerelationSize,GTE,largerelationSize * 2,LTE), 0)
+
+	// the largest int, which pads the nodes, bounds a range like any other value, but cannot be inserted
+	checkPassFail(rangeCount(&index,0,GTE,INT32_MAX,LTE), largerelationSize)
+	checkPassFail(rangeCount(&index,largerelationSize - 10,GT,INT32_MAX,LT), 9)
+	checkPassFail(rangeCount(&index,INT32_MAX,GTE,INT32_MAX,LTE), 0)
+	checkPassFail(intScan(&index,largerelationSize - 10,GTE,INT32_MAX,LTE), 10)
+	checkPassFail(intScan(&index,INT32_MAX,GTE,INT32_MAX,LTE), 0)
+	{
+		int maxKey = INT32_MAX;
+		RecordId rid;
+		rid.page_number = 1;
+		rid.slot_number = 0;
+		bool refused = false;
+		try
+		{
+			index.insertEntry(&maxKey, rid);
+		}
+		catch(BadIndexInfoException e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+		checkPassFail(index.deleteEntry(&maxKey, rid), false)
+	}
+
+	// the rid of every key, from the index itself
+	std::vector<RecordId> ridOf(largerelationSize);
+	{
+		const size_t batchSize = 256;
+		RecordId rids[batchSize];
+		int keys[batchSize];
+		int lowVal = 0;
+		int highVal = largerelationSize;
+		size_t count;
+		index.startScan(&lowVal, GTE, &highVal, LT);
+		while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				ridOf[keys[i]] = rids[i];
+			}
+		}
+		index.endScan();
+	}
+
+	// two threads add a second entry for every key that is 0 or 1 modulo 4, splitting leaves all over the tree,
+	// while a third deletes the entry of every odd key, merging them. The counts have to follow all of it.
+	std::vector<std::thread> threads;
+	for(int w = 0; w < 2; w++)
+	{
+		threads.push_back(std::thread([&index, w]()
+		{
+			for(int k = w; k < largerelationSize; k += 4)
+			{
+				RecordId rid;
+				rid.page_number = largerelationSize + k;
+				rid.slot_number = 1;
+				index.insertEntry(&k, rid);
+			}
+		}));
+	}
+	threads.push_back(std::thread([&index, &ridOf]()
+	{
+		std::vector<int> odd;
+		for(int k = 1; k < largerelationSize; k += 2)
+		{
+			odd.push_back(k);
+		}
+		std::random_shuffle(odd.begin(), odd.end());
+		for(size_t i = 0; i < odd.size(); i++)
+		{
+			index.deleteEntry(&odd[i], ridOf[odd[i]]);
+		}
+	}));
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	// entries per key: the original one for even keys, and the second one for keys that are 0 or 1 modulo 4
+	std::vector<int> below(largerelationSize + 1, 0);
+	for(int k = 0; k < largerelationSize; k++)
+	{
+		below[k + 1] = below[k] + (k % 2 == 0) + (k % 4 < 2);
+	}
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), below[largerelationSize])
+
+	// random ranges, against the expected counts and against a scan of the same range
+	int matching = 0;
+	int scanned = 0;
+	for(int i = 0; i < 200; i++)
+	{
+		int lowVal = rand() % largerelationSize;
+		int highVal = lowVal + rand() % (largerelationSize - lowVal);
+		int lowValParm = lowVal;
+		int highValParm = highVal;
+		Operator lowOp = (i % 2) ? GT : GTE;
+		Operator highOp = (i % 3) ? LT : LTE;
+		int expected = below[(highOp == LTE) ? highVal + 1 : highVal] - below[(lowOp == GT) ? lowVal + 1 : lowVal];
+		if(expected < 0)
+		{
+			expected = 0;
+		}
+		matching += (int)index.countRange(&lowValParm, lowOp, &highValParm, highOp) == expected;
+
+		if(i % 20 == 0)
+		{
+			int numResults = 0;
+			try
+			{
+				BTreeCursor cursor = index.openScan(&lowValParm, lowOp, &highValParm, highOp);
+				RecordId rids[256];
+				size_t count;
+				while((count = cursor.scanNextBatch(rids, NULL, 256)) > 0)
+				{
+					numResults += count;
+				}
+			}
+			catch(NoSuchKeyFoundException e)
+			{
+			}
+			scanned += numResults == expected;
+		}
+	}
+	checkPassFail(matching, 200)
+	checkPassFail(scanned, 10)
+
+	// the largest key lost its entry, and the one before it is even
+	checkPassFail(index.minKey(&key), true)
+	checkPassFail(key, 0)
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, largerelationSize - 2)
+}
+
+void duplicateTests()
+{
+  std::cout << "Create a B+ Tree index on an integer field with few distinct values, kept in posting lists" << std::endl;
+	const int perKey = largerelationSize / duplicateKeys;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		checkPassFail(duplicateScan(&index,3,3,ASCENDING), perKey)
+		checkPassFail(duplicateScan(&index,3,3,DESCENDING), perKey)
+		checkPassFail(duplicateScan(&index,duplicateKeys - 1,duplicateKeys - 1,DESCENDING), perKey)
+		checkPassFail(duplicateScan(&index,0,duplicateKeys - 1,ASCENDING), largerelationSize)
+		checkPassFail(duplicateScan(&index,0,duplicateKeys - 1,DESCENDING), largerelationSize)
+		checkPassFail(rangeCount(&index,0,GTE,duplicateKeys,LT), largerelationSize)
+		checkPassFail(rangeCount(&index,2,GT,5,LTE), 3 * perKey)
+
+		// every rid of a key, in rid order, each pointing at a record with the key
+		std::vector<RecordId> rids;
+		checkPassFail((int)index.lookupAll(&duplicateKeys, rids), 0)
+		int key = 9;
+		checkPassFail((int)index.lookupAll(&key, rids), perKey)
+		bool sorted = true;
+		for(size_t i = 1; i < rids.size(); i++)
+		{
+			sorted = sorted && ridBefore(rids[i - 1], rids[i]);
+		}
+		checkPassFail(sorted, true)
+		int matching = 0;
+		for(size_t i = 0; i < rids.size(); i += 500)
+		{
+			Page *curPage;
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			matching += myRec.i == key;
+		}
+		checkPassFail(matching, (perKey + 499) / 500)
+
+		// lookup gives the smallest rid of the key
+		RecordId first;
+		checkPassFail(index.lookup(&key, first), true)
+		bool smallest = first == rids[0];
+		checkPassFail(smallest, true)
+	}
+
+	// each key takes a slot on a leaf and a few delta-encoded posting pages, instead of a leaf or more of its own
+	{
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		bool small = indexFile.tellg() / Page::SIZE < largerelationSize / INTARRAYLEAFSIZE / 2;
+		checkPassFail(small, true)
+	}
+
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// a cursor goes through one key while another thread adds entries for it among its rids and after them.
+	// It returns each rid once, in order, and every rid that was there when it started.
+	const int key = 3;
+	std::vector<RecordId> before;
+	index.lookupAll(&key, before);
+	const int added = 4000;
+	std::vector<RecordId> returned;
+	{
+		BTreeCursor cursor = index.openScan(&key, GTE, &key, LTE);
+		std::thread writer([&index, &before, key, added]()
+		{
+			for(int n = 0; n < added; n++)
+			{
+				RecordId rid;
+				rid.page_number = (n % 2) ? before[n * before.size() / added].page_number : largerelationSize + n;
+				rid.slot_number = 1000 + n;
+				index.insertEntry(&key, rid);
+			}
+		});
+		RecordId rids[64];
+		size_t count;
+		while((count = cursor.scanNextBatch(rids, NULL, 64)) > 0)
+		{
+			returned.insert(returned.end(), rids, rids + count);
+		}
+		writer.join();
+	}
+	bool ordered = true;
+	for(size_t i = 1; i < returned.size(); i++)
+	{
+		ordered = ordered && ridBefore(returned[i - 1], returned[i]);
+	}
+	checkPassFail(ordered, true)
+	bool complete = std::includes(returned.begin(), returned.end(), before.begin(), before.end(), ridBefore);
+	checkPassFail(complete, true)
+	checkPassFail(duplicateScan(&index,key,key,ASCENDING), perKey + added)
+	checkPassFail(duplicateScan(&index,key,key,DESCENDING), perKey + added)
+	checkPassFail(rangeCount(&index,key,GTE,key,LTE), perKey + added)
+
+	// deleting a rid the key does not have changes nothing; deleting every other rid of a key halves it,
+	// and deleting all rids of another removes it
+	RecordId missing;
+	missing.page_number = largerelationSize * 2;
+	missing.slot_number = 1;
+	checkPassFail(index.deleteEntry(&key, missing), false)
+	int other = 7;
+	std::vector<RecordId> rids;
+	index.lookupAll(&other, rids);
+	int deleted = 0;
+	for(size_t i = 0; i < rids.size(); i += 2)
+	{
+		deleted += index.deleteEntry(&other, rids[i]);
+	}
+	checkPassFail(deleted, perKey / 2)
+	checkPassFail(duplicateScan(&index,other,other,DESCENDING), perKey / 2)
+	other = 11;
+	rids.clear();
+	index.lookupAll(&other, rids);
+	deleted = 0;
+	for(size_t i = 0; i < rids.size(); i++)
+	{
+		deleted += index.deleteEntry(&other, rids[i]);
+	}
+	checkPassFail(deleted, perKey)
+	checkPassFail(duplicateScan(&index,other,other,ASCENDING), 0)
+	checkPassFail(index.deleteEntry(&other, rids[0]), false)
+	checkPassFail(rangeCount(&index,0,GTE,duplicateKeys,LT), largerelationSize + added - perKey / 2 - perKey)
+	checkPassFail(duplicateScan(&index,0,duplicateKeys - 1,DESCENDING), largerelationSize + added - perKey / 2 - perKey)
+
+	// the key comes back from plain entries that fold into a posting list again
+	for(size_t i = 0; i < rids.size(); i++)
+	{
+		index.insertEntry(&other, rids[i]);
+	}
+	checkPassFail(duplicateScan(&index,other,other,ASCENDING), perKey)
+}
+
+int duplicateScan(BTreeIndex * index, int lowVal, int highVal, ScanOrder order)
+{
+	const size_t batchSize = 100;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+
+  std::cout << ((order == ASCENDING) ? "Duplicate scan for [" : "Reverse duplicate scan for [");
+  std::cout << lowVal << "," << highVal << "]" << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, GTE, &highVal, LTE, order);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	// entries come back in key order, and in rid order among equal keys; all of it reversed for a descending scan
+	int numResults = 0;
+	int lastKey = 0;
+	RecordId lastRid;
+	size_t count;
+	while((count = index->scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			bool inOrder = numResults == 0 ||
+				((order == ASCENDING) ? lastKey < keys[i] || (lastKey == keys[i] && ridBefore(lastRid, rids[i]))
+				                      : keys[i] < lastKey || (lastKey == keys[i] && ridBefore(rids[i], lastRid)));
+			if(keys[i] < lowVal || keys[i] > highVal || !inOrder)
+			{
+				std::cout << "Duplicate scan returned key " << keys[i] << " at:" << rids[i].page_number << "," << rids[i].slot_number;
+				std::cout << " after key " << lastKey << " at:" << lastRid.page_number << "," << lastRid.slot_number << std::endl;
+				exit(1);
+			}
+			lastKey = keys[i];
+			lastRid = rids[i];
+			numResults++;
+		}
+	}
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+bool ridBefore(const RecordId &r1, const RecordId &r2)
+{
+	return r1.page_number < r2.page_number || (r1.page_number == r2.page_number && r1.slot_number < r2.slot_number);
+}
+
+void compressTests()
+{
+  std::cout << "Bulk load B+ Tree indexes on the integer field with plain and with packed leaves, and change the packed one" << std::endl;
+	std::streamoff plainSize;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		plainSize = indexFile.tellg();
+	}
+	File::remove(intIndexName);
+
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR, true);
+
+		// the keys are dense, so every leaf is packed and holds a fifth more entries
+		{
+			std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+			bool smaller = indexFile.tellg() < plainSize * 7 / 8;
+			checkPassFail(smaller, true)
+		}
+
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+		checkPassFail(reverseScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(reverseScan(&index,largerelationSize - 10,GT,largerelationSize,LTE), 9)
+		checkPassFail(rangeCount(&index,996,GT,1001,LT), 4)
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+		checkPassFail(orderedScan(&index,0,largerelationSize,DESCENDING), largerelationSize)
+
+		// the rid of every key, from the index itself
+		std::vector<RecordId> ridOf(largerelationSize);
+		{
+			const size_t batchSize = 256;
+			RecordId rids[batchSize];
+			int keys[batchSize];
+			int lowVal = 0;
+			int highVal = largerelationSize;
+			size_t count;
+			index.startScan(&lowVal, GTE, &highVal, LT);
+			while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+			{
+				for(size_t i = 0; i < count; i++)
+				{
+					ridOf[keys[i]] = rids[i];
+				}
+			}
+			index.endScan();
+		}
+		int key = 12345;
+		RecordId rid;
+		checkPassFail(index.lookup(&key, rid), true)
+		bool same = rid == ridOf[key];
+		checkPassFail(same, true)
+
+		// keys too far apart to be packed go to plain leaves, keys below the first leaf's base repack it,
+		// and a second entry for each of a run of keys splits packed leaves into packed leaves
+		const int spread = 50000;
+		for(int k = 0; k < 2000; k++)
+		{
+			int farKey = largerelationSize + k * spread;
+			int lowKey = -1 - k;
+			rid.page_number = largerelationSize + k;
+			rid.slot_number = 1;
+			index.insertEntry(&farKey, rid);
+			index.insertEntry(&lowKey, rid);
+		}
+		std::vector<RIDKeyPair<int> > seconds(2000);
+		for(int k = 0; k < 2000; k++)
+		{
+			rid.page_number = largerelationSize + k;
+			rid.slot_number = 2;
+			seconds[k].set(rid, largerelationSize / 2 + k);
+		}
+		index.insertEntries(seconds);
+		checkPassFail(rangeCount(&index,largerelationSize,GTE,largerelationSize + 2000 * spread,LT), 2000)
+		checkPassFail(rangeCount(&index,-2000,GTE,0,LT), 2000)
+		checkPassFail(rangeCount(&index,largerelationSize / 2,GTE,largerelationSize / 2 + 2000,LT), 4000)
+		checkPassFail(orderedScan(&index,-2000,largerelationSize + 2000 * spread,ASCENDING), largerelationSize + 6000)
+
+		// deleting the odd keys of a range merges and rebalances packed leaves
+		for(int k = 1; k < largerelationSize / 2; k += 2)
+		{
+			index.deleteEntry(&k, ridOf[k]);
+		}
+		for(int k = 0; k < 2000; k++)
+		{
+			int lowKey = -1 - k;
+			rid.page_number = largerelationSize + k;
+			rid.slot_number = 1;
+			index.deleteEntry(&lowKey, rid);
+		}
+		checkPassFail(rangeCount(&index,-2000,GTE,largerelationSize / 2,LT), largerelationSize / 4)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 500)
+		checkPassFail(orderedScan(&index,0,largerelationSize + 2000 * spread,DESCENDING), largerelationSize * 3 / 4 + 4000)
+	}
+
+	// opened again, the index reads its leaves in both layouts
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	int key = -1;
+	checkPassFail(index.minKey(&key), true)
+	checkPassFail(key, 0)
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, largerelationSize + 1999 * 50000)
+	checkPassFail(orderedScan(&index,0,largerelationSize,ASCENDING), largerelationSize * 3 / 4 + 2000)
+}
+
+void appendTests()
+{
+  std::cout << "Insert keys in ascending order into a B+ Tree index, one at a time and from several threads" << std::endl;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		RecordId rid;
+		for(int k = 0; k < largerelationSize; k++)
+		{
+			rid.page_number = k / 100 + 1;
+			rid.slot_number = k % 100;
+			index.insertEntry(&k, rid);
+		}
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+		checkPassFail(orderedScan(&index,0,largerelationSize,ASCENDING), largerelationSize)
+		checkPassFail(orderedScan(&index,0,largerelationSize,DESCENDING), largerelationSize)
+		int key = largerelationSize / 3;
+		checkPassFail(index.lookup(&key, rid), true)
+		bool same = rid.page_number == (PageId)(key / 100 + 1) && rid.slot_number == key % 100;
+		checkPassFail(same, true)
+	}
+
+	// the leaves left behind are full, not half full as even splits would leave them
+	{
+		std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+		bool full = indexFile.tellg() / Page::SIZE < largerelationSize / INTARRAYLEAFSIZE + 8;
+		checkPassFail(full, true)
+	}
+
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+	// threads append interleaved keys while another deletes behind them, rebalancing the leaves they
+	// append to and changing the path to the last leaf
+	const int appended = 40000;
+	std::vector<std::thread> threads;
+	for(int w = 0; w < 4; w++)
+	{
+		threads.push_back(std::thread([&index, w, appended]()
+		{
+			for(int k = largerelationSize + w; k < largerelationSize + appended; k += 4)
+			{
+				RecordId rid;
+				rid.page_number = k / 100 + 1;
+				rid.slot_number = k % 100;
+				index.insertEntry(&k, rid);
+			}
+		}));
+	}
+	threads.push_back(std::thread([&index]()
+	{
+		for(int k = largerelationSize - 1; k >= largerelationSize - 20000; k--)
+		{
+			RecordId rid;
+			rid.page_number = k / 100 + 1;
+			rid.slot_number = k % 100;
+			index.deleteEntry(&k, rid);
+		}
+	}));
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize + appended,LT), largerelationSize - 20000 + appended)
+	checkPassFail(orderedScan(&index,0,largerelationSize + appended,ASCENDING), largerelationSize - 20000 + appended)
+	checkPassFail(rangeCount(&index,largerelationSize,GTE,largerelationSize + appended,LT), appended)
+	int key = -1;
+	checkPassFail(index.maxKey(&key), true)
+	checkPassFail(key, largerelationSize + appended - 1)
+}
+
+void nodeCacheTests()
+{
+  std::cout << "Create a B+ Tree index whose non-leaf nodes stay pinned, and change its structure around them" << std::endl;
+	{
+		// a low fill factor gives the tree two non-leaf levels
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.1);
+
+		// reading the whole relation evicts every frame that is not pinned
+		{
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					fscan.scanNext(scanRid);
+				}
+			}
+			catch(EndOfFileException e)
+			{
+			}
+		}
+		int found = 0;
+		RecordId rid;
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			found += index.lookup(&key, rid) ? 1 : 0;
+		}
+		checkPassFail(found, largerelationSize)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+		// deleting most of the keys frees non-leaf nodes along with the leaves, and inserting them again reuses
+		// those pages, some of them as leaves, while their frames are still held by the cache
+		std::vector<RecordId> ridOf(largerelationSize);
+		{
+			const size_t batchSize = 256;
+			RecordId rids[batchSize];
+			int keys[batchSize];
+			int lowVal = 0;
+			int highVal = largerelationSize;
+			size_t count;
+			index.startScan(&lowVal, GTE, &highVal, LT);
+			while((count = index.scanNextBatch(rids, keys, batchSize)) > 0)
+			{
+				for(size_t i = 0; i < count; i++)
+				{
+					ridOf[keys[i]] = rids[i];
+				}
+			}
+			index.endScan();
+		}
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			if(key % 8 != 0)
+			{
+				index.deleteEntry(&key, ridOf[key]);
+			}
+		}
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize / 8)
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			if(key % 8 != 0)
+			{
+				index.insertEntry(&key, ridOf[key]);
+			}
+		}
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+		checkPassFail(orderedScan(&index,0,largerelationSize,ASCENDING), largerelationSize)
+	}
+
+	// closing the index released every cached frame before flushing it, so it opens again as it was left
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(intScan(&index,25,GT,40,LT), 14)
+	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(orderedScan(&index,0,largerelationSize,DESCENDING), largerelationSize)
+}
+
+void nodeCacheLimitTests()
+{
+  std::cout << "Create a B+ Tree index with more non-leaf nodes than buffer frames, caching only its upper levels" << std::endl;
+	{
+		// leaves and non-leaf nodes filled to 2% give the tree thousands of non-leaf nodes
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, 0.02);
+
+		// the frames left to the buffer manager still hold the relation as it streams through
+		int tuples = 0;
+		{
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					fscan.scanNext(scanRid);
+					tuples++;
+				}
+			}
+			catch(EndOfFileException e)
+			{
+			}
+		}
+		checkPassFail(tuples, largerelationSize)
+		int found = 0;
+		RecordId rid;
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			found += index.lookup(&key, rid) ? 1 : 0;
+		}
+		checkPassFail(found, largerelationSize)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+		// deleting keys merges nodes that are cached and nodes that are not, and inserting them again splits them
+		std::vector<RecordId> ridOf(largerelationSize);
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			index.lookup(&key, ridOf[key]);
+		}
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			if(key % 4 != 0)
+			{
+				index.deleteEntry(&key, ridOf[key]);
+			}
+		}
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize / 4)
+		for(int key = 0; key < largerelationSize; key++)
+		{
+			if(key % 4 != 0)
+			{
+				index.insertEntry(&key, ridOf[key]);
+			}
+		}
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	}
+
+	// opening the index again caches as many of its upper levels as fit, and reads the rest through the buffer pool
+	std::string compositeIndexName;
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+		checkPassFail(orderedScan(&index,0,largerelationSize,DESCENDING), largerelationSize)
+
+		// three more indexes with thousands of non-leaf nodes each share the frames the first one caches its nodes
+		// in, rather than taking as many again each, and leave the rest of the pool to the relation streaming through
+		std::vector<KeyAttribute> attributes;
+		attributes.push_back(KeyAttribute{(int)offsetof(tuple,i), INTEGER});
+		attributes.push_back(KeyAttribute{(int)offsetof(tuple,d), DOUBLE});
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, 0.02);
+		BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, 0.02);
+		BTreeIndex compositeIndex(relationName, compositeIndexName, bufMgr, attributes, 0.02);
+		bool shared = bufMgr->getReservedFrames() <= bufMgr->getNumBufs() * NODE_CACHE_POOL_PERCENT / 100;
+		checkPassFail(shared, true)
+		int tuples = 0;
+		{
+			FileScan fscan(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					fscan.scanNext(scanRid);
+					tuples++;
+				}
+			}
+			catch(EndOfFileException e)
+			{
+			}
+		}
+		checkPassFail(tuples, largerelationSize)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+
+	// closing the indexes gives their frames back
+	checkPassFail(bufMgr->getReservedFrames(), 0)
+	File::remove(compositeIndexName);
+}
+
+void redistributeTests()
+{
+  std::cout << "Insert keys in random order into B+ Tree indexes that split full leaves in two, and that share them first" << std::endl;
+	std::vector<int> keys(largerelationSize);
+	for(int k = 0; k < largerelationSize; k++)
+	{
+		keys[k] = k;
+	}
+	for(int k = largerelationSize - 1; k > 0; k--)
+	{
+		std::swap(keys[k], keys[random() % (k + 1)]);
+	}
+
+	// two leaves split into three leave them two thirds full at least, where splitting one in two leaves it half full
+	int splitPages = indexPages(false, keys);
+	int sharedPages = indexPages(true, keys);
+	std::cout << "Index pages: " << splitPages << " split, " << sharedPages << " shared" << std::endl;
+	bool fewer = sharedPages * 8 < splitPages * 7;
+	checkPassFail(fewer, true)
+	bool full = sharedPages < largerelationSize / (INTARRAYLEAFSIZE * 0.8) + 4;
+	checkPassFail(full, true)
+
+	// the index keeps redistributing once opened again, while threads insert and delete at the same time
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(orderedScan(&index,0,largerelationSize,ASCENDING), largerelationSize)
+	checkPassFail(orderedScan(&index,0,largerelationSize,DESCENDING), largerelationSize)
+	int found = 0;
+	RecordId rid;
+	for(int k = 0; k < largerelationSize; k += 7)
+	{
+		found += (index.lookup(&k, rid) && rid.page_number == (PageId)(k / 100 + 1) && rid.slot_number == k % 100) ? 1 : 0;
+	}
+	checkPassFail(found, (largerelationSize + 6) / 7)
+
+	const int added = 40000;
+	std::vector<std::thread> threads;
+	for(int w = 0; w < 4; w++)
+	{
+		threads.push_back(std::thread([&index, &keys, w, added]()
+		{
+			// the keys below added, in random order
+			for(size_t j = w; j < keys.size(); j += 4)
+			{
+				if(keys[j] >= added)
+				{
+					continue;
+				}
+				int key = largerelationSize + keys[j];
+				RecordId rid;
+				rid.page_number = key / 100 + 1;
+				rid.slot_number = key % 100;
+				index.insertEntry(&key, rid);
+			}
+		}));
+	}
+	threads.push_back(std::thread([&index]()
+	{
+		for(int k = 0; k < largerelationSize; k += 2)
+		{
+			RecordId rid;
+			rid.page_number = k / 100 + 1;
+			rid.slot_number = k % 100;
+			index.deleteEntry(&k, rid);
+		}
+	}));
+	for(size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize / 2)
+	checkPassFail(rangeCount(&index,largerelationSize,GTE,largerelationSize + added,LT), added)
+	checkPassFail(rangeCount(&index,25,GT,40,LT), 7)
+	checkPassFail(orderedScan(&index,0,largerelationSize + added,ASCENDING), largerelationSize / 2 + added)
+	checkPassFail(orderedScan(&index,0,largerelationSize + added,DESCENDING), largerelationSize / 2 + added)
+}
+
+int indexPages(bool redistributeLeaves, const std::vector<int> &keys)
+{
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR, false,
+		                 redistributeLeaves);
+		for(size_t j = 0; j < keys.size(); j++)
+		{
+			RecordId rid;
+			rid.page_number = keys[j] / 100 + 1;
+			rid.slot_number = keys[j] % 100;
+			index.insertEntry(&keys[j], rid);
+		}
+	}
+	std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+	return (int)(indexFile.tellg() / Page::SIZE);
+}
+
+void writeTests()
+{
+  std::cout << "Insert and delete keys in random order, marking only the pages that change dirty" << std::endl;
+	std::vector<int> keys(largerelationSize);
+	for(int k = 0; k < largerelationSize; k++)
+	{
+		keys[k] = k;
+	}
+	for(int k = largerelationSize - 1; k > 0; k--)
+	{
+		std::swap(keys[k], keys[random() % (k + 1)]);
+	}
+
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	RecordId rid;
+	for(int j = 0; j < largerelationSize / 2; j++)
+	{
+		rid.page_number = keys[j] / 100 + 1;
+		rid.slot_number = keys[j] % 100;
+		index.insertEntry(&keys[j], rid);
+	}
+
+	// an insert that does not split writes its leaf and nothing else through the buffer manager,
+	// and a split writes the new leaf and the right sibling's left link besides
+	index.clearWriteStats();
+	bufMgr->clearBufStats();
+	for(int j = largerelationSize / 2; j < largerelationSize; j++)
+	{
+		rid.page_number = keys[j] / 100 + 1;
+		rid.slot_number = keys[j] % 100;
+		index.insertEntry(&keys[j], rid);
+	}
+	IndexWriteStats stats = index.getWriteStats();
+	std::cout << "Inserts: " << stats.inserts << " dirty pages: " << stats.dirtyPages << " dirty cached nodes: "
+	          << stats.dirtyCachedNodes << " disk writes: " << bufMgr->getBufStats().diskwrites << std::endl;
+	checkPassFail(stats.inserts, largerelationSize / 2)
+	bool oneLeaf = stats.dirtyPages < stats.inserts * 21 / 20;
+	checkPassFail(oneLeaf, true)
+	bool written = bufMgr->getBufStats().diskwrites <= stats.dirtyPages;
+	checkPassFail(written, true)
+
+	// reads mark nothing dirty
+	index.clearWriteStats();
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize)
+	checkPassFail(orderedScan(&index,0,largerelationSize,ASCENDING), largerelationSize)
+	int found = 0;
+	for(int k = 0; k < largerelationSize; k += 3)
+	{
+		found += index.lookup(&k, rid) ? 1 : 0;
+	}
+	checkPassFail(found, (largerelationSize + 2) / 3)
+	stats = index.getWriteStats();
+	bool clean = stats.dirtyPages == 0 && stats.dirtyCachedNodes == 0;
+	checkPassFail(clean, true)
+
+	// a delete that leaves its leaf above the minimum writes only the leaf, and entries that are not there nothing
+	for(int j = 0; j < largerelationSize / 4; j++)
+	{
+		rid.page_number = keys[j] / 100 + 1;
+		rid.slot_number = keys[j] % 100 + 1;
+		index.deleteEntry(&keys[j], rid);
+	}
+	stats = index.getWriteStats();
+	clean = stats.deletes == 0 && stats.dirtyPages == 0;
+	checkPassFail(clean, true)
+	for(int j = 0; j < largerelationSize / 4; j++)
+	{
+		rid.page_number = keys[j] / 100 + 1;
+		rid.slot_number = keys[j] % 100;
+		index.deleteEntry(&keys[j], rid);
+	}
+	stats = index.getWriteStats();
+	std::cout << "Deletes: " << stats.deletes << " dirty pages: " << stats.dirtyPages << std::endl;
+	checkPassFail(stats.deletes, largerelationSize / 4)
+	oneLeaf = stats.dirtyPages < stats.deletes * 21 / 20;
+	checkPassFail(oneLeaf, true)
+	checkPassFail(rangeCount(&index,0,GTE,largerelationSize,LT), largerelationSize - largerelationSize / 4)
+}
+
+void doubleKeyTests()
+{
+  std::cout << "Bulk load a B+ Tree index on the double field, with keys between and beyond the ints" << std::endl;
+	BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, DEFAULT_FILL_FACTOR, true);
+
+	// the keys are the doubles 0 to largerelationSize - 1, in order whatever the order of the records
+	const size_t batchSize = 128;
+	RecordId rids[batchSize];
+	double keys[batchSize];
+	double lowVal = -0.5;
+	double highVal = largerelationSize;
+	int numResults = 0;
+	bool ordered = true;
+	BTreeCursor cursor = index.openScan(&lowVal, GT, &highVal, LT);
+	size_t count;
+	while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			ordered = ordered && keys[i] == (double)numResults;
+			numResults++;
+		}
+	}
+	cursor.endScan();
+	checkPassFail(numResults, largerelationSize)
+	checkPassFail(ordered, true)
+
+	// fractional bounds fall between the keys
+	lowVal = 0.5;
+	highVal = 10.25;
+	checkPassFail((int)index.countRange(&lowVal, GT, &highVal, LTE), 10)
+	RecordId rid;
+	double key = 42.0;
+	checkPassFail(index.lookup(&key, rid), true)
+	key = 42.5;
+	checkPassFail(index.lookup(&key, rid), false)
+
+	// keys beyond the range of any int
+	rid.page_number = 1;
+	rid.slot_number = 0;
+	double negative = -1.5;
+	double huge = 1e300;
+	index.insertEntry(&negative, rid);
+	index.insertEntry(&huge, rid);
+	double minKey, maxKey;
+	index.minKey(&minKey);
+	index.maxKey(&maxKey);
+	bool edges = minKey == negative && maxKey == huge;
+	checkPassFail(edges, true)
+	checkPassFail(index.deleteEntry(&huge, rid), true)
+	index.maxKey(&maxKey);
+	bool last = maxKey == (double)(largerelationSize - 1);
+	checkPassFail(last, true)
+
+	// keys of any other type are refused
+	std::vector<RIDKeyPair<int> > intEntries(1);
+	intEntries[0].set(rid, 7);
+	bool refused = false;
+	try
+	{
+		index.insertEntries(intEntries);
+	}
+	catch(BadIndexInfoException e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+}
+
+void bigintKeyTests()
+{
+  std::cout << "Insert 64 bit keys into a B+ Tree index on an empty relation, in random order and packed" << std::endl;
+	// no record of the empty relation is read, so the index can be on any field: the string one keeps its file apart
+	std::string bigIndexName;
+	{
+		BTreeIndex index(relationName, bigIndexName, bufMgr, offsetof(tuple,s), BIGINT, DEFAULT_FILL_FACTOR, true);
+
+		// runs of dense keys far above 32 bits, which pack against a 64 bit base, inserted in random order
+		const long long base = 5LL << 40;
+		std::vector<RIDKeyPair<long long> > entries(largerelationSize);
+		for(int k = 0; k < largerelationSize; k++)
+		{
+			RecordId rid;
+			rid.page_number = k / 100 + 1;
+			rid.slot_number = k % 100;
+			entries[k].set(rid, base + (long long)(k / 1000) * (1LL << 33) + k % 1000);
+		}
+		for(int k = largerelationSize - 1; k > 0; k--)
+		{
+			std::swap(entries[k], entries[random() % (k + 1)]);
+		}
+		index.insertEntries(entries);
+
+		const size_t batchSize = 128;
+		RecordId rids[batchSize];
+		long long keys[batchSize];
+		long long lowVal = base;
+		long long highVal = base + (long long)(largerelationSize / 1000) * (1LL << 33);
+		int numResults = 0;
+		bool ordered = true;
+		BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LT, DESCENDING);
+		size_t count;
+		while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				int k = largerelationSize - 1 - numResults;
+				ordered = ordered && keys[i] == base + (long long)(k / 1000) * (1LL << 33) + k % 1000;
+				numResults++;
+			}
+		}
+		cursor.endScan();
+		checkPassFail(numResults, largerelationSize)
+		checkPassFail(ordered, true)
+
+		// a key that differs from a stored one only in its upper 32 bits is not found
+		std::vector<long long> probes;
+		probes.push_back(base + 7);
+		probes.push_back(base + 7 + (1LL << 32));
+		probes.push_back(base + (1LL << 33) + 999);
+		std::vector<RecordId> out(probes.size());
+		bool found[3];
+		checkPassFail((int)index.lookupMany(&probes[0], probes.size(), &out[0], found), 2)
+		bool missing = found[0] && !found[1] && found[2];
+		checkPassFail(missing, true)
+
+		long long minKey, maxKey;
+		index.minKey(&minKey);
+		index.maxKey(&maxKey);
+		bool edges = minKey == base && maxKey == highVal - (1LL << 33) + 999;
+		checkPassFail(edges, true)
+	}
+	File::remove(bigIndexName);
+}
+
+void doubleOrderTests()
+{
+  std::cout << "Insert double keys of both signs, zeros and extremes into a B+ Tree index on an empty relation" << std::endl;
+	// no record of the empty relation is read, so the index can be on any field
+	std::string orderIndexName;
+	{
+		BTreeIndex index(relationName, orderIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+		// keys spread over both signs and many exponents, inserted in random order. -0.0 is the same key as 0.0
+		std::vector<double> values;
+		for(int k = 1; k <= 2000; k++)
+		{
+			values.push_back(k * 0.75);
+			values.push_back(-k * 0.75);
+			values.push_back(ldexp(1.0 + k / 4096.0, k % 600 - 300));
+			values.push_back(-ldexp(1.0 + k / 4096.0, k % 600 - 300));
+		}
+		values.push_back(0.0);
+		values.push_back(-0.0);
+		values.push_back(std::numeric_limits<double>::denorm_min());
+		values.push_back(-std::numeric_limits<double>::denorm_min());
+		values.push_back(std::numeric_limits<double>::max());
+		values.push_back(-std::numeric_limits<double>::max());
+		std::vector<RIDKeyPair<double> > entries(values.size());
+		for(size_t k = 0; k < values.size(); k++)
+		{
+			RecordId rid;
+			rid.page_number = k / 100 + 1;
+			rid.slot_number = k % 100;
+			entries[k].set(rid, values[k]);
+		}
+		for(size_t k = entries.size() - 1; k > 0; k--)
+		{
+			std::swap(entries[k], entries[random() % (k + 1)]);
+		}
+		for(size_t k = 0; k < entries.size(); k++)
+		{
+			index.insertEntry(&entries[k].key, entries[k].rid);
+		}
+
+		// every key comes back, in the order of the doubles
+		std::sort(values.begin(), values.end());
+		const size_t batchSize = 128;
+		RecordId rids[batchSize];
+		double keys[batchSize];
+		double lowVal = -std::numeric_limits<double>::max();
+		double highVal = std::numeric_limits<double>::max();
+		size_t numResults = 0;
+		bool ordered = true;
+		BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LTE);
+		size_t count;
+		while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				ordered = ordered && numResults < values.size() && keys[i] == values[numResults];
+				numResults++;
+			}
+		}
+		cursor.endScan();
+		bool all = numResults == values.size();
+		checkPassFail(all, true)
+		checkPassFail(ordered, true)
+
+		// ranges across zero, where the negative keys turn around
+		lowVal = -1.5;
+		highVal = 1.5;
+		int near = (int)(std::upper_bound(values.begin(), values.end(), highVal) -
+		                 std::lower_bound(values.begin(), values.end(), lowVal));
+		checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LTE), near)
+		lowVal = -0.0;
+		highVal = 0.0;
+		checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LTE), 2)
+		checkPassFail((int)index.countRange(&lowVal, GT, &highVal, LTE), 0)
+		RecordId rid;
+		double key = -0.0;
+		checkPassFail(index.lookup(&key, rid), true)
+		key = -750.0;
+		checkPassFail(index.lookup(&key, rid), true)
+		key = -750.25;
+		checkPassFail(index.lookup(&key, rid), false)
+
+		double minKey, maxKey;
+		index.minKey(&minKey);
+		index.maxKey(&maxKey);
+		bool edges = minKey == -std::numeric_limits<double>::max() && maxKey == std::numeric_limits<double>::max();
+		checkPassFail(edges, true)
+
+		// +infinity pads the nodes: as a bound it takes in every finite key, but it cannot be inserted
+		double inf = std::numeric_limits<double>::infinity();
+		lowVal = 0.0;
+		int positive = (int)(values.end() - std::lower_bound(values.begin(), values.end(), lowVal));
+		checkPassFail((int)index.countRange(&lowVal, GTE, &inf, LTE), positive)
+		checkPassFail((int)index.countRange(&inf, GTE, &inf, LTE), 0)
+		numResults = 0;
+		cursor = index.openScan(&lowVal, GTE, &inf, LT);
+		while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			numResults += count;
+		}
+		cursor.endScan();
+		checkPassFail((int)numResults, positive)
+		checkPassFail(index.lookup(&inf, rid), false)
+		bool refused = false;
+		try
+		{
+			index.insertEntry(&inf, rid);
+		}
+		catch(BadIndexInfoException e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+
+		// -infinity is an ordinary key
+		lowVal = -inf;
+		index.insertEntry(&lowVal, rid);
+		checkPassFail((int)index.countRange(&lowVal, GTE, &inf, LTE), (int)values.size() + 1)
+		checkPassFail(index.lookup(&lowVal, rid), true)
+
+		// NaN has no place in the order: as a bound it stands for +infinity, it is never found, and it cannot be
+		// inserted, alone or in a batch
+		double nan = std::numeric_limits<double>::quiet_NaN();
+		checkPassFail((int)index.countRange(&lowVal, GTE, &nan, LTE), (int)values.size() + 1)
+		checkPassFail((int)index.countRange(&nan, GTE, &inf, LTE), 0)
+		numResults = 0;
+		cursor = index.openScan(&lowVal, GTE, &nan, LT);
+		while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			numResults += count;
+		}
+		cursor.endScan();
+		checkPassFail((int)numResults, (int)values.size() + 1)
+		checkPassFail(index.lookup(&nan, rid), false)
+		std::vector<RecordId> nanRids;
+		checkPassFail((int)index.lookupAll(&nan, nanRids), 0)
+		double probes[] = {nan, 0.75, inf, -0.75, -nan};
+		RecordId probeRids[5];
+		bool found[5];
+		checkPassFail((int)index.lookupMany(probes, 5, probeRids, found), 2)
+		bool misses = !found[0] && found[1] && !found[2] && found[3] && !found[4];
+		checkPassFail(misses, true)
+		checkPassFail(index.deleteEntry(&nan, rid), false)
+		refused = false;
+		try
+		{
+			index.insertEntry(&nan, rid);
+		}
+		catch(BadIndexInfoException e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+		std::vector<RIDKeyPair<double> > batch(entries.begin(), entries.begin() + 10);
+		batch[5].key = nan;
+		refused = false;
+		try
+		{
+			index.insertEntries(batch);
+		}
+		catch(BadIndexInfoException e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+		checkPassFail((int)index.countRange(&lowVal, GTE, &inf, LTE), (int)values.size() + 1)
+	}
+	File::remove(orderIndexName);
+
+	// a relation with +infinity, or with NaN, gets no index, and no index file is left behind
+	double unindexable[] = {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN()};
+	for(int i = 0; i < 2; i++)
+	{
+		record1.i = 7;
+		record1.d = unindexable[i];
+		std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+		PageId pageNo = (*file1->begin()).page_number();
+		Page page = file1->readPage(pageNo);
+		RecordId recordId = page.insertRecord(new_data);
+		file1->writePage(pageNo, page);
+		bool refused = false;
+		try
+		{
+			BTreeIndex index(relationName, orderIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		}
+		catch(BadIndexInfoException e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+		checkPassFail(File::exists(orderIndexName), false)
+		page.deleteRecord(recordId);
+		file1->writePage(pageNo, page);
+	}
+}
+
+void stringKeyTests()
+{
+  std::cout << "Bulk load a B+ Tree index on the string field, with identifiers that tie on their first bytes" << std::endl;
+	BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// every key comes back, in order
+	const size_t batchSize = 128;
+	RecordId rids[batchSize];
+	StringKey keys[batchSize];
+	int numResults = 0;
+	bool ordered = true;
+	StringKey previous = StringKey::of("");
+	BTreeCursor cursor = index.openScan("ext:", GT, "ext;", LT);
+	size_t count;
+	while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			ordered = ordered && previous <= keys[i];
+			previous = keys[i];
+			numResults++;
+		}
+	}
+	cursor.endScan();
+	checkPassFail(numResults, largerelationSize)
+	checkPassFail(ordered, true)
+	StringKey minKey;
+	index.minKey(&minKey);
+	bool first = minKey == StringKey::of("ext:000000000000");
+	checkPassFail(first, true)
+
+	// a lookup finds the record a file scan finds, telling it apart from those sharing its key by the record
+	const char *id = "ext:000000012345-02";
+	RecordId scanRid;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				if(strcmp(fscan.getRecord().c_str() + offsetof(tuple,s), id) == 0)
+				{
+					break;
+				}
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+	RecordId rid;
+	checkPassFail(index.lookup(id, rid), true)
+	bool same = rid.page_number == scanRid.page_number && rid.slot_number == scanRid.slot_number;
+	checkPassFail(same, true)
+	std::vector<RecordId> all;
+	checkPassFail((int)index.lookupAll(id, all), 1)
+	checkPassFail(index.lookup("ext:000000012345-07", rid), false)
+	checkPassFail(index.lookup("ext:", rid), false)
+
+	const char *probes[] = {"ext:000000000007-03", "ext:000000000007-04", "ext:0000000000", "ext:000000024999-03"};
+	RecordId out[4];
+	bool found[4];
+	checkPassFail((int)index.lookupMany(probes, 4, out, found), 2)
+	bool which = found[0] && !found[1] && !found[2] && found[3];
+	checkPassFail(which, true)
+
+	// bounds that tie with stored keys cut through their entries: values 42 to 82
+	const char *lowVal = "ext:000000000010-01";
+	const char *highVal = "ext:000000000020-02";
+	checkPassFail((int)index.countRange(lowVal, GT, highVal, LTE), 41)
+	checkPassFail((int)index.countRange(lowVal, GTE, lowVal, LTE), 1)
+	checkPassFail((int)index.countRange("ext:000000000010", GTE, highVal, LT), 42)
+	numResults = 0;
+	bool inRange = true;
+	index.startScan(lowVal, GT, highVal, LTE);
+	try
+	{
+		while(1)
+		{
+			index.scanNext(rid);
+			std::string record = file1->readPage(rid.page_number).getRecord(rid);
+			int val = reinterpret_cast<const RECORD*>(record.data())->i;
+			inRange = inRange && val >= 42 && val <= 82;
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	index.endScan();
+	checkPassFail(numResults, 41)
+	checkPassFail(inRange, true)
+}
+
+void stringNodeTests()
+{
+  std::cout << "Insert and delete string keys of many lengths, splitting and merging non-leaf nodes whose keys share more or fewer bytes" << std::endl;
+	std::vector<int> vals(largerelationSize);
+	for(int k = 0; k < largerelationSize; k++)
+	{
+		vals[k] = k;
+	}
+	for(int k = largerelationSize - 1; k > 0; k--)
+	{
+		std::swap(vals[k], vals[random() % (k + 1)]);
+	}
+
+	// four runs of keys: the nodes within a run share its first bytes, those spanning two runs none of them
+	BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+	char key[32];
+	RecordId rid;
+	for(int j = 0; j < largerelationSize; j++)
+	{
+		sprintf(key, "%c-cust-%d", 'a' + vals[j] % 4, vals[j] / 4);
+		rid.page_number = vals[j] / 100 + 1;
+		rid.slot_number = vals[j] % 100;
+		index.insertEntry(key, rid);
+	}
+
+	// the keys from "b-cust-1" up to "b-cust-2" are those of the second run whose numbers start with a 1
+	checkPassFail((int)index.countRange("b-cust-1", GTE, "b-cust-2", LT), 11111)
+
+	// keep every third value, deleting the others in random order
+	for(int j = 0; j < largerelationSize; j++)
+	{
+		if(vals[j] % 3 != 0)
+		{
+			sprintf(key, "%c-cust-%d", 'a' + vals[j] % 4, vals[j] / 4);
+			rid.page_number = vals[j] / 100 + 1;
+			rid.slot_number = vals[j] % 100;
+			index.deleteEntry(key, rid);
+		}
+	}
+	int ones = 0;
+	for(int k = 1; k < largerelationSize; k += 4)
+	{
+		sprintf(key, "%d", k / 4);
+		ones += (k % 3 == 0 && key[0] == '1') ? 1 : 0;
+	}
+	checkPassFail((int)index.countRange("b-cust-1", GTE, "b-cust-2", LT), ones)
+
+	// every key left comes back, in order
+	const size_t batchSize = 128;
+	RecordId rids[batchSize];
+	StringKey keys[batchSize];
+	int numResults = 0;
+	bool ordered = true;
+	StringKey previous = StringKey::of("");
+	BTreeCursor cursor = index.openScan("a", GTE, "e", LT);
+	size_t count;
+	while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			ordered = ordered && previous < keys[i];
+			previous = keys[i];
+			numResults++;
+		}
+	}
+	cursor.endScan();
+	checkPassFail(numResults, (largerelationSize + 2) / 3)
+	checkPassFail(ordered, true)
+
+	checkPassFail(index.lookup("a-cust-75", rid), true)
+	bool same = rid.page_number == 4 && rid.slot_number == 0;
+	checkPassFail(same, true)
+	checkPassFail(index.lookup("a-cust-76", rid), false)
+	checkPassFail(index.lookup("a-cust-", rid), false)
+	checkPassFail(index.lookup("d-cust-3000000", rid), false)
+}
+
+void compositeKeyTests()
 {
-  // destroy any old copies of relation file
-    try
-    {
-        File::remove(relationName);
-    }
-    catch(FileNotFoundException e)
-    {
-    }
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+  std::cout << "Bulk load a B+ Tree index on the int and double fields together, and scan equality prefixes" << std::endl;
+	std::vector<KeyAttribute> attributes;
+	attributes.push_back(KeyAttribute{(int)offsetof(tuple,i), INTEGER});
+	attributes.push_back(KeyAttribute{(int)offsetof(tuple,d), DOUBLE});
+	std::string compositeIndexName;
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attributes);
+
+		// i = 5 AND d BETWEEN -10 AND 10: one range of keys, in the order of d
+		int i = 5;
+		double lowD = -10.0;
+		double highD = 10.0;
+		const void *lowValues[] = {&i, &lowD};
+		const void *highValues[] = {&i, &highD};
+		CompositeKey lowVal = CompositeKey::of(attributes, lowValues, 2);
+		CompositeKey highVal = CompositeKey::of(attributes, highValues, 2);
+		int numResults = 0;
+		bool matching = true;
+		double lastD = lowD - 1;
+		Page *curPage;
+		BTreeCursor cursor = index.openScan(&lowVal, GTE, &highVal, LTE);
+		try
+		{
+			while(1)
+			{
+				RecordId rid;
+				cursor.scanNext(rid);
+				bufMgr->readPage(file1, rid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rid).data()));
+				bufMgr->unPinPage(file1, rid.page_number, false);
+				matching = matching && myRec.i == i && myRec.d >= lowD && myRec.d <= highD && myRec.d > lastD;
+				lastD = myRec.d;
+				numResults++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		checkPassFail(numResults, 41)
+		checkPassFail(matching, true)
+		checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LT), 40)
+
+		// i = 7 alone: from the first key with it to the last
+		i = 7;
+		const void *prefix[] = {&i};
+		lowVal = CompositeKey::of(attributes, prefix, 1);
+		highVal = CompositeKey::last(attributes, prefix, 1);
+		checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LTE), largerelationSize / 50)
+
+		// every key of the relation, in the order of i and then of d
+		i = 0;
+		lowVal = CompositeKey::of(attributes, prefix, 1);
+		i = 49;
+		highVal = CompositeKey::last(attributes, prefix, 1);
+		checkPassFail((int)index.countRange(&lowVal, GTE, &highVal, LTE), largerelationSize)
+
+		// lookups, inserts and deletes take whole keys
+		RecordId rid;
+		i = 3;
+		double d = -499.5;
+		const void *values[] = {&i, &d};
+		CompositeKey key = CompositeKey::of(attributes, values, 2);
+		checkPassFail(index.lookup(&key, rid), true)
+		d = -499.25;
+		key = CompositeKey::of(attributes, values, 2);
+		checkPassFail(index.lookup(&key, rid), false)
+		rid.page_number = 1;
+		rid.slot_number = 0;
+		index.insertEntry(&key, rid);
+		checkPassFail(index.lookup(&key, rid), true)
+		checkPassFail(index.deleteEntry(&key, rid), true)
+		checkPassFail(index.lookup(&key, rid), false)
+	}
 
-  // Insert a bunch of tuples into the relation.
-  for(int i = maxrelationsize - 1; i >= 0; i-- )
-    {
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = i;
+	// the meta page keeps the attributes: the same ones open the index, others with the same offsets are refused
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, attributes);
+		int i = 49;
+		double d = 499.5;
+		const void *values[] = {&i, &d};
+		CompositeKey key = CompositeKey::of(attributes, values, 2);
+		RecordId rid;
+		checkPassFail(index.lookup(&key, rid), true)
+	}
+	std::vector<KeyAttribute> others(attributes);
+	others[1].type = BIGINT;
+	bool refused = false;
+	try
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, others);
+	}
+	catch(BadIndexInfoException e)
+	{
+		refused = true;
+	}
+	checkPassFail(refused, true)
+	File::remove(compositeIndexName);
+}
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+void parallelBuildTests()
+{
+  std::cout << "Bulk load B+ Tree indexes with one thread and with several, and compare the index files" << std::endl;
+	const int threadCounts[] = {3, 8};
+	for(int compress = 0; compress < 2; compress++)
+	{
+		std::string serial;
+		{
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+					compress == 1, false, 1);
+		}
+		{
+			std::ifstream indexFile(intIndexName.c_str(), std::ios::binary);
+			serial.assign(std::istreambuf_iterator<char>(indexFile), std::istreambuf_iterator<char>());
+		}
+		File::remove(intIndexName);
 
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-        }
-  }
+		for(int i = 0; i < 2; i++)
+		{
+			{
+				BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, DEFAULT_FILL_FACTOR,
+						compress == 1, false, threadCounts[i]);
+				checkPassFail(intScan(&index,25,GT,40,LT), 14)
+				checkPassFail(intScan(&index,0,GTE,largerelationSize,LT), largerelationSize)
+			}
+			std::ifstream indexFile(intIndexName.c_str(), std::ios::binary);
+			std::string parallel((std::istreambuf_iterator<char>(indexFile)), std::istreambuf_iterator<char>());
+			bool same = !serial.empty() && parallel == serial;
+			checkPassFail(same, true)
+			File::remove(intIndexName);
+		}
+	}
 
-    file1->writePage(new_page_number, new_page);
+	// the same for STRING keys
+	std::string serial;
+	{
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, DEFAULT_FILL_FACTOR,
+				false, false, 1);
+	}
+	{
+		std::ifstream indexFile(stringIndexName.c_str(), std::ios::binary);
+		serial.assign(std::istreambuf_iterator<char>(indexFile), std::istreambuf_iterator<char>());
+	}
+	File::remove(stringIndexName);
+	{
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, DEFAULT_FILL_FACTOR,
+				false, false, 5);
+	}
+	std::ifstream indexFile(stringIndexName.c_str(), std::ios::binary);
+	std::string parallel((std::istreambuf_iterator<char>(indexFile)), std::istreambuf_iterator<char>());
+	bool same = !serial.empty() && parallel == serial;
+	checkPassFail(same, true)
+	File::remove(stringIndexName);
 }
 
-// -----------------------------------------------------------------------------
-// createMaxRelationRandom
-// -----------------------------------------------------------------------------
-
-void createMaxRelationRandom()
+int orderedScan(BTreeIndex * index, int lowVal, int highVal, ScanOrder order)
 {
-  // destroy any old copies of relation file
-    try
-    {
-        File::remove(relationName);
-    }
-    catch(FileNotFoundException e)
-    {
-    }
-  file1 = new PageFile(relationName, true);
+  std::cout << "Scan for [" << lowVal << "," << highVal << "), checking the order of its keys" << std::endl;
+
+	// keys in order without checking records, so that entries without one may be in the range
+	const size_t batchSize = 128;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	int numResults = 0;
+	bool first = true;
+	int lastKey = 0;
+	try
+	{
+		BTreeCursor cursor = index->openScan(&lowVal, GTE, &highVal, LT, order);
+		size_t count;
+		while((count = cursor.scanNextBatch(rids, keys, batchSize)) > 0)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				bool ordered = first || ((order == ASCENDING) ? keys[i] >= lastKey : keys[i] <= lastKey);
+				if(!ordered || keys[i] < lowVal || keys[i] >= highVal)
+				{
+					std::cout << "Scan returned key " << keys[i] << " after key " << lastKey << std::endl;
+					exit(1);
+				}
+				lastKey = keys[i];
+				first = false;
+			}
+			numResults += count;
+		}
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+	}
+  std::cout << "Number of results: " << numResults << std::endl;
+  std::cout << std::endl;
 
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	return numResults;
+}
 
-  // insert records in random order
+int rangeCount(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Count for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
 
-  std::vector<int> intvec(maxrelationsize);
-  for( int i = 0; i < maxrelationsize; i++ )
-  {
-    intvec[i] = i;
-  }
+	int numResults = (int)index->countRange(&lowVal, lowOp, &highVal, highOp);
+  std::cout << "Number of results: " << numResults << std::endl;
+  std::cout << std::endl;
 
-  long pos;
-  int val;
-    int i = 0;
-  while( i < maxrelationsize )
-  {
-    pos = random() % (maxrelationsize-i);
-    val = intvec[pos];
-    sprintf(record1.s, "%05d string record", val);
-    record1.i = val;
-    record1.d = val;
+	return numResults;
+}
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
+int reverseScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	const size_t batchSize = 64;
+	RecordId rids[batchSize];
+	int keys[batchSize];
+	Page *curPage;
 
-        while(1)
-        {
-            try
-            {
-            new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-          file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-        }
+  std::cout << "Reverse scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
 
-        int temp = intvec[maxrelationsize-1-i];
-        intvec[maxrelationsize-1-i] = intvec[pos];
-        intvec[pos] = temp;
-        i++;
-  }
-  
-    file1->writePage(new_page_number, new_page);
-}
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp, DESCENDING);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
 
+	// every key comes back in descending order, and matches the record its rid points at
+	int numResults = 0;
+	int lastKey = highVal + 1;
+	size_t count;
+	while((count = index->scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if(myRec.i != keys[i] || keys[i] >= lastKey)
+			{
+				std::cout << "Reverse scan returned key " << keys[i] << " for record " << myRec.i << " after key " << lastKey << std::endl;
+				exit(1);
+			}
+			lastKey = keys[i];
+		}
+		numResults += count;
+	}
 
-// -----------------------------------------------------------------------------
-// indexTests
-// -----------------------------------------------------------------------------
+	// scanNext agrees that the scan is over
+	RecordId rid;
+	try
+	{
+		index->scanNext(rid);
+		std::cout << "Reverse scan returned an entry past its end" << std::endl;
+		exit(1);
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
 
-void indexTests()
-{
-  if(testNum == 1)
-  {
-    intTests();
-        try
-        {
-            File::remove(intIndexName);
-        }
-      catch(FileNotFoundException e)
-      {
-      }
-  }
+	return numResults;
 }
 
+int keyScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	const size_t batchSize = 256;
+	RecordId rids[batchSize];
+	int keys[batchSize];
 
-// -----------------------------------------------------------------------------
-// intTests
-// -----------------------------------------------------------------------------
+  std::cout << "Key scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
 
-void intTests()
-{
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
 
-	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,300,GT,400,LT), 99)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	// keys are unique here, so they must come back strictly increasing
+	int numResults = 0;
+	int lastKey = lowVal - 1;
+	size_t count;
+	while((count = index->scanNextBatch(rids, keys, batchSize)) > 0)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			if(keys[i] <= lastKey)
+			{
+				std::cout << "Key scan returned key " << keys[i] << " after key " << lastKey << std::endl;
+				exit(1);
+			}
+			lastKey = keys[i];
+		}
+		numResults += count;
+	}
+  std::cout << "Number of results: " << numResults << std::endl;
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
 }
 
 int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
@@ -873,6 +4320,26 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 // errorTests
 // -----------------------------------------------------------------------------
 
+void test37()
+{
+    // Create a relation with tuples valued 0 to relationSize in random order and build its index with more non-leaf
+    // nodes than the buffer pool has frames
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createLargeRelationRandom, more non-leaf nodes than buffer frames" << std::endl;
+    createLargeRelationRandom();
+    nodeCacheLimitTests();
+    try
+    {
+        File::remove(intIndexName);
+        File::remove(doubleIndexName);
+        File::remove(stringIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
+
 void errorTests()
 {
 	std::cout << "Error handling tests" << std::endl;
@@ -0,0 +1,356 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "node_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NODE_SEARCH_X86
+#include <immintrin.h>
+#endif
+
+namespace badgerdb
+{
+
+// -----------------------------------------------------------------------------
+// Scalar kernel
+// -----------------------------------------------------------------------------
+
+// Whether a slot holding a comes before the position searched for: lowerBound
+// counts the keys < key, upperBound the keys <= key.
+template <class K, bool UPPER>
+static inline bool before(const K a, const K key)
+{
+    return UPPER ? !(key < a) : a < key;
+}
+
+// Branchless binary search: the loop has a fixed trip count for a given size
+// and the comparison only feeds a conditional move. Stops once at most window
+// slots are left, moving base to the first of them, and returns their number.
+template <class K, bool UPPER>
+static inline int narrow(const K *&base, const int size, const int window, const K key)
+{
+    int n = size;
+    while (n > window)
+    {
+        int half = n / 2;
+        base = before<K, UPPER>(base[half], key) ? base + half : base;
+        n -= half;
+    }
+    return n;
+}
+
+template <class K, bool UPPER>
+static int boundScalar(const K *keys, const int size, const K key)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+    const K *base = keys;
+    narrow<K, UPPER>(base, size, 1, key);
+    return (int)(base - keys) + before<K, UPPER>(*base, key);
+}
+
+static void decode16Scalar(const std::uint16_t *deltas, const int count, const int base, int *out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = base + deltas[i];
+    }
+}
+
+#ifdef NODE_SEARCH_X86
+
+// The vector kernels run the same binary search until at most WINDOW slots
+// are left, which are then counted with one compare and movemask per vector.
+// The answer always lies inside the window, so counting it is exact.
+// Only the compare differs between key widths, so each width supplies the
+// number of keys to a vector and how many keys of one vector come before the
+// position searched for.
+
+// -----------------------------------------------------------------------------
+// SSE4.2 kernel
+// -----------------------------------------------------------------------------
+
+static const int SSE42_WINDOW = 32;
+
+template <class K>
+struct Sse42Lanes;
+
+template <>
+struct Sse42Lanes<int>
+{
+    static const int WIDTH = 4;
+
+    template <bool UPPER>
+    __attribute__((target("sse4.2,popcnt"), always_inline)) static inline int countBefore(const int *slots,
+                                                                                          const int key)
+    {
+        const __m128i k = _mm_set1_epi32(key);
+        const __m128i v = _mm_loadu_si128((const __m128i *)slots);
+        if (UPPER)
+        {
+            // slots holding a key > key
+            return 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k))));
+        }
+        // slots holding a key < key
+        return __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v))));
+    }
+};
+
+// 64-bit keys compare two to a vector, which SSE4.2 added the signed compare for.
+template <>
+struct Sse42Lanes<long long>
+{
+    static const int WIDTH = 2;
+
+    template <bool UPPER>
+    __attribute__((target("sse4.2,popcnt"), always_inline)) static inline int countBefore(const long long *slots,
+                                                                                          const long long key)
+    {
+        const __m128i k = _mm_set1_epi64x(key);
+        const __m128i v = _mm_loadu_si128((const __m128i *)slots);
+        if (UPPER)
+        {
+            // slots holding a key > key
+            return 2 - __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, k))));
+        }
+        // slots holding a key < key
+        return __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v))));
+    }
+};
+
+// There is no unsigned 16-bit compare before AVX-512: a saturating subtraction is zero exactly
+// when its first operand is not above the second, and the byte mask counts each slot twice.
+template <>
+struct Sse42Lanes<std::uint16_t>
+{
+    static const int WIDTH = 8;
+
+    template <bool UPPER>
+    __attribute__((target("sse4.2,popcnt"), always_inline)) static inline int countBefore(const std::uint16_t *slots,
+                                                                                          const std::uint16_t key)
+    {
+        const __m128i k = _mm_set1_epi16((short)key);
+        const __m128i v = _mm_loadu_si128((const __m128i *)slots);
+        const __m128i zero = _mm_setzero_si128();
+        if (UPPER)
+        {
+            // slots holding a key <= key
+            return __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(v, k), zero))) / 2;
+        }
+        // slots holding a key >= key
+        return 8 - __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(k, v), zero))) / 2;
+    }
+};
+
+template <class K, bool UPPER>
+__attribute__((target("sse4.2,popcnt"))) static int boundSse42(const K *keys, const int size, const K key)
+{
+    const K *base = keys;
+    const int n = narrow<K, UPPER>(base, size, SSE42_WINDOW, key);
+
+    int count = 0;
+    int i = 0;
+    for (; i + Sse42Lanes<K>::WIDTH <= n; i += Sse42Lanes<K>::WIDTH)
+    {
+        count += Sse42Lanes<K>::template countBefore<UPPER>(base + i, key);
+    }
+    for (; i < n; i++)
+    {
+        count += before<K, UPPER>(base[i], key);
+    }
+    return (int)(base - keys) + count;
+}
+
+__attribute__((target("sse4.2"))) static void decode16Sse42(const std::uint16_t *deltas, const int count,
+                                                            const int base, int *out)
+{
+    const __m128i b = _mm_set1_epi32(base);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(deltas + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi32(_mm_cvtepu16_epi32(v), b));
+        _mm_storeu_si128((__m128i *)(out + i + 4), _mm_add_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)), b));
+    }
+    for (; i < count; i++)
+    {
+        out[i] = base + deltas[i];
+    }
+}
+
+// -----------------------------------------------------------------------------
+// AVX2 kernel
+// -----------------------------------------------------------------------------
+
+static const int AVX2_WINDOW = 64;
+
+template <class K>
+struct Avx2Lanes;
+
+template <>
+struct Avx2Lanes<int>
+{
+    static const int WIDTH = 8;
+
+    template <bool UPPER>
+    __attribute__((target("avx2,popcnt"), always_inline)) static inline int countBefore(const int *slots,
+                                                                                        const int key)
+    {
+        const __m256i k = _mm256_set1_epi32(key);
+        const __m256i v = _mm256_loadu_si256((const __m256i *)slots);
+        if (UPPER)
+        {
+            // slots holding a key > key
+            return 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k))));
+        }
+        // slots holding a key < key
+        return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+    }
+};
+
+template <>
+struct Avx2Lanes<long long>
+{
+    static const int WIDTH = 4;
+
+    template <bool UPPER>
+    __attribute__((target("avx2,popcnt"), always_inline)) static inline int countBefore(const long long *slots,
+                                                                                        const long long key)
+    {
+        const __m256i k = _mm256_set1_epi64x(key);
+        const __m256i v = _mm256_loadu_si256((const __m256i *)slots);
+        if (UPPER)
+        {
+            // slots holding a key > key
+            return 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k))));
+        }
+        // slots holding a key < key
+        return __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))));
+    }
+};
+
+template <>
+struct Avx2Lanes<std::uint16_t>
+{
+    static const int WIDTH = 16;
+
+    template <bool UPPER>
+    __attribute__((target("avx2,popcnt"), always_inline)) static inline int countBefore(const std::uint16_t *slots,
+                                                                                        const std::uint16_t key)
+    {
+        const __m256i k = _mm256_set1_epi16((short)key);
+        const __m256i v = _mm256_loadu_si256((const __m256i *)slots);
+        const __m256i zero = _mm256_setzero_si256();
+        if (UPPER)
+        {
+            // slots holding a key <= key
+            return __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_subs_epu16(v, k), zero))) / 2;
+        }
+        // slots holding a key >= key
+        return 16 - __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_subs_epu16(k, v), zero))) / 2;
+    }
+};
+
+template <class K, bool UPPER>
+__attribute__((target("avx2,popcnt"))) static int boundAvx2(const K *keys, const int size, const K key)
+{
+    const K *base = keys;
+    const int n = narrow<K, UPPER>(base, size, AVX2_WINDOW, key);
+
+    int count = 0;
+    int i = 0;
+    for (; i + Avx2Lanes<K>::WIDTH <= n; i += Avx2Lanes<K>::WIDTH)
+    {
+        count += Avx2Lanes<K>::template countBefore<UPPER>(base + i, key);
+    }
+    for (; i < n; i++)
+    {
+        count += before<K, UPPER>(base[i], key);
+    }
+    return (int)(base - keys) + count;
+}
+
+__attribute__((target("avx2"))) static void decode16Avx2(const std::uint16_t *deltas, const int count,
+                                                         const int base, int *out)
+{
+    const __m256i b = _mm256_set1_epi32(base);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(deltas + i));
+        __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(lo, b));
+        _mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_add_epi32(hi, b));
+    }
+    for (; i < count; i++)
+    {
+        out[i] = base + deltas[i];
+    }
+}
+
+#endif // NODE_SEARCH_X86
+
+// -----------------------------------------------------------------------------
+// Kernel selection
+// -----------------------------------------------------------------------------
+
+#define NODE_SEARCH_KERNEL(id, bound, decode16)                                                               \
+    {                                                                                                         \
+        id, bound<int, false>, bound<int, true>, bound<long long, false>, bound<long long, true>,            \
+            bound<std::uint16_t, false>, bound<std::uint16_t, true>, decode16                                 \
+    }
+
+// Only constants, so the tables and the pointer to the scalar one are set
+// before any dynamic initializer runs and searches work from the start.
+const NodeSearch::KernelTable NodeSearch::KERNELS[] = {
+    NODE_SEARCH_KERNEL(SEARCH_SCALAR, boundScalar, decode16Scalar),
+#ifdef NODE_SEARCH_X86
+    NODE_SEARCH_KERNEL(SEARCH_SSE42, boundSse42, decode16Sse42),
+    NODE_SEARCH_KERNEL(SEARCH_AVX2, boundAvx2, decode16Avx2),
+#else
+    // never picked: detectKernel only reports the scalar kernel here
+    NODE_SEARCH_KERNEL(SEARCH_SCALAR, boundScalar, decode16Scalar),
+    NODE_SEARCH_KERNEL(SEARCH_SCALAR, boundScalar, decode16Scalar),
+#endif
+};
+
+#undef NODE_SEARCH_KERNEL
+
+std::atomic<const NodeSearch::KernelTable *> NodeSearch::kernels(&NodeSearch::KERNELS[SEARCH_SCALAR]);
+
+SearchKernel NodeSearch::detectKernel()
+{
+#ifdef NODE_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    {
+        return SEARCH_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    {
+        return SEARCH_SSE42;
+    }
+#endif
+    return SEARCH_SCALAR;
+}
+
+SearchKernel NodeSearch::setKernel(const SearchKernel requested)
+{
+    SearchKernel supported = detectKernel();
+    SearchKernel use = (requested >= SEARCH_SCALAR && requested <= supported) ? requested : SEARCH_SCALAR;
+
+    kernels.store(&KERNELS[use], std::memory_order_release);
+    return use;
+}
+
+// pick the best kernel once, at startup
+static const SearchKernel initialKernel = NodeSearch::setKernel(NodeSearch::detectKernel());
+
+} // namespace badgerdb
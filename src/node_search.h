@@ -0,0 +1,262 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace badgerdb
+{
+
+/**
+ * @brief Search kernels that NodeSearch can run on.
+ */
+enum SearchKernel
+{
+  SEARCH_SCALAR = 0, /* Branchless binary search */
+  SEARCH_SSE42 = 1,  /* Binary search down to a small window, then 4-wide compare and movemask */
+  SEARCH_AVX2 = 2    /* Binary search down to a small window, then 8-wide compare and movemask */
+};
+
+/**
+ * @brief In-node key search shared by the leaf and non-leaf nodes of the B+ Tree.
+ *
+ * Key arrays are sorted in ascending order and padded with INT32_MAX from the first empty slot on,
+ * so a search can always run over the whole array: the padding is never less than a key,
+ * and INT32_MAX itself is reserved as the empty-slot marker and never stored as a key.
+ * The fastest kernel the CPU supports is picked once, at startup, from CPUID.
+ *
+ * The same kernels also search arrays of 16-bit unsigned keys, such as the key deltas of packed leaves,
+ * which are padded with 0xFFFF instead, and widen such arrays back to ints. Arrays of 64-bit keys, such as
+ * BIGINT keys and normalized DOUBLE ones, are searched the same way two or four keys to a vector, padded with
+ * any value above every key.
+ *
+ * Arrays of any other key type, padded with a value above every key the same way, are searched by a branchless
+ * binary search instead, which needs nothing of the key type but operator<.
+ */
+class NodeSearch
+{
+public:
+  /**
+   * Number of keys in the array that are less than the key, i.e. the position of the first key >= key.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is >= key, or size if there is none
+   */
+  static int lowerBound(const int *keys, const int size, const int key)
+  {
+    return kernels.load(std::memory_order_acquire)->lowerBound(keys, size, key);
+  }
+
+  /**
+   * Number of keys in the array that are less than or equal to the key, i.e. the position of the first key > key.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is > key, or size if there is none
+   */
+  static int upperBound(const int *keys, const int size, const int key)
+  {
+    return kernels.load(std::memory_order_acquire)->upperBound(keys, size, key);
+  }
+
+  /**
+   * lowerBound over 64-bit keys.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is >= key, or size if there is none
+   */
+  static int lowerBound(const long long *keys, const int size, const long long key)
+  {
+    return kernels.load(std::memory_order_acquire)->lowerBound64(keys, size, key);
+  }
+
+  /**
+   * upperBound over 64-bit keys.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is > key, or size if there is none
+   */
+  static int upperBound(const long long *keys, const int size, const long long key)
+  {
+    return kernels.load(std::memory_order_acquire)->upperBound64(keys, size, key);
+  }
+
+  /**
+   * lowerBound over 16-bit unsigned keys padded with 0xFFFF.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is >= key, or size if there is none
+   */
+  static int lowerBound16(const std::uint16_t *keys, const int size, const std::uint16_t key)
+  {
+    return kernels.load(std::memory_order_acquire)->lowerBound16(keys, size, key);
+  }
+
+  /**
+   * upperBound over 16-bit unsigned keys padded with 0xFFFF.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is > key, or size if there is none
+   */
+  static int upperBound16(const std::uint16_t *keys, const int size, const std::uint16_t key)
+  {
+    return kernels.load(std::memory_order_acquire)->upperBound16(keys, size, key);
+  }
+
+  /**
+   * Widen 16-bit deltas to ints and add a base to each of them.
+   *
+   * @param deltas  Deltas to decode
+   * @param count   Number of deltas
+   * @param base    Value added to every delta
+   * @param out     Receives the count decoded values
+   */
+  static void decode16(const std::uint16_t *deltas, const int count, const int base, int *out)
+  {
+    kernels.load(std::memory_order_acquire)->decode16(deltas, count, base, out);
+  }
+
+  /**
+   * lowerBound over keys of another type, by branchless binary search.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is >= key, or size if there is none
+   */
+  template <class K>
+  static int lowerBound(const K *keys, const int size, const K key)
+  {
+    if (size == 0)
+    {
+      return 0;
+    }
+    // the window shrinks by half at every step whatever the comparison says, so it compiles to a conditional move
+    const K *base = keys;
+    int n = size;
+    while (n > 1)
+    {
+      int half = n / 2;
+      base = (base[half - 1] < key) ? base + half : base;
+      n -= half;
+    }
+    return (int)(base - keys) + (*base < key);
+  }
+
+  /**
+   * upperBound over keys of another type, by branchless binary search.
+   *
+   * @param keys    Sorted key array
+   * @param size    Number of slots in the array
+   * @param key     Key to search for
+   * @return        Index of the first slot whose key is > key, or size if there is none
+   */
+  template <class K>
+  static int upperBound(const K *keys, const int size, const K key)
+  {
+    if (size == 0)
+    {
+      return 0;
+    }
+    const K *base = keys;
+    int n = size;
+    while (n > 1)
+    {
+      int half = n / 2;
+      base = (key < base[half - 1]) ? base : base + half;
+      n -= half;
+    }
+    return (int)(base - keys) + !(key < *base);
+  }
+
+  /**
+   * decode16 into keys of another type.
+   *
+   * @param deltas  Deltas to decode
+   * @param count   Number of deltas
+   * @param base    Value added to every delta
+   * @param out     Receives the count decoded values
+   */
+  template <class K>
+  static void decode16(const std::uint16_t *deltas, const int count, const K base, K *out)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      out[i] = base + deltas[i];
+    }
+  }
+
+  /**
+   * Kernel currently used for searches.
+   */
+  static SearchKernel getKernel()
+  {
+    return kernels.load(std::memory_order_acquire)->kernel;
+  }
+
+  /**
+   * Kernel picked from CPUID at startup.
+   */
+  static SearchKernel detectKernel();
+
+  /**
+   * Force the searches to use the given kernel, e.g. to compare kernels against each other.
+   * Falls back to the scalar kernel if the CPU does not support the requested one.
+   * Safe to call while other threads search: each search runs entirely on either the old kernel or the new one.
+   *
+   * @param requested   Kernel to use
+   * @return            Kernel actually used
+   */
+  static SearchKernel setKernel(const SearchKernel requested);
+
+private:
+  typedef int (*SearchFn)(const int *keys, const int size, const int key);
+  typedef int (*Search64Fn)(const long long *keys, const int size, const long long key);
+  typedef int (*Search16Fn)(const std::uint16_t *keys, const int size, const std::uint16_t key);
+  typedef void (*Decode16Fn)(const std::uint16_t *deltas, const int count, const int base, int *out);
+
+  /**
+   * @brief Entry points of one kernel.
+   */
+  struct KernelTable
+  {
+    SearchKernel kernel;
+    SearchFn lowerBound;
+    SearchFn upperBound;
+    Search64Fn lowerBound64;
+    Search64Fn upperBound64;
+    Search16Fn lowerBound16;
+    Search16Fn upperBound16;
+    Decode16Fn decode16;
+  };
+
+  /**
+   * Entry points of every kernel, indexed by SearchKernel.
+   */
+  static const KernelTable KERNELS[];
+
+  /**
+   * Entry points of the kernel currently used for searches. Swapped as a whole by setKernel,
+   * so no search ever mixes the functions of two kernels.
+   */
+  static std::atomic<const KernelTable *> kernels;
+};
+
+} // namespace badgerdb